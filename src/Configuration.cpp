@@ -13,15 +13,23 @@ bool Configuration::WITH_PROLOGUE = true;
 
 int Configuration::REDIS_PORT = 6379;
 const int Configuration::REDIS_DEFAULT_TLL = 86400000;
+int Configuration::REDIS_LEASE_MS = 30000;
+int Configuration::REDIS_WORKER_TIMEOUT_MS = 90000;
+
+int Configuration::SOCKET_POLL_mS = 10;
+int Configuration::IO_SPIN_ATTEMPTS = 16;
 
 int Configuration::QUEUE_SLEEP_uS = 1000;
 //int Configuration::QUEUE_SLEEP_uS = 100000000;
 int Configuration::DEBUG_QUEUE_SLEEP_uS = 1000000;
 int Configuration::LOCK_SLEEP_uS = 1000;
+int Configuration::LOCK_SPIN_ATTEMPTS = 16;
 int Configuration::LOCK_MAX_RETRIES = 1000000;
 int Configuration::WAITER_SLEEP_uS = 1000;
+int Configuration::WAITER_BLOCK_S = 1;
 
 std::size_t Configuration::ENUMERATION_UNROLLING_LIMIT = 200;
+int Configuration::ENUMERATION_BATCH_TARGET_uS = 10000;
 
 bool Configuration::THREAD_EXIT = false;
 
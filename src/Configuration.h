@@ -16,16 +16,25 @@ public:
     static int REDIS_PORT;
     inline static const std::string REDIS_PREFIX = "swarm_";
     static const int REDIS_DEFAULT_TLL;
+    static int REDIS_LEASE_MS;
+    static int REDIS_WORKER_TIMEOUT_MS;
 
     static const size_t SOCKET_MAX_BUFFER_SIZE = 65536;  // 64 KiB
+    static int SOCKET_POLL_mS;
+    static int IO_SPIN_ATTEMPTS;
+
+    static const size_t FILE_CHUNK_SIZE = 1048576;  // 1 MiB
 
     static int QUEUE_SLEEP_uS;
     static int DEBUG_QUEUE_SLEEP_uS;
     static int LOCK_SLEEP_uS;
+    static int LOCK_SPIN_ATTEMPTS;
     static int LOCK_MAX_RETRIES;
     static int WAITER_SLEEP_uS;
+    static int WAITER_BLOCK_S;
 
-    static std::size_t ENUMERATION_UNROLLING_LIMIT;
+    static std::size_t ENUMERATION_UNROLLING_LIMIT;  // most elements one enumerate job will run
+    static int ENUMERATION_BATCH_TARGET_uS;
 
     static bool THREAD_EXIT;
     static std::map<std::string, std::string> QUEUE_FILTERS;
@@ -629,6 +629,12 @@ int Executive::executeLocalSVI(bool multithreaded) {
     swarmc::VM::Pipeline pipeline(_input);
     pipeline.setExternalProviders(externalProviders);
 
+    // The single-threaded drivers never hand references to another thread,
+    // so we can skip the atomic ref count updates for this process.
+    if ( !multithreaded ) {
+        nslib::IRefCountable::useThreadSafeRefCounts(false);
+    }
+
     if ( flagInteractiveDebug ) {
         pipeline.targetInteractiveDebugger();
         return 0;
@@ -682,7 +688,8 @@ int Executive::emitBinary() {
         }
 
         auto binary = pipeline.targetBinaryRepresentation();
-        fwrite("\x7fSVI", 1, 4, fh);
+        fwrite(BC_HEADER, 1, BC_HEADER_LENGTH, fh);
+        fputc(BC_FORMAT_VERSION, fh);
         fwrite(binn_ptr(binary), binn_size(binary), 1, fh);
         fclose(fh);
         binn_free(binary);
@@ -699,7 +706,8 @@ int Executive::emitBinary() {
         return 1;
     }
 
-    fwrite("\x7fSVI", 1, 4, fh);
+    fwrite(BC_HEADER, 1, BC_HEADER_LENGTH, fh);
+    fputc(BC_FORMAT_VERSION, fh);
     fwrite(binn_ptr(binary), binn_size(binary), 1, fh);
     fclose(fh);
     binn_free(binary);
@@ -33,6 +33,9 @@ namespace swarmc::Errors {
         ChildObjectTypeConflict = 28,
         NonFinalObjectType = 29,
         InvalidOrUnpublishedResourceId = 30,
+        SocketOperationFailed = 31,
+        ParallelJobFailed = 32,
+        FileInUse = 33,
     };
 
 }
@@ -65,6 +68,9 @@ namespace nslib {
         if ( v == swarmc::Errors::RuntimeExCode::MutateFinalizedObject ) return "RuntimeExCode(MutateFinalizedObject, code: 27)";
         if ( v == swarmc::Errors::RuntimeExCode::ChildObjectTypeConflict ) return "RuntimeExCode(ChildObjectTypeConflict, code: 28)";
         if ( v == swarmc::Errors::RuntimeExCode::NonFinalObjectType ) return "RuntimeExCode(NonFinalObjectType, code: 29)";
+        if ( v == swarmc::Errors::RuntimeExCode::SocketOperationFailed ) return "RuntimeExCode(SocketOperationFailed, code: 31)";
+        if ( v == swarmc::Errors::RuntimeExCode::ParallelJobFailed ) return "RuntimeExCode(ParallelJobFailed, code: 32)";
+        if ( v == swarmc::Errors::RuntimeExCode::FileInUse ) return "RuntimeExCode(FileInUse, code: 33)";
         return "RuntimeExCode(UNKNOWN" + s((std::size_t) v) + ")";
     }
 
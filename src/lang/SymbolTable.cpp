@@ -229,6 +229,18 @@ namespace swarmc::Lang {
         auto readFromConnection = new PrologueFunctionSymbol("readFromConnection", typeConnectionString, new ProloguePosition("readFromConnection"), "READ_FROM_CONNECTION");
         prologueScope->insert(readFromConnection);
 
+        auto typeConnectionStringVoid = new Type::Lambda1(connectionType, new Type::Lambda1(Type::Primitive::of(Type::Intrinsic::STRING), Type::Primitive::of(Type::Intrinsic::VOID)));
+        auto writeToConnection = new PrologueFunctionSymbol("writeToConnection", typeConnectionStringVoid, new ProloguePosition("writeToConnection"), "WRITE_TO_CONNECTION");
+        prologueScope->insert(writeToConnection);
+
+        auto typeConnectionVoid = new Type::Lambda1(connectionType, Type::Primitive::of(Type::Intrinsic::VOID));
+        auto closeConnection = new PrologueFunctionSymbol("closeConnection", typeConnectionVoid, new ProloguePosition("closeConnection"), "CLOSE_CONNECTION");
+        prologueScope->insert(closeConnection);
+
+        auto typeSocketHandlerNumber = new Type::Lambda1(socketType, new Type::Lambda1(typeConnectionVoid, Type::Primitive::of(Type::Intrinsic::NUMBER)));
+        auto serveSocket = new PrologueFunctionSymbol("serveSocket", typeSocketHandlerNumber, new ProloguePosition("serveSocket"), "SERVE_SOCKET");
+        prologueScope->insert(serveSocket);
+
         auto fileType = new Type::Resource(Type::Opaque::of("PROLOGUE::FILE"));
 
         auto typeStringFile = new Type::Lambda1(
@@ -258,6 +270,68 @@ namespace swarmc::Lang {
         auto file_append = new PrologueFunctionSymbol("append", typeFileStringVoid, new ProloguePosition("append"), "APPEND_FILE");
         prologueScope->insert(file_append);
 
+        auto typeFileNumber = new Type::Lambda1(
+            fileType,
+            Type::Primitive::of(Type::Intrinsic::NUMBER)
+        );
+        auto file_size = new PrologueFunctionSymbol("fileSize", typeFileNumber, new ProloguePosition("fileSize"), "FILE_SIZE");
+        prologueScope->insert(file_size);
+
+        // readRange :: file -> number (offset) -> number (length) -> string
+        auto typeFileNumNumString = new Type::Lambda1(
+            fileType,
+            new Type::Lambda1(
+                Type::Primitive::of(Type::Intrinsic::NUMBER),
+                new Type::Lambda1(
+                    Type::Primitive::of(Type::Intrinsic::NUMBER),
+                    Type::Primitive::of(Type::Intrinsic::STRING)
+                )
+            )
+        );
+        auto file_readRange = new PrologueFunctionSymbol("readRange", typeFileNumNumString, new ProloguePosition("readRange"), "READ_FILE_RANGE");
+        prologueScope->insert(file_readRange);
+
+        // readLines :: file -> number (offset) -> number (length) -> enumerable<string>
+        auto typeFileNumNumEnumString = new Type::Lambda1(
+            fileType,
+            new Type::Lambda1(
+                Type::Primitive::of(Type::Intrinsic::NUMBER),
+                new Type::Lambda1(
+                    Type::Primitive::of(Type::Intrinsic::NUMBER),
+                    new Type::Enumerable(Type::Primitive::of(Type::Intrinsic::STRING))
+                )
+            )
+        );
+        auto file_readLines = new PrologueFunctionSymbol("readLines", typeFileNumNumEnumString, new ProloguePosition("readLines"), "READ_FILE_LINES");
+        prologueScope->insert(file_readLines);
+
+        auto file_openReplicated = new PrologueFunctionSymbol("openReplicated", typeStringFile, new ProloguePosition("openReplicated"), "OPEN_REPLICATED_FILE");
+        prologueScope->insert(file_openReplicated);
+
+        // forEachChunk :: file -> number (chunk size) -> (file -> number (offset) -> number (length) -> void) -> number
+        auto typeFileNumNumVoid = new Type::Lambda1(
+            fileType,
+            new Type::Lambda1(
+                Type::Primitive::of(Type::Intrinsic::NUMBER),
+                new Type::Lambda1(
+                    Type::Primitive::of(Type::Intrinsic::NUMBER),
+                    Type::Primitive::of(Type::Intrinsic::VOID)
+                )
+            )
+        );
+        auto typeFileNumHandlerNum = new Type::Lambda1(
+            fileType,
+            new Type::Lambda1(
+                Type::Primitive::of(Type::Intrinsic::NUMBER),
+                new Type::Lambda1(
+                    typeFileNumNumVoid,
+                    Type::Primitive::of(Type::Intrinsic::NUMBER)
+                )
+            )
+        );
+        auto file_forEachChunk = new PrologueFunctionSymbol("forEachChunk", typeFileNumHandlerNum, new ProloguePosition("forEachChunk"), "FOR_EACH_FILE_CHUNK");
+        prologueScope->insert(file_forEachChunk);
+
         auto typeNumToNumToNum = new Type::Lambda1(
             Type::Primitive::of(Type::Intrinsic::NUMBER),
             typeNumToNum
@@ -268,6 +342,37 @@ namespace swarmc::Lang {
         auto min = new PrologueFunctionSymbol("min", typeNumToNumToNum, new ProloguePosition("min"), "MIN");
         prologueScope->insert(min);
 
+        // reduce :: enumerable<number> -> number (identity) -> (number -> number -> number) -> number
+        auto typeEnumNumToNumToCombineToNum = new Type::Lambda1(
+            typeEnumNum,
+            new Type::Lambda1(
+                Type::Primitive::of(Type::Intrinsic::NUMBER),
+                new Type::Lambda1(
+                    typeNumToNumToNum,
+                    Type::Primitive::of(Type::Intrinsic::NUMBER)
+                )
+            )
+        );
+        auto reduce = new PrologueFunctionSymbol("reduce", typeEnumNumToNumToCombineToNum, new ProloguePosition("reduce"), "REDUCE");
+        prologueScope->insert(reduce);
+
+        // mapReduce :: enumerable<number> -> number (identity) -> (number -> number) -> (number -> number -> number) -> number
+        auto typeEnumNumToNumToMapToCombineToNum = new Type::Lambda1(
+            typeEnumNum,
+            new Type::Lambda1(
+                Type::Primitive::of(Type::Intrinsic::NUMBER),
+                new Type::Lambda1(
+                    typeNumToNum,
+                    new Type::Lambda1(
+                        typeNumToNumToNum,
+                        Type::Primitive::of(Type::Intrinsic::NUMBER)
+                    )
+                )
+            )
+        );
+        auto mapReduce = new PrologueFunctionSymbol("mapReduce", typeEnumNumToNumToMapToCombineToNum, new ProloguePosition("mapReduce"), "MAP_REDUCE");
+        prologueScope->insert(mapReduce);
+
         return prologueScope;
     }
 
@@ -27,19 +27,18 @@ namespace nslib {
 
 namespace swarmc::Type {
 
-    std::size_t Type::_nextId = 0;
+    std::atomic<std::size_t> Type::_nextId = 0;
 
-    nslib::Monitor<AssignableCache>& Type::getAssignableCache() {
-        static AssignableCache assignableCache;
-        static nslib::Monitor<AssignableCache> monitor(&assignableCache);
-        return monitor;
+    AssignableCache& Type::getAssumedAssignable() {
+        thread_local AssignableCache assumed;
+        return assumed;
     }
 
-    std::map<Intrinsic, Primitive*> Primitive::_primitives;
+    std::array<std::atomic<Primitive*>, static_cast<std::size_t>(Intrinsic::THIS) + 1> Primitive::_primitives {};
 
     std::map<std::string, Opaque*> Opaque::_opaques;
 
-    Ambiguous* Ambiguous::_inst = nullptr;
+    std::mutex Opaque::_opaquesMutex;
 
     Ambiguous::Ambiguous(Lang::IdentifierNode* id) : Type(), _typeid(useref(id)) {}
     Ambiguous::~Ambiguous() { freeref(_typeid); }
@@ -1,7 +1,10 @@
 #ifndef SWARMC_TYPE_H
 #define SWARMC_TYPE_H
 
+#include <array>
+#include <atomic>
 #include <map>
+#include <mutex>
 #include <set>
 #include <sstream>
 #include <utility>
@@ -72,21 +75,33 @@ namespace swarmc::Type {
             return "CONTRADICTION";
         }
 
-        [[nodiscard]] static nslib::Monitor<AssignableCache>& getAssignableCache();
+        /**
+         * Get the object type assignments this thread is assuming to hold while it checks them,
+         * which lets recursive object types be compared without recursing forever.
+         */
+        [[nodiscard]] static AssignableCache& getAssumedAssignable();
 
         Type() {
             _id = _nextId++;
-            getAssignableCache().access<void>([this](AssignableCache* cache) {
-                (*cache)[_id] = std::set<std::size_t>();
-            });
         }
 
-        ~Type() override = default;
+        ~Type() override {
+            auto wrapper = _wrappers.load();
+            while ( wrapper != nullptr ) {
+                auto next = wrapper->next;
+                delete wrapper;
+                wrapper = next;
+            }
+        }
 
         [[nodiscard]] serial::tag_t getSerialKey() const override {
             return s(intrinsic());
         }
 
+        [[nodiscard]] serial::index_t getSerialIndex() const override {
+            return static_cast<serial::index_t>(intrinsic());
+        }
+
         [[nodiscard]] virtual Type* copy() const {
             std::map<const Type*, Type*> visited;
             return copyRec(visited);
@@ -129,24 +144,84 @@ namespace swarmc::Type {
 
         [[nodiscard]] virtual Type* disambiguateStatically() { return this; }
 
+        /**
+         * Returns true if this is the canonical instance of its type. Interned types are shared
+         * and must not be mutated, but can be compared for equality by pointer.
+         */
+        [[nodiscard]] bool isInterned() const {
+            return _interned;
+        }
+
     protected:
         friend class Lang::TypeLiteral;
         std::size_t _id;
-        static std::size_t _nextId;
+        static std::atomic<std::size_t> _nextId;
+        bool _interned = false;
+
+        /** An interned structural type (e.g. `Enumerable<T>`) built over some interned type `T`. */
+        struct InternedWrapper {
+            Intrinsic intrinsic;
+            const Type* other;
+            Type* type;
+            InternedWrapper* next;
+        };
+
+        /** Lock-free list of the interned structural types built over this type. */
+        mutable std::atomic<InternedWrapper*> _wrappers = nullptr;
+
+        /**
+         * Get the canonical `intrinsic` structural type over the interned type `inner` (and, for
+         * two-parameter types, the interned type `other`), calling `build` to create it the first time.
+         * Lookups never take a lock; concurrent first requests race to publish, and the losers discard theirs.
+         */
+        template <typename TWrapper, typename TBuilder>
+        static TWrapper* intern(const Type* inner, Intrinsic intrinsic, const Type* other, TBuilder build) {
+            auto head = inner->_wrappers.load(std::memory_order_acquire);
+            for ( auto w = head; w != nullptr; w = w->next ) {
+                if ( w->intrinsic == intrinsic && w->other == other ) return (TWrapper*) w->type;
+            }
+
+            TWrapper* inst = build();
+            inst->_interned = true;
+            useref(inst);
+
+            auto node = new InternedWrapper {intrinsic, other, inst, head};
+            while ( !inner->_wrappers.compare_exchange_weak(node->next, node, std::memory_order_acq_rel, std::memory_order_acquire) ) {
+                // Someone else published in the meantime -- check if they beat us to this type
+                for ( auto w = node->next; w != head; w = w->next ) {
+                    if ( w->intrinsic == intrinsic && w->other == other ) {
+                        delete node;
+                        freeref(inst);
+                        return (TWrapper*) w->type;
+                    }
+                }
+
+                head = node->next;
+            }
+
+            GC_ON_SHUTDOWN(inst)
+            return inst;
+        }
     };
 
     class Primitive : public Type {
     public:
         static Primitive* of(Intrinsic intrinsic) {
-            auto mapIter = _primitives.find(intrinsic);
-            if ( mapIter != _primitives.end() ) {
-                return mapIter->second;
+            auto& slot = _primitives.at(static_cast<std::size_t>(intrinsic));
+            auto inst = slot.load(std::memory_order_acquire);
+            if ( inst != nullptr ) {
+                return inst;
             }
 
-            auto inst = useref(new Primitive(intrinsic));
-            GC_ON_SHUTDOWN(inst)
-            _primitives[intrinsic] = inst;
-            return inst;
+            auto newInst = useref(new Primitive(intrinsic));
+            newInst->_interned = true;
+            if ( !slot.compare_exchange_strong(inst, newInst, std::memory_order_acq_rel, std::memory_order_acquire) ) {
+                freeref(newInst);  // another thread got there first
+                return inst;
+            }
+
+            GC_ON_SHUTDOWN(newInst)
+            return newInst;
         }
 
         static bool isPrimitive(Intrinsic intrinsic) {
@@ -164,10 +239,17 @@ namespace swarmc::Type {
 
         explicit Primitive(Intrinsic intrinsic) : Type(), _intrinsic(intrinsic) {}
 
+        /** Primitives share a single serial index, past the end of the Intrinsic enum. */
+        static constexpr serial::index_t SERIAL_INDEX = static_cast<serial::index_t>(Intrinsic::THIS) + 1;
+
         [[nodiscard]] serial::tag_t getSerialKey() const override {
             return "Type::Primitive";
         }
 
+        [[nodiscard]] serial::index_t getSerialIndex() const override {
+            return SERIAL_INDEX;
+        }
+
         [[nodiscard]] virtual Primitive* copy() const override {
             return Primitive::of(_intrinsic);
         }
@@ -183,6 +265,7 @@ namespace swarmc::Type {
         }
 
         bool isAssignableTo(const Type* other) const override {
+            if ( other == this ) return true;
             if ( other->intrinsic() == Intrinsic::AMBIGUOUS ) return true;
             if ( !Primitive::isPrimitive(other->intrinsic()) ) return false;
             if ( intrinsic() == Intrinsic::TYPE ) {
@@ -196,7 +279,7 @@ namespace swarmc::Type {
             return "Primitive<" + intrinsicString(_intrinsic) + ">";
         }
     protected:
-        static std::map<Intrinsic, Primitive*> _primitives;
+        static std::array<std::atomic<Primitive*>, static_cast<std::size_t>(Intrinsic::THIS) + 1> _primitives;
         Intrinsic _intrinsic;
 
         [[nodiscard]] virtual Type* copyRec(std::map<const Type*, Type*>&) const override {
@@ -208,15 +291,16 @@ namespace swarmc::Type {
     class Opaque : public Type {
     public:
         [[nodiscard]] static Opaque* of(const std::string& name) {
+            std::lock_guard<std::mutex> lock(_opaquesMutex);
             auto mapIter = _opaques.find(name);
             if ( mapIter != _opaques.end() ) {
                 return mapIter->second;
             }
 
-            // FIXME: need to freeref these when the program ends
             auto inst = useref(new Opaque(name));
+            inst->_interned = true;
             _opaques[name] = inst;
-            Framework::onShutdown([inst]() { freeref(inst); });
+            GC_ON_SHUTDOWN(inst)
             return inst;
         }
 
@@ -235,6 +319,7 @@ namespace swarmc::Type {
         }
 
         bool isAssignableTo(const Type* other) const override {
+            if ( other == this ) return true;
             return other->intrinsic() == Intrinsic::OPAQUE && ((const Opaque*) other)->_name == _name;
         }
 
@@ -246,6 +331,7 @@ namespace swarmc::Type {
 
     protected:
         static std::map<std::string, Opaque*> _opaques;
+        static std::mutex _opaquesMutex;
         std::string _name;
 
         [[nodiscard]] virtual Type* copyRec(std::map<const Type*, Type*>&) const override {
@@ -257,11 +343,14 @@ namespace swarmc::Type {
     class Ambiguous : public Type {
     public:
         static Ambiguous* of() {
-            if ( _inst == nullptr ) {
-                _inst = new Ambiguous();
-            }
+            static Ambiguous* inst = [] {
+                auto i = useref(new Ambiguous());
+                i->_interned = true;
+                GC_ON_SHUTDOWN(i)
+                return i;
+            }();
 
-            return _inst;
+            return inst;
         }
 
         static Ambiguous* partial(Lang::IdentifierNode* id) {
@@ -297,7 +386,6 @@ namespace swarmc::Type {
 
         [[nodiscard]] Type* disambiguateStatically() override;
     protected:
-        static Ambiguous* _inst;
         Lang::IdentifierNode* _typeid;
 
         [[nodiscard]] Ambiguous* copyRec(std::map<const Type*, Type*>& visited) const override {
@@ -309,6 +397,12 @@ namespace swarmc::Type {
 
     class Map : public Type {
     public:
+        /** Get a map type over `values`, which is the canonical instance if `values` is interned. */
+        static Map* of(Type* values) {
+            if ( !values->isInterned() ) return new Map(values);
+            return intern<Map>(values, Intrinsic::MAP, nullptr, [values]() { return new Map(values); });
+        }
+
         explicit Map(Type* values) : Type(), _values(useref(values)) {}
 
         ~Map() override {
@@ -342,7 +436,7 @@ namespace swarmc::Type {
         }
 
         bool isAssignableTo(const Type* other) const override {
-            if ( other->getId() == _id ) return true;
+            if ( other == this ) return true;
             if ( other->intrinsic() == Intrinsic::AMBIGUOUS ) return true;
             if ( other->intrinsic() != Intrinsic::MAP ) return false;
             return _values->isAssignableTo(((Map*) other)->values());
@@ -367,6 +461,12 @@ namespace swarmc::Type {
 
     class Enumerable : public Type {
     public:
+        /** Get an enumerable type over `values`, which is the canonical instance if `values` is interned. */
+        static Enumerable* of(Type* values) {
+            if ( !values->isInterned() ) return new Enumerable(values);
+            return intern<Enumerable>(values, Intrinsic::ENUMERABLE, nullptr, [values]() { return new Enumerable(values); });
+        }
+
         explicit Enumerable(Type* values) : Type(), _values(useref(values)) {}
 
         ~Enumerable() override {
@@ -399,6 +499,7 @@ namespace swarmc::Type {
         }
 
         bool isAssignableTo(const Type* other) const override {
+            if ( other == this ) return true;
             if ( other->intrinsic() == Intrinsic::AMBIGUOUS ) return true;
             if ( other->intrinsic() != Intrinsic::ENUMERABLE ) return false;
             return _values->isAssignableTo(((Enumerable*) other)->values());
@@ -424,7 +525,8 @@ namespace swarmc::Type {
     class Resource : public Type {
     public:
         static Resource* of(Type* inner) {
-            return new Resource(inner);
+            if ( !inner->isInterned() ) return new Resource(inner);
+            return intern<Resource>(inner, Intrinsic::RESOURCE, nullptr, [inner]() { return new Resource(inner); });
         }
 
         explicit Resource(Type* yields) : Type(), _yields(useref(yields)) {}
@@ -459,7 +561,7 @@ namespace swarmc::Type {
         }
 
         bool isAssignableTo(const Type* other) const override {
-            if ( other->getId() == _id ) return true;
+            if ( other == this ) return true;
             if ( other->intrinsic() == Intrinsic::AMBIGUOUS ) return true;
             if ( other->intrinsic() != Intrinsic::RESOURCE ) return false;
             return _yields->isAssignableTo(((Resource*) other)->yields());
@@ -485,7 +587,8 @@ namespace swarmc::Type {
     class Stream : public Type {
     public:
         static Stream* of(Type* inner) {
-            return new Stream(inner);
+            if ( !inner->isInterned() ) return new Stream(inner);
+            return intern<Stream>(inner, Intrinsic::STREAM, nullptr, [inner]() { return new Stream(inner); });
         }
 
         explicit Stream(Type* inner) : Type(), _inner(useref(inner)) {}
@@ -520,7 +623,7 @@ namespace swarmc::Type {
         }
 
         bool isAssignableTo(const Type* other) const override {
-            if ( other->getId() == _id ) return true;
+            if ( other == this ) return true;
             if ( other->intrinsic() == Intrinsic::AMBIGUOUS ) return true;
             if ( other->intrinsic() != Intrinsic::STREAM ) return false;
             return _inner->isAssignableTo(((Stream*) other)->inner());
@@ -578,6 +681,12 @@ namespace swarmc::Type {
 
     class Lambda0 : public Lambda {
     public:
+        /** Get a lambda type returning `returns`, which is the canonical instance if `returns` is interned. */
+        static Lambda0* of(Type* returns) {
+            if ( !returns->isInterned() ) return new Lambda0(returns);
+            return intern<Lambda0>(returns, Intrinsic::LAMBDA0, nullptr, [returns]() { return new Lambda0(returns); });
+        }
+
         explicit Lambda0(Type* returns) : Lambda(returns) {}
 
         [[nodiscard]] Intrinsic intrinsic() const override {
@@ -590,7 +699,7 @@ namespace swarmc::Type {
         }
 
         bool isAssignableTo(const Type* other) const override {
-            if ( other->getId() == _id ) return true;
+            if ( other == this ) return true;
             if ( other->intrinsic() == Intrinsic::AMBIGUOUS ) return true;
             if ( other->intrinsic() != Intrinsic::LAMBDA0 ) return false;
             return _returns->isAssignableTo(((Lambda0*) other)->returns());
@@ -613,6 +722,12 @@ namespace swarmc::Type {
 
     class Lambda1 : public Lambda {
     public:
+        /** Get a lambda type from `param` to `returns`, which is the canonical instance if both are interned. */
+        static Lambda1* of(Type* param, Type* returns) {
+            if ( !param->isInterned() || !returns->isInterned() ) return new Lambda1(param, returns);
+            return intern<Lambda1>(param, Intrinsic::LAMBDA1, returns, [param, returns]() { return new Lambda1(param, returns); });
+        }
+
         explicit Lambda1(Type* param, Type* returns) : Lambda(returns), _param(useref(param)) {}
 
         ~Lambda1() override {
@@ -646,7 +761,7 @@ namespace swarmc::Type {
         }
 
         bool isAssignableTo(const Type* other) const override {
-            if ( other->getId() == _id ) return true;
+            if ( other == this ) return true;
             if ( other->intrinsic() == Intrinsic::AMBIGUOUS ) return true;
             if ( other->intrinsic() != Intrinsic::LAMBDA1 ) return false;
             return _returns->isAssignableTo(((Lambda1*) other)->returns()) && ((Lambda1*) other)->param()->isAssignableTo(_param);
@@ -692,6 +807,13 @@ namespace swarmc::Type {
         ~Object() override {
             freeref(_parent);
             for (auto p : _properties) freeref(p.second);
+
+            auto result = _assignable.load();
+            while ( result != nullptr ) {
+                auto next = result->next;
+                delete result;
+                result = next;
+            }
         }
 
         [[nodiscard]] Intrinsic intrinsic() const override {
@@ -726,7 +848,7 @@ namespace swarmc::Type {
         }
 
         [[nodiscard]] bool isAssignableTo(const Type* other) const override {
-            if ( other->getId() == _id ) return true;
+            if ( other == this ) return true;
             if ( other->intrinsic() == Intrinsic::AMBIGUOUS ) return true;
 
             if ( other->intrinsic() != Intrinsic::OBJECT ) {
@@ -745,44 +867,47 @@ namespace swarmc::Type {
                 return other->intrinsic() == Intrinsic::THIS;
             }
 
+            // Finalized object types can't change, so a result found at the top of a check holds for good
+            for ( auto result = _assignable.load(std::memory_order_acquire); result != nullptr; result = result->next ) {
+                if ( result->other == other->getId() ) return result->assignable;
+            }
+
             // Even without p:THIS a recursive type will still nuke the stack haha
             // If we arrived at a duplicate, we basically are saying for types `a` and `b`:
             // a == b <-> a == b
             // which is of course true, ergo we can return true without recursing further
-            auto cachedIds = getAssignableCache().access<std::set<std::size_t>>([this](AssignableCache* cache) {
-                return (*cache).at(_id);
-            });
-            if ( stl::contains(cachedIds, other->getId()) ) return true;
+            auto& assumed = getAssumedAssignable();
+            auto isAssumed = assumed.find(_id);
+            if ( isAssumed != assumed.end() && stl::contains(isAssumed->second, other->getId()) ) return true;
 
-            auto otherObject = dynamic_cast<const Object*>(other);
-            auto properties = otherObject->getCollapsedProperties();
-            auto otherIter = properties.begin();
+            // Results that depend on an assumption made further up aren't final, so only the outermost check caches
+            auto isOutermost = assumed.empty();
 
             // assume objects to be equal until proven otherwise (because of recursive types)
-            getAssignableCache().access<void>([this, other](AssignableCache* cache) {
-                (*cache)[_id].insert(other->getId());
-            });
+            assumed[_id].insert(other->getId());
 
-            for ( ; otherIter != properties.end(); ++otherIter ) {
-                auto thisResult = getProperty(otherIter->first);
-                if ( thisResult == nullptr ) {
-                    // We don't have a required property on the base type
-                    getAssignableCache().access<void>([this, other](AssignableCache* cache) {
-                        (*cache)[_id].erase(other->getId());
-                    });
-                    return false;
+            auto otherObject = dynamic_cast<const Object*>(other);
+            auto properties = otherObject->getCollapsedProperties();
+            bool assignable = true;
+            for ( const auto& property : properties ) {
+                auto thisResult = getProperty(property.first);
+
+                // We don't have a required property on the base type, or ours has an incompatible type
+                if ( thisResult == nullptr || !thisResult->isAssignableTo(property.second) ) {
+                    assignable = false;
+                    break;
                 }
+            }
 
-                if ( !thisResult->isAssignableTo(otherIter->second) ) {
-                    // Our property has an incompatible type
-                    getAssignableCache().access<void>([this, other](AssignableCache* cache) {
-                        (*cache)[_id].erase(other->getId());
-                    });
-                    return false;
-                }
+            assumed[_id].erase(other->getId());
+            if ( assumed[_id].empty() ) assumed.erase(_id);
+
+            if ( isOutermost ) {
+                auto result = new AssignableResult { other->getId(), assignable, _assignable.load(std::memory_order_relaxed) };
+                while ( !_assignable.compare_exchange_weak(result->next, result, std::memory_order_release, std::memory_order_relaxed) ) {}
             }
 
-            return true;
+            return assignable;
         }
 
         Object* defineProperty(const std::string& name, Type* type) {
@@ -881,6 +1006,16 @@ namespace swarmc::Type {
         std::map<std::string, Type*> _properties;
         Object* _parent = nullptr;
 
+        /** Whether this (finalized) type was found to be assignable to the type with the given ID. */
+        struct AssignableResult {
+            std::size_t other;
+            bool assignable;
+            AssignableResult* next;
+        };
+
+        /** Lock-free list of the assignability checks this type has finished, so repeats don't walk the properties. */
+        mutable std::atomic<AssignableResult*> _assignable = nullptr;
+
         [[nodiscard]] std::map<std::string, Type*> getCollapsedProperties(std::map<std::string, Type*>& map) const {
             if ( _parent != nullptr ) {
                 map = _parent->getCollapsedProperties(map);
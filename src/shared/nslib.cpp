@@ -90,6 +90,10 @@ namespace nslib {
         Logging::get()->output(_tag, v, p);
     }
 
+    bool Logger::isEnabled(Verbosity v) const {
+        return Logging::get()->isEnabled(_tag, v);
+    }
+
     Console* ConsoleService::produceNewForContext() {
         return new Console();
     }
@@ -104,6 +108,7 @@ namespace nslib {
 
 #ifdef NSLIB_GC_TRACK
     GCTracks IRefCountable::_tracks;
+    std::mutex IRefCountable::_tracksMutex;
     bool IRefCountable::_registeredShutdown = false;
 #endif
 
@@ -21,7 +21,7 @@
 #define GC_LOCAL_REF(ref) auto UNIQUE_NAME(refHandle) = localref(ref);
 
 /* Disables ref counting on a variable */
-#define GC_NO_REF(ref) ref.nslibNoRef(*ref.nslibGCMutex());
+#define GC_NO_REF(ref) ref.nslibNoRef();
 
 /* Tags a variable to be cleaned up during application shutdown. */
 #define GC_ON_SHUTDOWN(ref) nslib::Framework::onShutdown([ref]() { freeref(ref); });
@@ -33,6 +33,7 @@
 #include <random>
 #include <stack>
 #include <map>
+#include <vector>
 #include <list>
 #include <string>
 #include <sstream>
@@ -55,6 +56,8 @@
 #include <sys/shm.h>
 #include <execinfo.h>
 #include <mutex>
+#include <atomic>
+#include <concepts>
 #include <typeinfo>
 #include <string_view>
 #include <sys/wait.h>
@@ -63,6 +66,7 @@
 #define NSLIB_SERIAL_TAG 0
 #define NSLIB_SERIAL_DATA 1
 #define NSLIB_SERIAL_VERSION 2
+#define NSLIB_SERIAL_INDEX 3
 
 namespace nslib {
 
@@ -110,6 +114,81 @@ namespace nslib {
     };
 
 
+    /**
+     * Mixin which recycles the storage of freed `T` instances on a per-thread free list rather
+     * than returning it to the global allocator. Useful for small objects created and destroyed
+     * at a high rate. Subclasses of `T` with a different size fall through to the global allocator.
+     *
+     * Each thread's list is drained when the thread exits. Anything freed on that thread after
+     * that (e.g. by other thread-locals, or during static teardown) goes straight to the allocator.
+     */
+    template <typename T, std::size_t MaxFree = 1024>
+    class IPoolAllocated {
+    public:
+        static void* operator new(std::size_t size) {
+            auto& pool = freeList();
+            if ( size != sizeof(T) || pool.head == nullptr ) return ::operator new(size);
+
+            auto block = pool.head;
+            pool.head = block->next;
+            pool.size -= 1;
+            return block;
+        }
+
+        static void operator delete(void* ptr, std::size_t size) {
+            if ( ptr == nullptr ) return;
+
+            auto& pool = freeList();
+            if ( size != sizeof(T) || pool.closed || pool.size >= MaxFree ) return ::operator delete(ptr);
+
+            // Make sure this thread's list gets drained when it exits, now that it will hold something
+            if ( pool.size == 0 ) owner();
+
+            auto block = static_cast<FreeBlock*>(ptr);
+            block->next = pool.head;
+            pool.head = block;
+            pool.size += 1;
+        }
+
+    private:
+        struct FreeBlock {
+            FreeBlock* next;
+        };
+
+        /** Trivially destructible, so it can still be used while the thread's other thread-locals are destroyed. */
+        struct FreeList {
+            FreeBlock* head;
+            std::size_t size;
+            bool closed;
+        };
+
+        /** Owns the calling thread's free list, draining and closing it when the thread exits. */
+        struct FreeListOwner {
+            ~FreeListOwner() {
+                auto& pool = freeList();
+                while ( pool.head != nullptr ) {
+                    auto next = pool.head->next;
+                    ::operator delete(pool.head);
+                    pool.head = next;
+                }
+
+                pool.size = 0;
+                pool.closed = true;
+            }
+        };
+
+        static FreeList& freeList() {
+            thread_local FreeList list { nullptr, 0, false };
+            return list;
+        }
+
+        static void owner() {
+            thread_local FreeListOwner owner;
+            (void) owner;
+        }
+    };
+
+
     class NSLibException : public std::logic_error, public IStringable {
     public:
         explicit NSLibException(const std::string& message) : std::logic_error(message) {}
@@ -542,6 +621,18 @@ namespace nslib {
 
         virtual void output(Verbosity, const std::string& p);
 
+        /** Returns true if messages of the given verbosity from this logger would be output. */
+        [[nodiscard]] virtual bool isEnabled(Verbosity) const;
+
+        /**
+         * Output a message of the given verbosity. The message is built by calling `formatter`,
+         * which only happens if the verbosity is enabled, so expensive messages cost nothing otherwise.
+         */
+        template <typename TFormatter> requires std::invocable<TFormatter>
+        void output(Verbosity v, TFormatter&& formatter) {
+            if ( isEnabled(v) ) output(v, std::string(formatter()));
+        }
+
         /** Output an error message. */
         virtual void error(const std::string& p) {
             output(Verbosity::ERROR, p);
@@ -636,12 +727,18 @@ namespace nslib {
         }
 
         virtual void output(const std::string& tag, Verbosity v, const std::string& p) {
-            if ( !shouldOutput(v) ) return;
-            if ( _allowList && std::find(_configuredTags.begin(), _configuredTags.end(), tag) == _configuredTags.end() ) return;
-            if ( !_allowList && std::find(_configuredTags.begin(), _configuredTags.end(), tag) != _configuredTags.end() ) return;
+            if ( !isEnabled(tag, v) ) return;
             for ( auto target : _targets ) target->output(v, format(tag, p));
         }
 
+        /** Returns true if a message of the given verbosity from the logger with the given tag would be output. */
+        [[nodiscard]] bool isEnabled(const std::string& tag, Verbosity v) const {
+            if ( !shouldOutput(v) ) return false;
+            if ( _allowList && std::find(_configuredTags.begin(), _configuredTags.end(), tag) == _configuredTags.end() ) return false;
+            if ( !_allowList && std::find(_configuredTags.begin(), _configuredTags.end(), tag) != _configuredTags.end() ) return false;
+            return true;
+        }
+
         virtual void onlyEnabledLoggers() {
             _allowList = true;
         }
@@ -2072,6 +2169,12 @@ namespace nslib {
         /** Each child-class has a unique tag. */
         using tag_t = std::string;
 
+        /** Built-in child-classes may also have a small integer index, which is cheaper to dispatch on than the tag. */
+        using index_t = std::size_t;
+
+        /** The index of child-classes which are only known by their tag (e.g. ones from external providers). */
+        inline constexpr index_t NO_SERIAL_INDEX = static_cast<index_t>(-1);
+
         using BinSafeString = std::string;
 
         inline BinSafeString toBinSafeString(std::string str) {
@@ -2087,6 +2190,12 @@ namespace nslib {
         public:
             [[nodiscard]] virtual tag_t getSerialKey() const = 0;
 
+            /**
+             * The index this class was registered under with its Factory, if any.
+             * Factories dispatch on this instead of the tag when possible, so it should be cheap.
+             */
+            [[nodiscard]] virtual index_t getSerialIndex() const { return NO_SERIAL_INDEX; }
+
             [[nodiscard]] virtual binn* getExtraSerialData() const { return binn_map(); }
 
             virtual void loadExtraSerialData(binn*) {}
@@ -2152,6 +2261,23 @@ namespace nslib {
                 _reducers.insert({ tag, producer });
             }
 
+            /**
+             * Register a function which instantiates Class instances w/ the given tag and index.
+             * Data serialized w/ an index is dispatched by index, without comparing tags.
+             */
+            void registerProducer(index_t index, tag_t tag, Producer producer) {
+                registerProducer(tag, producer);
+                if ( index >= _indexedProducers.size() ) _indexedProducers.resize(index + 1);
+                _indexedProducers[index] = producer;
+            }
+
+            /** Register a function which creates binn* instances for Classes w/ the given tag and index. */
+            void registerReducer(index_t index, tag_t tag, Reducer reducer) {
+                registerReducer(tag, reducer);
+                if ( index >= _indexedReducers.size() ) _indexedReducers.resize(index + 1);
+                _indexedReducers[index] = reducer;
+            }
+
             /** True if a producer w/ that tag has been registered. */
             [[nodiscard]] bool hasProducer(tag_t tag) {
                 return _producers.find(tag) != _producers.end();
@@ -2164,6 +2290,16 @@ namespace nslib {
 
             /** Load a Class instance from the serialized data. */
             [[nodiscard]] Class* produce(binn* data, Passthrough p) {
+                uint64 index;
+                if ( binn_map_get_uint64(data, NSLIB_SERIAL_INDEX, &index) ) {
+                    if ( index >= _indexedProducers.size() || !_indexedProducers[index] ) {
+                        throw MissingProducerError<Class>("#" + s((std::size_t) index));
+                    }
+
+                    auto obj = (binn*) binn_map_object(data, NSLIB_SERIAL_DATA);
+                    return _indexedProducers[index](obj, p);
+                }
+
                 tag_t tag = binn_map_str(data, NSLIB_SERIAL_TAG);
                 auto iter = _producers.find(tag);
                 if ( iter == _producers.end() ) {
@@ -2176,6 +2312,16 @@ namespace nslib {
 
             /** Serialize an object. */
             [[nodiscard]] binn* reduce(priv::Serializable<Class> auto obj, Passthrough p) {
+                auto index = obj->getSerialIndex();
+                if ( index < _indexedReducers.size() && _indexedReducers[index] ) {
+                    auto data = _indexedReducers[index](obj, p);
+                    auto binn = binn_map();
+                    binn_map_set_uint64(binn, NSLIB_SERIAL_INDEX, index);
+                    binn_map_set_object(binn, NSLIB_SERIAL_DATA, data);
+                    binn_free(data);
+                    return binn;
+                }
+
                 return reduce(obj->getSerialKey(), obj, p);
             }
 
@@ -2188,8 +2334,9 @@ namespace nslib {
 
                 auto data = ((*iter).second)(obj, p);
                 auto binn = binn_map();
-                binn_map_set_str(binn, NSLIB_SERIAL_TAG, strdup(tag.c_str()));
+                binn_map_set_str(binn, NSLIB_SERIAL_TAG, (char*) tag.c_str());
                 binn_map_set_object(binn, NSLIB_SERIAL_DATA, data);
+                binn_free(data);  // binn copies nested containers into the parent
                 return binn;
             }
 
@@ -2199,6 +2346,8 @@ namespace nslib {
         protected:
             std::map<tag_t, Producer> _producers;
             std::map<tag_t, Reducer> _reducers;
+            std::vector<Producer> _indexedProducers;
+            std::vector<Reducer> _indexedReducers;
         };
     }
 
@@ -2378,25 +2527,68 @@ namespace nslib {
     };
 #endif
 
-    /** Trait interface which adds a reference count. */
+    /**
+     * Trait interface which adds an intrusive reference count.
+     * Counts are atomic by default. Processes which only ever touch ref-counted objects from
+     * a single thread can call `IRefCountable::useThreadSafeRefCounts(false)` to skip the
+     * read-modify-write instructions. Counts go back to being atomic for as long as any
+     * `IRefCountable::HelperThread` is alive.
+     */
     class IRefCountable {
     public:
-        IRefCountable() : _nslibGCMutex(new rtmutex_t), _nslibRefCount(0), _nslibRefDisable(false) {}
+        IRefCountable() = default;
+
+        /** Copies start out with their own, fresh reference count. */
+        IRefCountable(const IRefCountable&) : IRefCountable() {}
+        IRefCountable& operator=(const IRefCountable&) { return *this; }
+
         virtual ~IRefCountable() {
-            for ( const auto& pair : _onFreeCallbacks ) {
-                pair.second();
+            if ( _onFreeCallbacks != nullptr ) {
+                for ( const auto& pair : _onFreeCallbacks->callbacks ) {
+                    pair.second();
+                }
+                delete _onFreeCallbacks;
             }
-            _nslibGCMutex->release();
         }
 
+        /**
+         * Enable/disable atomic reference counting for all instances. Only disable this when
+         * no ref-counted objects will be shared across threads for the rest of the process.
+         */
+        static void useThreadSafeRefCounts(bool threadSafe) {
+            _nslibThreadSafe.store(threadSafe, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] static bool usingThreadSafeRefCounts() {
+            return _nslibThreadSafe.load(std::memory_order_relaxed)
+                || _nslibHelperThreads.load(std::memory_order_relaxed) > 0;
+        }
+
+        /**
+         * Marks a helper thread (e.g. a lease heartbeat) as running next to the thread that
+         * owns the VM. Construct it before spawning the thread and destroy it after joining,
+         * so both sides see atomic counts for the whole lifetime of the helper.
+         */
+        class HelperThread {
+        public:
+            HelperThread() { _nslibHelperThreads.fetch_add(1, std::memory_order_seq_cst); }
+            ~HelperThread() { _nslibHelperThreads.fetch_sub(1, std::memory_order_seq_cst); }
+
+            HelperThread(const HelperThread&) = delete;
+            HelperThread& operator=(const HelperThread&) = delete;
+        };
+
         /**
          * WARNING: DO NOT CALL DIRECTLY
          * Instead, call `useref(...)`.
          * Increment the reference count.
          */
-        virtual void nslibIncRef(rtmutex_t& gcMutex) {
-            std::lock_guard<rtmutex_t> guard(gcMutex);
-            _nslibRefCount += 1;
+        void nslibIncRef() {
+            if ( usingThreadSafeRefCounts() ) {
+                _nslibRefCount.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                _nslibRefCount.store(_nslibRefCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
 
 #ifdef NSLIB_GC_DEBUG_FREE
             if ( _nslibWouldHaveFreed ) {
@@ -2405,6 +2597,7 @@ namespace nslib {
 #endif
 
 #ifdef NSLIB_GC_TRACK
+            std::lock_guard<std::mutex> guard(_tracksMutex);
             if ( !_registeredShutdown ) {
                 Framework::onShutdown([]() {
                     if ( _tracks.empty() ) {
@@ -2442,39 +2635,57 @@ namespace nslib {
         /**
          * WARNING: DO NOT CALL DIRECTLY
          * Instead, call `freeref(...)`.
-         * Decrement the reference count.
+         * Decrement the reference count. Returns true if this released the last reference.
          */
-        virtual void nslibDecRef(rtmutex_t& gcMutex) {
-            std::lock_guard<rtmutex_t> guard(gcMutex);
-            _nslibRefCount -= 1;
+        bool nslibDecRef() {
+            std::size_t previous;
+            if ( usingThreadSafeRefCounts() ) {
+                previous = _nslibRefCount.fetch_sub(1, std::memory_order_acq_rel);
+            } else {
+                previous = _nslibRefCount.load(std::memory_order_relaxed);
+                _nslibRefCount.store(previous - 1, std::memory_order_relaxed);
+            }
 
 #ifdef NSLIB_GC_TRACK
+            std::lock_guard<std::mutex> guard(_tracksMutex);
             auto iter = _tracks.find(_nslibRefId);
             if ( iter == _tracks.end() ) {
                 _tracks[_nslibRefId] = {{}, {trace()}};
             } else {
                 iter->second.second.emplace_back(trace());  // FIXME: push back?
 
-                if ( nslibShouldFree(*nslibGCMutex()) && iter->second.first.size() == iter->second.second.size() ) {
+                if ( previous == 1 && iter->second.first.size() == iter->second.second.size() ) {
                     _tracks.erase(iter);
                 }
             }
 #endif
+
+            return previous == 1;
         }
 
 #ifdef NSLIB_GC_TRACK
-        [[nodiscard]] static GCTracks nslibGCTracks() { return _tracks; }
+        [[nodiscard]] static GCTracks nslibGCTracks() {
+            std::lock_guard<std::mutex> guard(_tracksMutex);
+            return _tracks;
+        }
 #endif
 
-        virtual void nslibNoRef(rtmutex_t& gcMutex) {
-            std::lock_guard<rtmutex_t> guard(gcMutex);
-            _nslibRefDisable = true;
+        void nslibNoRef() {
+            _nslibRefDisable.store(true, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] bool nslibRefDisabled() const {
+            return _nslibRefDisable.load(std::memory_order_relaxed);
         }
 
         /** If true, the instance can be deleted. */
-        [[nodiscard]] virtual bool nslibShouldFree(rtmutex_t& gcMutex) const {
-            std::lock_guard<rtmutex_t> guard(gcMutex);
-            return !_nslibRefDisable && _nslibRefCount < 1;
+        [[nodiscard]] bool nslibShouldFree() const {
+            return !nslibRefDisabled() && _nslibRefCount.load(std::memory_order_acquire) < 1;
+        }
+
+        /** If true, the caller holds the only reference to the instance, so nothing else can observe it. */
+        [[nodiscard]] bool nslibUniquelyOwned() const {
+            return !nslibRefDisabled() && _nslibRefCount.load(std::memory_order_acquire) == 1;
         }
 
 #ifdef NSLIB_GC_DEBUG_FREE
@@ -2487,27 +2698,32 @@ namespace nslib {
 #endif
 
         virtual std::size_t nslibOnFree(std::function<void()> callback) {
-            auto id = _nextOnFreeCallbackId++;
-            _onFreeCallbacks[id] = std::move(callback);
+            if ( _onFreeCallbacks == nullptr ) {
+                _onFreeCallbacks = new OnFreeCallbacks;
+            }
+
+            auto id = _onFreeCallbacks->nextId++;
+            _onFreeCallbacks->callbacks[id] = std::move(callback);
             return id;
         }
 
         virtual void nslibUnregisterOnFree(std::size_t id) {
-            auto iter = _onFreeCallbacks.find(id);
-            if ( iter != _onFreeCallbacks.end() ) {
-                _onFreeCallbacks.erase(iter);
-            }
-        }
-
-        [[nodiscard]] rtmutex_t* nslibGCMutex() {
-            return _nslibGCMutex;
+            if ( _onFreeCallbacks == nullptr ) return;
+            _onFreeCallbacks->callbacks.erase(id);
         }
     protected:
-        rtmutex_t* _nslibGCMutex;
-        std::size_t _nslibRefCount;
-        bool _nslibRefDisable;
-        std::map<std::size_t, std::function<void()>> _onFreeCallbacks;
-        std::size_t _nextOnFreeCallbackId = 1;
+        /** Allocated the first time a callback is registered, since most instances never have one. */
+        struct OnFreeCallbacks {
+            std::map<std::size_t, std::function<void()>> callbacks;
+            std::size_t nextId = 1;
+        };
+
+        std::atomic<std::size_t> _nslibRefCount = 0;
+        std::atomic<bool> _nslibRefDisable = false;
+        OnFreeCallbacks* _onFreeCallbacks = nullptr;
+
+        static inline std::atomic<bool> _nslibThreadSafe = true;
+        static inline std::atomic<std::size_t> _nslibHelperThreads = 0;
 
 #ifdef NSLIB_GC_DEBUG_FREE
         bool _nslibWouldHaveFreed = false;
@@ -2517,6 +2733,7 @@ namespace nslib {
 #ifdef NSLIB_GC_TRACK
         std::string _nslibRefId = uuid();
         static GCTracks _tracks;
+        static std::mutex _tracksMutex;
         static bool _registeredShutdown;
 #endif
     };
@@ -2533,17 +2750,14 @@ namespace nslib {
     /** Open a new reference to some instance. */
     auto useref(priv::RefCountable auto r) {
         if ( r == nullptr ) return r;
-        std::lock_guard<rtmutex_t> guard(*r->nslibGCMutex());
-        r->nslibIncRef(*r->nslibGCMutex());
+        r->nslibIncRef();
         return r;
     }
 
     /** Release a reference to some instance and clean it up if necessary. */
     void freeref(priv::RefCountable auto r) {
         if ( r == nullptr ) return;
-        std::lock_guard<rtmutex_t> guard(*r->nslibGCMutex());
-        r->nslibDecRef(*r->nslibGCMutex());
-        if ( r->nslibShouldFree(*r->nslibGCMutex()) ) {
+        if ( r->nslibDecRef() && !r->nslibRefDisabled() ) {
 #ifdef NSLIB_GC_DEBUG_FREE
             r->nslibMarkWouldHaveFreed();
 #else
@@ -2557,8 +2771,7 @@ namespace nslib {
     /** Release a reference to some instance but DO NOT clean it up. */
     void releaseref(priv::RefCountable auto r) {
         if ( r == nullptr ) return;
-        std::lock_guard<rtmutex_t> guard(*r->nslibGCMutex());
-        r->nslibDecRef(*r->nslibGCMutex());
+        r->nslibDecRef();
     }
 
     /** Release an old reference and use a new one, if they are different. */
@@ -1,3 +1,7 @@
+#include <array>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
 #include "ISA.h"
 
 namespace nslib {
@@ -24,6 +28,62 @@ namespace nslib {
 
 namespace swarmc::ISA {
 
+    std::atomic<std::size_t> LocationReference::_nextSlot = 0;
+
+    /**
+     * Process-wide table of the slots shared by name. The table is split into stripes by
+     * name, each with its own mutex, so threads constructing unrelated locations don't
+     * contend. Copies of a location only touch the entry's atomic count.
+     */
+    struct InternedSlots {
+        static constexpr std::size_t STRIPES = 64;
+
+        struct Stripe {
+            std::mutex mutex;
+            std::unordered_map<std::string, InternedSlot*> slots;
+        };
+
+        std::array<Stripe, STRIPES> stripes;
+
+        Stripe& stripeFor(const std::string& fqName) {
+            return stripes[std::hash<std::string>{}(fqName) % STRIPES];
+        }
+    };
+
+    static InternedSlots& internedSlots() {
+        // Intentionally never freed, since locations may be released during static destruction
+        static auto slots = new InternedSlots;
+        return *slots;
+    }
+
+    InternedSlot* LocationReference::acquireSlot(const std::string& fqName) {
+        auto& stripe = internedSlots().stripeFor(fqName);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+
+        auto iter = stripe.slots.find(fqName);
+        if ( iter == stripe.slots.end() ) {
+            iter = stripe.slots.emplace(fqName, new InternedSlot(_nextSlot.fetch_add(1, std::memory_order_relaxed))).first;
+        }
+
+        // (this may revive an entry whose count just dropped to 0; releaseSlot re-checks under the lock)
+        iter->second->users.fetch_add(1, std::memory_order_relaxed);
+        return iter->second;
+    }
+
+    void LocationReference::releaseSlot(InternedSlot* interned, const std::string& fqName) {
+        if ( interned->users.fetch_sub(1, std::memory_order_acq_rel) != 1 ) return;
+
+        // The entry may have been revived or freed since, so only go through the table from here
+        auto& stripe = internedSlots().stripeFor(fqName);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+
+        auto iter = stripe.slots.find(fqName);
+        if ( iter != stripe.slots.end() && iter->second->users.load(std::memory_order_acquire) == 0 ) {
+            delete iter->second;
+            stripe.slots.erase(iter);
+        }
+    }
+
     std::string Instruction::tagName(Tag tag) {
         if ( tag == Tag::POSITION ) return "POSITION";
         if ( tag == Tag::BEGINFN ) return "BEGINFN";
@@ -1,6 +1,7 @@
 #ifndef SWARMVM_ISA
 #define SWARMVM_ISA
 
+#include <atomic>
 #include <utility>
 #include <vector>
 #include "../shared/nslib.h"
@@ -184,17 +185,30 @@ namespace swarmc::ISA {
             return s(tag());
         }
 
+        [[nodiscard]] serial::index_t getSerialIndex() const override {
+            return static_cast<serial::index_t>(tag());
+        }
+
     protected:
         ReferenceTag _tag;
     };
 
+    /** A slot shared by every location with the same fully-qualified name, counting the locations using it. */
+    struct InternedSlot {
+        explicit InternedSlot(std::size_t slot) : slot(slot) {}
+
+        const std::size_t slot;
+        std::atomic<std::size_t> users = 0;
+    };
+
     /** A variable / A value in storage */
     class LocationReference : public Reference {
     public:
-        LocationReference(Affinity affinity, std::string name) : Reference(ReferenceTag::LOCATION), _affinity(affinity), _name(std::move(name)) {}
+        LocationReference(Affinity affinity, std::string name) : LocationReference(affinity, std::move(name), true) {}
 
         ~LocationReference() override {
             freeref(_type);
+            if ( _interned != nullptr ) releaseSlot(_interned, _fqName);
         }
 
         /** Convert the given affinity value to a human-readable representation. */
@@ -210,7 +224,7 @@ namespace swarmc::ISA {
         bool isEqualTo(const Reference* other) const override {
             if ( other->tag() == ReferenceTag::LOCATION ) {
                 auto loc = (LocationReference*) other;
-                if ( loc->affinity() == affinity() && loc->name() == name() ) return true;
+                if ( loc->slot() == slot() ) return true;
             }
 
             throw Errors::SwarmError("Cannot directly compare the equality of two different locations.");
@@ -222,22 +236,36 @@ namespace swarmc::ISA {
         }
 
         /** Get the variable name of this location. */
-        [[nodiscard]] std::string name() const {
+        [[nodiscard]] const std::string& name() const {
             return _name;
         }
 
         /** Get the location-prefixed name of this location (e.g. `l:my_var`) */
-        [[nodiscard]] std::string fqName() const {
-            return affinityString(_affinity) + ":" + _name;
+        [[nodiscard]] const std::string& fqName() const {
+            return _fqName;
+        }
+
+        /**
+         * Get the slot number resolved for this location when it was constructed.
+         * Locations with the same fully-qualified name share a slot, except shadowed
+         * locations, which each get their own. Slot numbers are never reused.
+         */
+        [[nodiscard]] std::size_t slot() const {
+            return _slot;
+        }
+
+        /** Create a new location which shadows this one, named `<name>@<suffix>`, with its own slot. */
+        [[nodiscard]] LocationReference* shadowedAs(const std::string& suffix) const {
+            return new LocationReference(_affinity, _name + "@" + suffix, false);
         }
 
         [[nodiscard]] std::string toString() const override {
-            return "Location<" + affinityString(_affinity) + ":" + _name + ">";
+            return "Location<" + _fqName + ">";
         }
 
         [[nodiscard]] Type::Type* type() const override {
             if ( _type == nullptr )
-                return new Type::Ambiguous();
+                return Type::Ambiguous::of();
 
             return _type;
         }
@@ -252,23 +280,49 @@ namespace swarmc::ISA {
         /** Returns true if the given location refers to the same place as this one. */
         virtual bool is(const LocationReference* other) const {
             return (
-                other->affinity() == _affinity
-                && other->name() == _name
+                other->slot() == _slot
                 && other->type()->isAssignableTo(type())
                 && type()->isAssignableTo(other->type())
             );
         }
 
         [[nodiscard]] LocationReference* copy() const override {
-            auto t = new LocationReference(_affinity, _name);
+            auto t = new LocationReference(*this);
             if ( _type != nullptr ) t->setType(_type);
             return t;
         }
 
     protected:
+        LocationReference(Affinity affinity, std::string name, bool interned) : Reference(ReferenceTag::LOCATION), _affinity(affinity), _name(std::move(name)) {
+            _fqName = affinityString(_affinity) + ":" + _name;
+            if ( interned ) {
+                _interned = acquireSlot(_fqName);
+                _slot = _interned->slot;
+            } else {
+                _slot = _nextSlot.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        LocationReference(const LocationReference& other) : Reference(ReferenceTag::LOCATION), _affinity(other._affinity),
+            _name(other._name), _fqName(other._fqName), _slot(other._slot), _interned(other._interned) {
+            // We already hold the entry through `other`, so it can't be freed out from under us
+            if ( _interned != nullptr ) _interned->users.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /** Get the shared slot for the given fully-qualified name, allocating one the first time it's seen. */
+        static InternedSlot* acquireSlot(const std::string& fqName);
+
+        /** Release a reference to the shared slot for the given name, freeing it if it was the last one. */
+        static void releaseSlot(InternedSlot*, const std::string& fqName);
+
         Affinity _affinity;
         std::string _name;
+        std::string _fqName;
+        std::size_t _slot;
+        InternedSlot* _interned = nullptr;  // nullptr for shadowed locations
         Type::Type* _type = nullptr;
+
+        static std::atomic<std::size_t> _nextSlot;
     };
 
 
@@ -353,15 +407,15 @@ namespace swarmc::ISA {
             auto params = _fn->paramTypes();
             auto returnType = _fn->returnType();
             if ( params.empty() ) {
-                return new Type::Lambda0(returnType);
+                return Type::Lambda0::of(returnType);
             }
 
             Type::Lambda1* t = nullptr;
             for ( auto it = params.rbegin(); it < params.rend(); ++it ) {
                 if ( t == nullptr ) {
-                    t = new Type::Lambda1(*it, returnType);
+                    t = Type::Lambda1::of(*it, returnType);
                 } else {
-                    t = new Type::Lambda1(*it, t);
+                    t = Type::Lambda1::of(*it, t);
                 }
             }
             return t;
@@ -671,7 +725,7 @@ namespace swarmc::ISA {
             return _value;
         }
     protected:
-        const T _value;
+        T _value;
     };
 
     /** A literal string value */
@@ -699,7 +753,7 @@ namespace swarmc::ISA {
     };
 
     /** A literal number value */
-    class NumberReference : public LiteralReference<double> {
+    class NumberReference : public LiteralReference<double>, public IPoolAllocated<NumberReference> {
     public:
         explicit NumberReference(double value) : LiteralReference<double>(ReferenceTag::NUMBER, value) {}
 
@@ -720,11 +774,36 @@ namespace swarmc::ISA {
         [[nodiscard]] NumberReference* copy() const override {
             return new NumberReference(_value);
         }
+
+        /** Replace the wrapped value. Only valid while the caller holds the only reference to this instance. */
+        void overwrite(double value) {
+            _value = value;
+        }
     };
 
     /** A literal boolean value */
     class BooleanReference : public LiteralReference<bool> {
     public:
+        /**
+         * Get the shared, immutable reference for the given boolean value.
+         * Prefer this to allocating a new BooleanReference.
+         */
+        static BooleanReference* of(bool value) {
+            static BooleanReference* trueRef = [] {
+                auto r = useref(new BooleanReference(true));
+                GC_ON_SHUTDOWN(r)
+                return r;
+            }();
+
+            static BooleanReference* falseRef = [] {
+                auto r = useref(new BooleanReference(false));
+                GC_ON_SHUTDOWN(r)
+                return r;
+            }();
+
+            return value ? trueRef : falseRef;
+        }
+
         explicit BooleanReference(bool value) : LiteralReference<bool>(ReferenceTag::BOOLEAN, value) {}
 
         [[nodiscard]] std::string toString() const override {
@@ -743,7 +822,7 @@ namespace swarmc::ISA {
         }
 
         [[nodiscard]] BooleanReference* copy() const override {
-            return new BooleanReference(_value);
+            return BooleanReference::of(_value);
         }
     };
 
@@ -765,7 +844,7 @@ namespace swarmc::ISA {
         }
 
         [[nodiscard]] Type::Enumerable* type() const override {
-            return new Type::Enumerable(_innerType);
+            return Type::Enumerable::of(_innerType);
         }
 
         /** Add an item to the end of this enumeration. */
@@ -856,7 +935,7 @@ namespace swarmc::ISA {
         }
 
         [[nodiscard]] Type::Map* type() const override {
-            return new Type::Map(_innerType);
+            return Type::Map::of(_innerType);
         }
 
         /** Get the element at the given key. */
@@ -1,6 +1,7 @@
 #ifndef SWARMVM_ISAWALK
 #define SWARMVM_ISAWALK
 
+#include <array>
 #include "../errors/SwarmError.h"
 #include "../shared/nslib.h"
 #include "isa_meta.h"
@@ -27,104 +28,139 @@ namespace swarmc::ISA {
         }
 
         virtual TReturn walkOne(Instruction* inst) {
-            if ( inst->tag() == Tag::POSITION ) return walkPosition((PositionAnnotation*) inst);
-            if ( inst->tag() == Tag::PLUS ) return walkPlus((Plus*) inst);
-            if ( inst->tag() == Tag::MINUS ) return walkMinus((Minus*) inst);
-            if ( inst->tag() == Tag::TIMES ) return walkTimes((Times*) inst);
-            if ( inst->tag() == Tag::DIVIDE ) return walkDivide((Divide*) inst);
-            if ( inst->tag() == Tag::POWER ) return walkPower((Power*) inst);
-            if ( inst->tag() == Tag::MOD ) return walkMod((Mod*) inst);
-            if ( inst->tag() == Tag::NEG ) return walkNegative((Negative*) inst);
-            if ( inst->tag() == Tag::GT ) return walkGreaterThan((GreaterThan*) inst);
-            if ( inst->tag() == Tag::GTE ) return walkGreaterThanOrEqual((GreaterThanOrEqual*) inst);
-            if ( inst->tag() == Tag::LT ) return walkLessThan((LessThan*) inst);
-            if ( inst->tag() == Tag::LTE ) return walkLessThanOrEqual((LessThanOrEqual*) inst);
-            if ( inst->tag() == Tag::WHILE ) return walkWhile((While*) inst);
-            if ( inst->tag() == Tag::WITH ) return walkWith((With*) inst);
-            if ( inst->tag() == Tag::ENUMINIT ) return walkEnumInit((EnumInit*) inst);
-            if ( inst->tag() == Tag::ENUMAPPEND ) return walkEnumAppend((EnumAppend*) inst);
-            if ( inst->tag() == Tag::ENUMPREPEND ) return walkEnumPrepend((EnumPrepend*) inst);
-            if ( inst->tag() == Tag::ENUMLENGTH ) return walkEnumLength((EnumLength*) inst);
-            if ( inst->tag() == Tag::ENUMGET ) return walkEnumGet((EnumGet*) inst);
-            if ( inst->tag() == Tag::ENUMSET ) return walkEnumSet((EnumSet*) inst);
-            if ( inst->tag() == Tag::ENUMCONCAT ) return walkEnumConcat((EnumConcat*) inst);
-            if ( inst->tag() == Tag::ENUMERATE ) return walkEnumerate((Enumerate*) inst);
-            if ( inst->tag() == Tag::BEGINFN ) return walkBeginFunction((BeginFunction*) inst);
-            if ( inst->tag() == Tag::FNPARAM ) return walkFunctionParam((FunctionParam*) inst);
-            if ( inst->tag() == Tag::RETURN1 ) return walkReturn1((Return1*) inst);
-            if ( inst->tag() == Tag::RETURN0 ) return walkReturn0((Return0*) inst);
-            if ( inst->tag() == Tag::CURRY ) return walkCurry((Curry*) inst);
-            if ( inst->tag() == Tag::CALL0 ) return walkCall0((Call0*) inst);
-            if ( inst->tag() == Tag::CALL1 ) return walkCall1((Call1*) inst);
-            if ( inst->tag() == Tag::CALLIF0 ) return walkCallIf0((CallIf0*) inst);
-            if ( inst->tag() == Tag::CALLIF1 ) return walkCallIf1((CallIf1*) inst);
-            if ( inst->tag() == Tag::CALLELSE0 ) return walkCallElse0((CallElse0*) inst);
-            if ( inst->tag() == Tag::CALLELSE1 ) return walkCallElse1((CallElse1*) inst);
-            if ( inst->tag() == Tag::PUSHCALL0 ) return walkPushCall0((PushCall0*) inst);
-            if ( inst->tag() == Tag::PUSHCALL1 ) return walkPushCall1((PushCall1*) inst);
-            if ( inst->tag() == Tag::PUSHCALLIF0 ) return walkPushCallIf0((PushCallIf0*) inst);
-            if ( inst->tag() == Tag::PUSHCALLIF1 ) return walkPushCallIf1((PushCallIf1*) inst);
-            if ( inst->tag() == Tag::PUSHCALLELSE0 ) return walkPushCallElse0((PushCallElse0*) inst);
-            if ( inst->tag() == Tag::PUSHCALLELSE1 ) return walkPushCallElse1((PushCallElse1*) inst);
-            if ( inst->tag() == Tag::DRAIN ) return walkDrain((Drain*) inst);
-            if ( inst->tag() == Tag::RETMAPHAS ) return walkRetMapHas((RetMapHas*) inst);
-            if ( inst->tag() == Tag::RETMAPGET ) return walkRetMapGet((RetMapGet*) inst);
-            if ( inst->tag() == Tag::ENTERCONTEXT ) return walkEnterContext((EnterContext*) inst);
-            if ( inst->tag() == Tag::RESUMECONTEXT ) return walkResumeContext((ResumeContext*) inst);
-            if ( inst->tag() == Tag::POPCONTEXT ) return walkPopContext((PopContext*) inst);
-            if ( inst->tag() == Tag::EXIT ) return walkExit((Exit*) inst);
-            if ( inst->tag() == Tag::MAPINIT ) return walkMapInit((MapInit*) inst);
-            if ( inst->tag() == Tag::MAPSET ) return walkMapSet((MapSet*) inst);
-            if ( inst->tag() == Tag::MAPGET ) return walkMapGet((MapGet*) inst);
-            if ( inst->tag() == Tag::MAPLENGTH ) return walkMapLength((MapLength*) inst);
-            if ( inst->tag() == Tag::MAPKEYS ) return walkMapKeys((MapKeys*) inst);
-            if ( inst->tag() == Tag::TYPIFY ) return walkTypify((Typify*) inst);
-            if ( inst->tag() == Tag::ASSIGNVALUE ) return walkAssignValue((AssignValue*) inst);
-            if ( inst->tag() == Tag::ASSIGNEVAL ) return walkAssignEval((AssignEval*) inst);
-            if ( inst->tag() == Tag::LOCK ) return walkLock((Lock*) inst);
-            if ( inst->tag() == Tag::UNLOCK ) return walkUnlock((Unlock*) inst);
-            if ( inst->tag() == Tag::EQUAL ) return walkIsEqual((IsEqual*) inst);
-            if ( inst->tag() == Tag::SCOPEOF ) return walkScopeOf((ScopeOf*) inst);
-            if ( inst->tag() == Tag::STREAMINIT ) return walkStreamInit((StreamInit*) inst);
-            if ( inst->tag() == Tag::STREAMPUSH ) return walkStreamPush((StreamPush*) inst);
-            if ( inst->tag() == Tag::STREAMPOP ) return walkStreamPop((StreamPop*) inst);
-            if ( inst->tag() == Tag::STREAMCLOSE ) return walkStreamClose((StreamClose*) inst);
-            if ( inst->tag() == Tag::STREAMEMPTY ) return walkStreamEmpty((StreamEmpty*) inst);
-            if ( inst->tag() == Tag::OUT ) return walkOut((Out*) inst);
-            if ( inst->tag() == Tag::ERR ) return walkErr((Err*) inst);
-            if ( inst->tag() == Tag::STRCONCAT ) return walkStringConcat((StringConcat*) inst);
-            if ( inst->tag() == Tag::STRLENGTH ) return walkStringLength((StringLength*) inst);
-            if ( inst->tag() == Tag::STRSLICEFROM ) return walkStringSliceFrom((StringSliceFrom*) inst);
-            if ( inst->tag() == Tag::STRSLICEFROMTO ) return walkStringSliceFromTo((StringSliceFromTo*) inst);
-            if ( inst->tag() == Tag::TYPEOF ) return walkTypeOf((TypeOf*) inst);
-            if ( inst->tag() == Tag::COMPATIBLE ) return walkIsCompatible((IsCompatible*) inst);
-            if ( inst->tag() == Tag::PUSHEXHANDLER1 ) return walkPushExceptionHandler1((PushExceptionHandler1*) inst);
-            if ( inst->tag() == Tag::PUSHEXHANDLER2 ) return walkPushExceptionHandler2((PushExceptionHandler2*) inst);
-            if ( inst->tag() == Tag::POPEXHANDLER ) return walkPopExceptionHandler((PopExceptionHandler*) inst);
-            if ( inst->tag() == Tag::RAISE ) return walkRaise((Raise*) inst);
-            if ( inst->tag() == Tag::RESUME ) return walkResume((Resume*) inst);
-            if ( inst->tag() == Tag::AND ) return walkAnd((And*) inst);
-            if ( inst->tag() == Tag::OR ) return walkOr((Or*) inst);
-            if ( inst->tag() == Tag::XOR ) return walkXor((Xor*) inst);
-            if ( inst->tag() == Tag::NAND ) return walkNand((Nand*) inst);
-            if ( inst->tag() == Tag::NOR ) return walkNor((Nor*) inst);
-            if ( inst->tag() == Tag::NOT ) return walkNot((Not*) inst);
-            if ( inst->tag() == Tag::OTYPEINIT ) return walkOTypeInit((OTypeInit*) inst);
-            if ( inst->tag() == Tag::OTYPEPROP ) return walkOTypeProp((OTypeProp*) inst);
-            if ( inst->tag() == Tag::OTYPEDEL ) return walkOTypeDel((OTypeDel*) inst);
-            if ( inst->tag() == Tag::OTYPEGET ) return walkOTypeGet((OTypeGet*) inst);
-            if ( inst->tag() == Tag::OTYPEFINALIZE ) return walkOTypeFinalize((OTypeFinalize*) inst);
-            if ( inst->tag() == Tag::OTYPESUBSET ) return walkOTypeSubset((OTypeSubset*) inst);
-            if ( inst->tag() == Tag::OBJINIT ) return walkObjInit((ObjInit*) inst);
-            if ( inst->tag() == Tag::OBJSET ) return walkObjSet((ObjSet*) inst);
-            if ( inst->tag() == Tag::OBJGET ) return walkObjGet((ObjGet*) inst);
-            if ( inst->tag() == Tag::OBJINSTANCE ) return walkObjInstance((ObjInstance*) inst);
-            if ( inst->tag() == Tag::OBJCURRY ) return walkObjCurry((ObjCurry*) inst);
-
-            throw Errors::SwarmError("Invalid instruction tag: " + inst->toString());
+            auto tag = static_cast<std::size_t>(inst->tag());
+            if ( tag >= DISPATCH_TABLE_SIZE ) {
+                throw Errors::SwarmError("Invalid instruction tag: " + inst->toString());
+            }
+
+            auto handler = dispatchTable()[tag];
+            if ( handler == nullptr ) {
+                throw Errors::SwarmError("Invalid instruction tag: " + inst->toString());
+            }
+
+            return handler(this, inst);
         }
 
     protected:
+        /** Type-erased entry point for a single `walkX` handler. */
+        using Handler = TReturn (*)(ISAWalk<TReturn>*, Instruction*);
+
+        /** One slot per ISA::Tag, indexed by the tag's underlying value. */
+        static constexpr std::size_t DISPATCH_TABLE_SIZE = static_cast<std::size_t>(Tag::OBJCURRY) + 1;
+        using DispatchTable = std::array<Handler, DISPATCH_TABLE_SIZE>;
+
+        /** Downcast `inst` to its concrete instruction class and forward it to the (virtual) handler. */
+        template <typename TInstruction, TReturn (ISAWalk<TReturn>::*walkX)(TInstruction*)>
+        static TReturn dispatch(ISAWalk<TReturn>* walk, Instruction* inst) {
+            return (walk->*walkX)(static_cast<TInstruction*>(inst));
+        }
+
+        /**
+         * Jump table mapping each instruction tag to its handler. This is built once, at compile time,
+         * so dispatching an instruction is a single indexed load + call rather than a chain of tag compares.
+         */
+        static const DispatchTable& dispatchTable() {
+            static constexpr DispatchTable table = [] {
+                DispatchTable t {};
+                t[static_cast<std::size_t>(Tag::POSITION)] = &dispatch<PositionAnnotation, &ISAWalk<TReturn>::walkPosition>;
+                t[static_cast<std::size_t>(Tag::PLUS)] = &dispatch<Plus, &ISAWalk<TReturn>::walkPlus>;
+                t[static_cast<std::size_t>(Tag::MINUS)] = &dispatch<Minus, &ISAWalk<TReturn>::walkMinus>;
+                t[static_cast<std::size_t>(Tag::TIMES)] = &dispatch<Times, &ISAWalk<TReturn>::walkTimes>;
+                t[static_cast<std::size_t>(Tag::DIVIDE)] = &dispatch<Divide, &ISAWalk<TReturn>::walkDivide>;
+                t[static_cast<std::size_t>(Tag::POWER)] = &dispatch<Power, &ISAWalk<TReturn>::walkPower>;
+                t[static_cast<std::size_t>(Tag::MOD)] = &dispatch<Mod, &ISAWalk<TReturn>::walkMod>;
+                t[static_cast<std::size_t>(Tag::NEG)] = &dispatch<Negative, &ISAWalk<TReturn>::walkNegative>;
+                t[static_cast<std::size_t>(Tag::GT)] = &dispatch<GreaterThan, &ISAWalk<TReturn>::walkGreaterThan>;
+                t[static_cast<std::size_t>(Tag::GTE)] = &dispatch<GreaterThanOrEqual, &ISAWalk<TReturn>::walkGreaterThanOrEqual>;
+                t[static_cast<std::size_t>(Tag::LT)] = &dispatch<LessThan, &ISAWalk<TReturn>::walkLessThan>;
+                t[static_cast<std::size_t>(Tag::LTE)] = &dispatch<LessThanOrEqual, &ISAWalk<TReturn>::walkLessThanOrEqual>;
+                t[static_cast<std::size_t>(Tag::WHILE)] = &dispatch<While, &ISAWalk<TReturn>::walkWhile>;
+                t[static_cast<std::size_t>(Tag::WITH)] = &dispatch<With, &ISAWalk<TReturn>::walkWith>;
+                t[static_cast<std::size_t>(Tag::ENUMINIT)] = &dispatch<EnumInit, &ISAWalk<TReturn>::walkEnumInit>;
+                t[static_cast<std::size_t>(Tag::ENUMAPPEND)] = &dispatch<EnumAppend, &ISAWalk<TReturn>::walkEnumAppend>;
+                t[static_cast<std::size_t>(Tag::ENUMPREPEND)] = &dispatch<EnumPrepend, &ISAWalk<TReturn>::walkEnumPrepend>;
+                t[static_cast<std::size_t>(Tag::ENUMLENGTH)] = &dispatch<EnumLength, &ISAWalk<TReturn>::walkEnumLength>;
+                t[static_cast<std::size_t>(Tag::ENUMGET)] = &dispatch<EnumGet, &ISAWalk<TReturn>::walkEnumGet>;
+                t[static_cast<std::size_t>(Tag::ENUMSET)] = &dispatch<EnumSet, &ISAWalk<TReturn>::walkEnumSet>;
+                t[static_cast<std::size_t>(Tag::ENUMCONCAT)] = &dispatch<EnumConcat, &ISAWalk<TReturn>::walkEnumConcat>;
+                t[static_cast<std::size_t>(Tag::ENUMERATE)] = &dispatch<Enumerate, &ISAWalk<TReturn>::walkEnumerate>;
+                t[static_cast<std::size_t>(Tag::BEGINFN)] = &dispatch<BeginFunction, &ISAWalk<TReturn>::walkBeginFunction>;
+                t[static_cast<std::size_t>(Tag::FNPARAM)] = &dispatch<FunctionParam, &ISAWalk<TReturn>::walkFunctionParam>;
+                t[static_cast<std::size_t>(Tag::RETURN1)] = &dispatch<Return1, &ISAWalk<TReturn>::walkReturn1>;
+                t[static_cast<std::size_t>(Tag::RETURN0)] = &dispatch<Return0, &ISAWalk<TReturn>::walkReturn0>;
+                t[static_cast<std::size_t>(Tag::CURRY)] = &dispatch<Curry, &ISAWalk<TReturn>::walkCurry>;
+                t[static_cast<std::size_t>(Tag::CALL0)] = &dispatch<Call0, &ISAWalk<TReturn>::walkCall0>;
+                t[static_cast<std::size_t>(Tag::CALL1)] = &dispatch<Call1, &ISAWalk<TReturn>::walkCall1>;
+                t[static_cast<std::size_t>(Tag::CALLIF0)] = &dispatch<CallIf0, &ISAWalk<TReturn>::walkCallIf0>;
+                t[static_cast<std::size_t>(Tag::CALLIF1)] = &dispatch<CallIf1, &ISAWalk<TReturn>::walkCallIf1>;
+                t[static_cast<std::size_t>(Tag::CALLELSE0)] = &dispatch<CallElse0, &ISAWalk<TReturn>::walkCallElse0>;
+                t[static_cast<std::size_t>(Tag::CALLELSE1)] = &dispatch<CallElse1, &ISAWalk<TReturn>::walkCallElse1>;
+                t[static_cast<std::size_t>(Tag::PUSHCALL0)] = &dispatch<PushCall0, &ISAWalk<TReturn>::walkPushCall0>;
+                t[static_cast<std::size_t>(Tag::PUSHCALL1)] = &dispatch<PushCall1, &ISAWalk<TReturn>::walkPushCall1>;
+                t[static_cast<std::size_t>(Tag::PUSHCALLIF0)] = &dispatch<PushCallIf0, &ISAWalk<TReturn>::walkPushCallIf0>;
+                t[static_cast<std::size_t>(Tag::PUSHCALLIF1)] = &dispatch<PushCallIf1, &ISAWalk<TReturn>::walkPushCallIf1>;
+                t[static_cast<std::size_t>(Tag::PUSHCALLELSE0)] = &dispatch<PushCallElse0, &ISAWalk<TReturn>::walkPushCallElse0>;
+                t[static_cast<std::size_t>(Tag::PUSHCALLELSE1)] = &dispatch<PushCallElse1, &ISAWalk<TReturn>::walkPushCallElse1>;
+                t[static_cast<std::size_t>(Tag::DRAIN)] = &dispatch<Drain, &ISAWalk<TReturn>::walkDrain>;
+                t[static_cast<std::size_t>(Tag::RETMAPHAS)] = &dispatch<RetMapHas, &ISAWalk<TReturn>::walkRetMapHas>;
+                t[static_cast<std::size_t>(Tag::RETMAPGET)] = &dispatch<RetMapGet, &ISAWalk<TReturn>::walkRetMapGet>;
+                t[static_cast<std::size_t>(Tag::ENTERCONTEXT)] = &dispatch<EnterContext, &ISAWalk<TReturn>::walkEnterContext>;
+                t[static_cast<std::size_t>(Tag::RESUMECONTEXT)] = &dispatch<ResumeContext, &ISAWalk<TReturn>::walkResumeContext>;
+                t[static_cast<std::size_t>(Tag::POPCONTEXT)] = &dispatch<PopContext, &ISAWalk<TReturn>::walkPopContext>;
+                t[static_cast<std::size_t>(Tag::EXIT)] = &dispatch<Exit, &ISAWalk<TReturn>::walkExit>;
+                t[static_cast<std::size_t>(Tag::MAPINIT)] = &dispatch<MapInit, &ISAWalk<TReturn>::walkMapInit>;
+                t[static_cast<std::size_t>(Tag::MAPSET)] = &dispatch<MapSet, &ISAWalk<TReturn>::walkMapSet>;
+                t[static_cast<std::size_t>(Tag::MAPGET)] = &dispatch<MapGet, &ISAWalk<TReturn>::walkMapGet>;
+                t[static_cast<std::size_t>(Tag::MAPLENGTH)] = &dispatch<MapLength, &ISAWalk<TReturn>::walkMapLength>;
+                t[static_cast<std::size_t>(Tag::MAPKEYS)] = &dispatch<MapKeys, &ISAWalk<TReturn>::walkMapKeys>;
+                t[static_cast<std::size_t>(Tag::TYPIFY)] = &dispatch<Typify, &ISAWalk<TReturn>::walkTypify>;
+                t[static_cast<std::size_t>(Tag::ASSIGNVALUE)] = &dispatch<AssignValue, &ISAWalk<TReturn>::walkAssignValue>;
+                t[static_cast<std::size_t>(Tag::ASSIGNEVAL)] = &dispatch<AssignEval, &ISAWalk<TReturn>::walkAssignEval>;
+                t[static_cast<std::size_t>(Tag::LOCK)] = &dispatch<Lock, &ISAWalk<TReturn>::walkLock>;
+                t[static_cast<std::size_t>(Tag::UNLOCK)] = &dispatch<Unlock, &ISAWalk<TReturn>::walkUnlock>;
+                t[static_cast<std::size_t>(Tag::EQUAL)] = &dispatch<IsEqual, &ISAWalk<TReturn>::walkIsEqual>;
+                t[static_cast<std::size_t>(Tag::SCOPEOF)] = &dispatch<ScopeOf, &ISAWalk<TReturn>::walkScopeOf>;
+                t[static_cast<std::size_t>(Tag::STREAMINIT)] = &dispatch<StreamInit, &ISAWalk<TReturn>::walkStreamInit>;
+                t[static_cast<std::size_t>(Tag::STREAMPUSH)] = &dispatch<StreamPush, &ISAWalk<TReturn>::walkStreamPush>;
+                t[static_cast<std::size_t>(Tag::STREAMPOP)] = &dispatch<StreamPop, &ISAWalk<TReturn>::walkStreamPop>;
+                t[static_cast<std::size_t>(Tag::STREAMCLOSE)] = &dispatch<StreamClose, &ISAWalk<TReturn>::walkStreamClose>;
+                t[static_cast<std::size_t>(Tag::STREAMEMPTY)] = &dispatch<StreamEmpty, &ISAWalk<TReturn>::walkStreamEmpty>;
+                t[static_cast<std::size_t>(Tag::OUT)] = &dispatch<Out, &ISAWalk<TReturn>::walkOut>;
+                t[static_cast<std::size_t>(Tag::ERR)] = &dispatch<Err, &ISAWalk<TReturn>::walkErr>;
+                t[static_cast<std::size_t>(Tag::STRCONCAT)] = &dispatch<StringConcat, &ISAWalk<TReturn>::walkStringConcat>;
+                t[static_cast<std::size_t>(Tag::STRLENGTH)] = &dispatch<StringLength, &ISAWalk<TReturn>::walkStringLength>;
+                t[static_cast<std::size_t>(Tag::STRSLICEFROM)] = &dispatch<StringSliceFrom, &ISAWalk<TReturn>::walkStringSliceFrom>;
+                t[static_cast<std::size_t>(Tag::STRSLICEFROMTO)] = &dispatch<StringSliceFromTo, &ISAWalk<TReturn>::walkStringSliceFromTo>;
+                t[static_cast<std::size_t>(Tag::TYPEOF)] = &dispatch<TypeOf, &ISAWalk<TReturn>::walkTypeOf>;
+                t[static_cast<std::size_t>(Tag::COMPATIBLE)] = &dispatch<IsCompatible, &ISAWalk<TReturn>::walkIsCompatible>;
+                t[static_cast<std::size_t>(Tag::PUSHEXHANDLER1)] = &dispatch<PushExceptionHandler1, &ISAWalk<TReturn>::walkPushExceptionHandler1>;
+                t[static_cast<std::size_t>(Tag::PUSHEXHANDLER2)] = &dispatch<PushExceptionHandler2, &ISAWalk<TReturn>::walkPushExceptionHandler2>;
+                t[static_cast<std::size_t>(Tag::POPEXHANDLER)] = &dispatch<PopExceptionHandler, &ISAWalk<TReturn>::walkPopExceptionHandler>;
+                t[static_cast<std::size_t>(Tag::RAISE)] = &dispatch<Raise, &ISAWalk<TReturn>::walkRaise>;
+                t[static_cast<std::size_t>(Tag::RESUME)] = &dispatch<Resume, &ISAWalk<TReturn>::walkResume>;
+                t[static_cast<std::size_t>(Tag::AND)] = &dispatch<And, &ISAWalk<TReturn>::walkAnd>;
+                t[static_cast<std::size_t>(Tag::OR)] = &dispatch<Or, &ISAWalk<TReturn>::walkOr>;
+                t[static_cast<std::size_t>(Tag::XOR)] = &dispatch<Xor, &ISAWalk<TReturn>::walkXor>;
+                t[static_cast<std::size_t>(Tag::NAND)] = &dispatch<Nand, &ISAWalk<TReturn>::walkNand>;
+                t[static_cast<std::size_t>(Tag::NOR)] = &dispatch<Nor, &ISAWalk<TReturn>::walkNor>;
+                t[static_cast<std::size_t>(Tag::NOT)] = &dispatch<Not, &ISAWalk<TReturn>::walkNot>;
+                t[static_cast<std::size_t>(Tag::OTYPEINIT)] = &dispatch<OTypeInit, &ISAWalk<TReturn>::walkOTypeInit>;
+                t[static_cast<std::size_t>(Tag::OTYPEPROP)] = &dispatch<OTypeProp, &ISAWalk<TReturn>::walkOTypeProp>;
+                t[static_cast<std::size_t>(Tag::OTYPEDEL)] = &dispatch<OTypeDel, &ISAWalk<TReturn>::walkOTypeDel>;
+                t[static_cast<std::size_t>(Tag::OTYPEGET)] = &dispatch<OTypeGet, &ISAWalk<TReturn>::walkOTypeGet>;
+                t[static_cast<std::size_t>(Tag::OTYPEFINALIZE)] = &dispatch<OTypeFinalize, &ISAWalk<TReturn>::walkOTypeFinalize>;
+                t[static_cast<std::size_t>(Tag::OTYPESUBSET)] = &dispatch<OTypeSubset, &ISAWalk<TReturn>::walkOTypeSubset>;
+                t[static_cast<std::size_t>(Tag::OBJINIT)] = &dispatch<ObjInit, &ISAWalk<TReturn>::walkObjInit>;
+                t[static_cast<std::size_t>(Tag::OBJSET)] = &dispatch<ObjSet, &ISAWalk<TReturn>::walkObjSet>;
+                t[static_cast<std::size_t>(Tag::OBJGET)] = &dispatch<ObjGet, &ISAWalk<TReturn>::walkObjGet>;
+                t[static_cast<std::size_t>(Tag::OBJINSTANCE)] = &dispatch<ObjInstance, &ISAWalk<TReturn>::walkObjInstance>;
+                t[static_cast<std::size_t>(Tag::OBJCURRY)] = &dispatch<ObjCurry, &ISAWalk<TReturn>::walkObjCurry>;
+                return t;
+            }();
+
+            return table;
+        }
+
         virtual TReturn walkPosition(PositionAnnotation*) = 0;
         virtual TReturn walkPlus(Plus*) = 0;
         virtual TReturn walkMinus(Minus*) = 0;
@@ -31,12 +31,19 @@ namespace swarmc::VM {
         explicit Pipeline(std::istream* input) {
             _input = input;
             _parser = new ISA::Parser(*input);
-            std::string header = "\x7fSVI";
-            for (int i = 0; i < 4; i++) {
-                input->seekg(i, std::istream::beg);
-                _isBinary = input->peek() == header[i];
-            }
+
+            char header[BC_PAYLOAD_OFFSET] = {};
+            input->read(header, BC_PAYLOAD_OFFSET);
+            _isBinary = input->gcount() >= BC_HEADER_LENGTH && std::string(header, BC_HEADER_LENGTH) == BC_HEADER;
+            input->clear();
             input->seekg(0, std::istream::beg);
+
+            if ( _isBinary && static_cast<unsigned char>(header[BC_HEADER_LENGTH]) != BC_FORMAT_VERSION ) {
+                throw Errors::SwarmError(
+                    "Unsupported binary SVI format (version " + std::to_string(static_cast<unsigned char>(header[BC_HEADER_LENGTH]))
+                    + ", expected " + std::to_string(BC_FORMAT_VERSION) + "). Files from older versions of swarmc must be re-emitted with --binary."
+                );
+            }
         }
 
         ~Pipeline() override {
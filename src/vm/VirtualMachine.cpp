@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <thread>
 #include "../errors/SwarmError.h"
 #include "VirtualMachine.h"
 #include "runtime/external.h"
@@ -34,6 +36,14 @@ namespace swarmc::Runtime {
         throw Errors::SwarmError("Unable to find queue backend for job: " + j->toString());
     }
 
+    std::size_t VirtualMachine::workerCount() {
+        std::size_t workers = 1;
+        for ( auto queue : _queues ) {
+            workers = std::max(workers, queue->workerCount());
+        }
+        return workers;
+    }
+
     void VirtualMachine::restore(ScopeFrame* scope) {
         if ( _scope != scope ) {
             freeref(_scope);
@@ -121,7 +131,7 @@ namespace swarmc::Runtime {
         auto header = _state->getInlineFunctionHeader(pc);
         auto returnType = _exec->ensureType(resolve(header->second()));
 
-        verbose("load inline function: " + name + " (#params: " + std::to_string(paramTypes.size()) + ") (returns: " + returnType->toString() + ")");
+        verbose([&]() { return "load inline function: " + name + " (#params: " + std::to_string(paramTypes.size()) + ") (returns: " + returnType->toString() + ")"; });
         return new InlineFunction(name, paramTypes, returnType->value());
     }
 
@@ -154,7 +164,7 @@ namespace swarmc::Runtime {
     }
 
     void VirtualMachine::step() {
-        auto result = _exec->walkOne(_state->current());
+        auto result = _exec->walkOne(_state->current(), _state->currentSharedLocations());
         GC_LOCAL_REF(result)
 
         if ( !_state->isEndOfProgram() && _shouldAdvance ) {
@@ -163,8 +173,9 @@ namespace swarmc::Runtime {
         _shouldAdvance = true;
 
         if ( _shouldClearReturn ) {
-            _scope->clearReturnCall();
-            _scope->shouldCaptureReturn(false);
+            auto scope = ownScope();
+            scope->clearReturnCall();
+            scope->shouldCaptureReturn(false);
             _shouldClearReturn = false;
         } else if ( _scope->getReturnCall() != nullptr ) {
             _shouldClearReturn = true;
@@ -188,7 +199,7 @@ namespace swarmc::Runtime {
         nslib::Defer defer;
 
         auto scopeLoc = _scope->map(loc);
-        if ( scopeLoc->is(loc) && _scope->parent() == nullptr ) {
+        if ( scopeLoc == loc && _scope->parent() == nullptr ) {
             // Variables in the global scope don't need a `scopeof` call, so shadow
             // them automatically to make sure the scope gets set up properly.
             shadow(loc);
@@ -205,6 +216,18 @@ namespace swarmc::Runtime {
         store->store(scopeLoc, ref);
     }
 
+    bool VirtualMachine::storeNumberInPlace(LocationReference* loc, double value) {
+        auto scopeLoc = _scope->map(loc);
+        if ( scopeLoc == loc && _scope->parent() == nullptr ) {
+            // Needs to be shadowed by `store(...)` first
+            return false;
+        }
+
+        auto store = getStore(scopeLoc);
+        if ( store->shouldLockAccesses() ) return false;
+        return store->overwriteNumber(scopeLoc, value);
+    }
+
     bool VirtualMachine::hasLock(LocationReference* loc) {
         return std::any_of(_locks.begin(), _locks.end(), [loc](IStorageLock* lock) {
             return lock->location()->is(loc);
@@ -229,7 +252,7 @@ namespace swarmc::Runtime {
         for ( int i = 0; i < Configuration::LOCK_MAX_RETRIES; i += 1 ) {
             auto lock = store->acquire(loc);
             if ( lock == nullptr ) {
-                whileWaitingForLock();
+                whileWaitingForLock(store, loc, i);
                 continue;
             }
 
@@ -243,6 +266,54 @@ namespace swarmc::Runtime {
         );
     }
 
+    bool VirtualMachine::canUpdateAtomically(LocationReference* loc) {
+        return !hasLock(loc) && getStore(loc)->supportsAtomicUpdates();
+    }
+
+    Reference* VirtualMachine::updateAtomically(LocationReference* loc, AtomicOp op, Reference* operand, const AtomicApply& apply) {
+        auto store = getStore(loc);
+        for ( int i = 0; i < Configuration::LOCK_MAX_RETRIES; i += 1 ) {
+            auto value = store->update(loc, op, operand, apply);
+            if ( value != nullptr ) return value;
+            whileWaitingForLock(store, loc, i);
+        }
+
+        throw Errors::RuntimeError(
+            Errors::RuntimeExCode::AcquireLockMaxAttemptsExceeded,
+            "Unable to update location (" + loc->toString() + ") in store (" + store->toString() + ") -- max retries exceeded"
+        );
+    }
+
+    void VirtualMachine::whileWaitingForLock(IStorageInterface* store, LocationReference* loc, int attempt) {
+        waitWithBackoff(attempt, Configuration::LOCK_SPIN_ATTEMPTS, Configuration::LOCK_SLEEP_uS, [store, loc](std::chrono::microseconds timeout) {
+            store->waitForUnlock(loc, timeout);
+        });
+    }
+
+    void VirtualMachine::whileWaitingForIO(int attempt, const WaitFor& wait) {
+        waitWithBackoff(attempt, Configuration::IO_SPIN_ATTEMPTS, Configuration::SOCKET_POLL_mS * 1000, wait);
+    }
+
+    void VirtualMachine::waitWithBackoff(int attempt, int spinAttempts, int maxWait_uS, const WaitFor& wait) {
+        // Most waits are brief, so give the other side a chance to finish before backing off
+        if ( attempt < spinAttempts ) {
+            std::this_thread::yield();
+            return;
+        }
+
+        // Run pending jobs in the meantime, but only if this control holds no locks.
+        // Otherwise, a job run here could wait on one of them and never finish.
+        if ( _locks.empty() ) {
+            for ( auto q : _queues ) {
+                q->tick();
+            }
+        }
+
+        auto shift = std::min(attempt - spinAttempts, 20);
+        auto timeout = std::min<std::int64_t>(std::int64_t(1) << shift, maxWait_uS);
+        wait(std::chrono::microseconds(timeout));
+    }
+
     void VirtualMachine::unlock(LocationReference* loc) {
         if ( !hasLock(loc) ) {
             logger->warn("Attempted to release lock that is not held by the requesting control: " + loc->toString());
@@ -268,7 +339,17 @@ namespace swarmc::Runtime {
     }
 
     void VirtualMachine::shadow(ISA::LocationReference* loc) {
-        _scope->shadow(loc);
+        ownScope()->shadow(loc);
+    }
+
+    ScopeFrame* VirtualMachine::ownScope() {
+        if ( _scope->isShared() ) {
+            auto scope = useref(_scope->copy());
+            freeref(_scope);
+            _scope = scope;
+        }
+
+        return _scope;
     }
 
     void VirtualMachine::enterScope() {
@@ -329,7 +410,7 @@ namespace swarmc::Runtime {
 
     void VirtualMachine::skip(ISA::BeginFunction* fn) {
         auto pc = _state->getInlineFunctionSkipPC(fn->first()->name());
-        verbose("Skipping uncalled function body: " + fn->toString() + ", pc: " + std::to_string(pc));
+        verbose([&]() { return "Skipping uncalled function body: " + fn->toString() + ", pc: " + std::to_string(pc); });
         _state->jump(pc);
     }
 
@@ -350,14 +431,14 @@ namespace swarmc::Runtime {
     }
 
     void VirtualMachine::setCaptureReturn() {
-        _scope->shouldCaptureReturn(true);
+        ownScope()->shouldCaptureReturn(true);
     }
 
     IQueueJob* VirtualMachine::pushCall(IFunctionCall* call) {
         // fixme: need to account for contexts!
         auto queue = getQueue(call);
         auto job = queue->build(this, call);
-        verbose("pushCall - call: " + call->toString() + " | job: " + job->toString());
+        verbose([&]() { return "pushCall - call: " + call->toString() + " | job: " + job->toString(); });
         queue->push(this, job);
         return job;
     }
@@ -440,7 +521,7 @@ namespace swarmc::Runtime {
 
         // Make the returned IFunctionCall available to the caller
         if ( _scope->shouldCaptureReturn() ) {
-            _scope->setReturnCall(call);
+            ownScope()->setReturnCall(call);
         }
     }
 
@@ -544,7 +625,7 @@ namespace swarmc::Runtime {
         // Jump to the function call
         debug("inline call: " + s(call) + " (pc: " + s(pc) + ")");
         if ( inheritScope ) _state->jump(pc);
-        else _state->jumpCall(_scope, pc);
+        else _state->jumpCall(ownScope(), pc);
 
         // Start a new scope
         if ( inheritScope ) inheritCallScope(call);
@@ -553,7 +634,7 @@ namespace swarmc::Runtime {
         // Skip over the beginfn instruction
         advance();
 
-        verbose("next instruction for inline call: " + _state->current()->toString());
+        verbose([&]() { return "next instruction for inline call: " + _state->current()->toString(); });
     }
 
     void VirtualMachine::callProviderFunction(IProviderFunctionCall* call, bool inheritScope) {
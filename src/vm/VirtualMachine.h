@@ -78,7 +78,7 @@ namespace swarmc::Runtime {
         /** Load a set of parsed instructions into the runtime. */
         void initialize(ISA::Instructions is) {
             _state = useref(new State(std::move(is)));
-            _scope = useref(new ScopeFrame(_global, nslib::uuid(), nullptr));
+            _scope = useref(new ScopeFrame(_global, ScopeFrame::nextId(), nullptr));
             freeref(_localOut);
             _localOut = useref(new LocalOutputStream());
 
@@ -94,7 +94,7 @@ namespace swarmc::Runtime {
         void initializeWorker() {
             // _state and _scope need to exist but their values don't matter
             _state = useref(new State(ISA::Instructions()));
-            _scope = useref(new ScopeFrame(_global, nslib::uuid(), nullptr));
+            _scope = useref(new ScopeFrame(_global, ScopeFrame::nextId(), nullptr));
 
             freeref(_localOut);
             _localOut = useref(new LocalOutputStream());
@@ -238,6 +238,12 @@ namespace swarmc::Runtime {
         /** Store the given reference in the specified location using the appropriate storage driver. */
         virtual void store(ISA::LocationReference*, ISA::Reference*);
 
+        /**
+         * Overwrite the number stored in the specified location in place, if its store allows it.
+         * Returns false if the caller should `store(...)` a new reference instead.
+         */
+        virtual bool storeNumberInPlace(ISA::LocationReference*, double);
+
         /** Returns true if this VM instance holds a lock for the given location. */
         virtual bool hasLock(ISA::LocationReference*);
 
@@ -247,6 +253,15 @@ namespace swarmc::Runtime {
         /** Release the lock for the given location, if this VM holds it. */
         virtual void unlock(ISA::LocationReference*);
 
+        /** Returns true if the given location can be read-modify-written by its store without locking it. */
+        virtual bool canUpdateAtomically(ISA::LocationReference*);
+
+        /**
+         * Replace the value of the given location with `apply(current)` as a single atomic
+         * step in its store, retrying while another control holds the location's lock.
+         */
+        virtual ISA::Reference* updateAtomically(ISA::LocationReference*, AtomicOp, ISA::Reference* operand, const AtomicApply& apply);
+
         /** Assert the type of the specified location in the appropriate storage driver. */
         virtual void typify(ISA::LocationReference*, Type::Type*);
 
@@ -312,6 +327,9 @@ namespace swarmc::Runtime {
         /** Wait for all jobs in the current queue context to finish. */
         virtual ReturnMap drain();
 
+        /** The number of workers available to run pushed calls, across the queues. At least 1. */
+        virtual std::size_t workerCount();
+
         /** Immediately stop execution. */
         virtual void exit();
 
@@ -359,14 +377,23 @@ namespace swarmc::Runtime {
         }
 
         /**
-         * This callback is executed each time the VM fails to acquire a lock,
-         * before it retries its attempt.
-         *
-         * TODO: use to execute queue jobs while idle
+         * This callback is executed each time the VM fails to acquire a lock (or to update a
+         * location atomically), before it retries. `attempt` is the number of failed attempts
+         * so far: the VM spins for the first few, then runs pending jobs and waits on the store
+         * with exponential backoff (up to LOCK_SLEEP_uS).
          */
-        virtual void whileWaitingForLock() {
-            std::this_thread::sleep_for(std::chrono::microseconds(Configuration::LOCK_SLEEP_uS));
-        }
+        virtual void whileWaitingForLock(IStorageInterface*, ISA::LocationReference*, int attempt);
+
+        /** Blocks for up to the given timeout, or until whatever is being waited on may be ready. */
+        using WaitFor = std::function<void(std::chrono::microseconds)>;
+
+        /**
+         * This callback is executed each time a control finds a socket (or other external
+         * resource) not yet ready. Like `whileWaitingForLock`, it spins for the first few
+         * attempts (IO_SPIN_ATTEMPTS), then runs pending jobs and calls `wait` with
+         * exponential backoff (up to SOCKET_POLL_mS).
+         */
+        virtual void whileWaitingForIO(int attempt, const WaitFor& wait);
 
         /**
          * This callback is executed each time the VM check to see if all pending
@@ -382,19 +409,19 @@ namespace swarmc::Runtime {
         }
 
         virtual ExceptionHandlerId pushExceptionHandler(IFunction* selector, IFunction* handler) {
-            return _scope->pushExceptionHandler(selector, handler);
+            return ownScope()->pushExceptionHandler(selector, handler);
         }
 
         virtual ExceptionHandlerId pushExceptionHandler(std::size_t code, IFunction* handler) {
-            return _scope->pushExceptionHandler(code, handler);
+            return ownScope()->pushExceptionHandler(code, handler);
         }
 
         virtual ExceptionHandlerId pushExceptionHandler(IFunction* handler) {
-            return _scope->pushExceptionHandler(handler);
+            return ownScope()->pushExceptionHandler(handler);
         }
 
         virtual void popExceptionHandler(const ExceptionHandlerId& id) {
-            _scope->popExceptionHandler(id);
+            ownScope()->popExceptionHandler(id);
         }
 
         virtual std::pair<ScopeFrame*, IFunction*> getExceptionHandler(std::size_t code);
@@ -406,8 +433,26 @@ namespace swarmc::Runtime {
         /** Get the storage driver which should be used to access the given location. */
         virtual IStorageInterface* getStore(ISA::LocationReference*);
 
-        /** Make a deep copy of this instance. */
-        [[nodiscard]] VirtualMachine* copy() const {
+        /**
+         * Get the current scope frame for mutation. Frames shared with a forked VM
+         * are frozen, so the first write after a fork replaces the current frame with
+         * a private (shallow) copy.
+         */
+        ScopeFrame* ownScope();
+
+        /**
+         * Shared by `whileWaitingForLock` and `whileWaitingForIO`. Yields for the first
+         * `spinAttempts` attempts. After that, runs pending jobs (if this control holds no
+         * locks) and calls `wait` with a timeout doubling from 1us up to `maxWait_uS`.
+         */
+        void waitWithBackoff(int attempt, int spinAttempts, int maxWait_uS, const WaitFor& wait);
+
+        /**
+         * Fork this instance. Not const: the copy shares state with this VM copy-on-write,
+         * so forking freezes this VM's parent scopes and the pending writes in its local
+         * stores. Later writes on either side go to private copies.
+         */
+        [[nodiscard]] VirtualMachine* copy() {
             auto copy = new VirtualMachine(_global);
             copy->_state = useref(_state->copy());
             copy->_scope = useref(_scope->copy());
@@ -434,19 +479,32 @@ namespace swarmc::Runtime {
             return copy;
         }
 
-        void copy(const std::function<void(VirtualMachine*)>& handler) const {
+        /** Run `handler` on a fork of this VM, then clean up and delete the fork, even if `handler` throws. */
+        void copy(const std::function<void(VirtualMachine*)>& handler) {
             auto vm = copy();
-            handler(vm);
+            try {
+                handler(vm);
+            } catch (...) {
+                vm->cleanup();
+                delete vm;
+                throw;
+            }
+
             vm->cleanup();
             delete vm;
         }
 
         template <typename ReturnT>
-        ReturnT copy(const std::function<ReturnT(VirtualMachine*)>& handler) const {
+        ReturnT copy(const std::function<ReturnT(VirtualMachine*)>& handler) {
             auto vm = copy();
-            auto ret = handler(vm);
-            delete vm;
-            return ret;
+            try {
+                auto ret = handler(vm);
+                delete vm;
+                return ret;
+            } catch (...) {
+                delete vm;
+                throw;
+            }
         }
 
     protected:
@@ -479,8 +537,21 @@ namespace swarmc::Runtime {
         }
 
         /** Print verbose output visible when the `--verbose` flag is present. */
-        virtual void verbose(const std::string& output) const {
+        void verbose(const std::string& output) const {
+#ifndef SWARM_STRIP_VERBOSE
             if ( Configuration::VERBOSE ) debug(output);
+#endif
+        }
+
+        /**
+         * Print verbose output visible when the `--verbose` flag is present, but only builds the message (by calling
+         * `formatter`) if it would actually be output. Compiled out entirely under SWARM_STRIP_VERBOSE.
+         */
+        template <typename TFormatter> requires std::invocable<TFormatter>
+        void verbose(TFormatter&& formatter) const {
+#ifndef SWARM_STRIP_VERBOSE
+            if ( Configuration::VERBOSE && logger->isEnabled(Verbosity::DEBUG) ) debug(formatter());
+#endif
         }
 
         /** Get the queue which should be used to perform the given function call. */
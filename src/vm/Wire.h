@@ -15,6 +15,7 @@ namespace swarmc::Runtime {
     class IFunctionCall;
     class ScopeFrame;
     class State;
+    class Program;
     class IStorageInterface;
 
     class Wire {
@@ -59,6 +60,14 @@ namespace swarmc::Runtime {
             return _state;
         }
 
+        static Factory<Program, VirtualMachine*>* programs() {
+            if ( _program == nullptr ) {
+                _program = buildPrograms();
+            }
+
+            return _program;
+        }
+
         static Factory<IStorageInterface, VirtualMachine*>* stores() {
             if ( _store == nullptr ) {
                 _store = buildStores();
@@ -72,6 +81,7 @@ namespace swarmc::Runtime {
         static inline Factory<IFunctionCall, VirtualMachine*>* _call = nullptr;
         static inline Factory<ScopeFrame, VirtualMachine*>* _scope = nullptr;
         static inline Factory<State, VirtualMachine*>* _state = nullptr;
+        static inline Factory<Program, VirtualMachine*>* _program = nullptr;
         static inline Factory<IStorageInterface, VirtualMachine*>* _store = nullptr;
 
         static Factory<Type::Type, void*>* buildTypes();
@@ -79,6 +89,7 @@ namespace swarmc::Runtime {
         static Factory<IFunctionCall, VirtualMachine*>* buildCalls();
         static Factory<ScopeFrame, VirtualMachine*>* buildScopes();
         static Factory<State, VirtualMachine*>* buildStates();
+        static Factory<Program, VirtualMachine*>* buildPrograms();
         static Factory<IStorageInterface, VirtualMachine*>* buildStores();
     };
 
@@ -1,6 +1,13 @@
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "../../shared/nslib.h"
+#include "../../Configuration.h"
 #include "FileResource.h"
 #include "../isa_meta.h"
 #include "../VirtualMachine.h"
@@ -9,70 +16,274 @@
 
 namespace swarmc::Runtime::Prologue {
 
-    ResourceOperationFrame FileResource::performOperation(VirtualMachine* vm, OperationName op, ResourceOperationFrame params) {
-        if ( op == "PROLOGUE::OP::FILE::READ" ) {
-            // Try to open the file
-            std::ifstream fh(path());
-            if ( !fh ) {
+    FileView::FileView(const std::string& path) {
+        auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat info {};
+        if ( fd < 0 || ::fstat(fd, &info) != 0 ) {
+            if ( fd >= 0 ) ::close(fd);
+            throw Errors::RuntimeError(
+                Errors::RuntimeExCode::InvalidOrMissingFilePath,
+                "Unable to open path to file: " + path + "(" + strerror(errno) + ")"
+            );
+        }
+
+        // mmap(...) rejects empty mappings, so an empty file is just an empty view
+        _size = info.st_size;
+        if ( _size > 0 ) {
+            auto data = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if ( data == MAP_FAILED ) {
+                ::close(fd);
                 throw Errors::RuntimeError(
                     Errors::RuntimeExCode::InvalidOrMissingFilePath,
-                    "Unable to open path to file: " + path() + "(" + strerror(errno) + ")"
+                    "Unable to map file: " + path + "(" + strerror(errno) + ")"
                 );
             }
 
-            // Read the contents of the file from the path
-            auto content = nslib::stl::readStreamContents(fh);
+            ::madvise(data, _size, MADV_SEQUENTIAL);
+            _data = (const char*) data;
+        }
+
+        // The mapping stays valid after the descriptor is closed
+        ::close(fd);
+    }
+
+    FileView::~FileView() {
+        if ( _data != nullptr ) ::munmap((void*) _data, _size);
+    }
+
+    std::string_view FileView::slice(std::size_t offset, std::size_t length) const {
+        if ( offset >= _size ) return {};
+        return {_data + offset, std::min(length, _size - offset)};
+    }
+
+    std::vector<std::string_view> FileView::lines(std::size_t offset, std::size_t length) const {
+        std::vector<std::string_view> lines;
+        if ( offset >= _size ) return lines;
+        auto end = offset + std::min(length, _size - offset);
+
+        // A line which started before the range belongs to the previous one
+        auto pos = offset;
+        if ( pos > 0 && _data[pos - 1] != '\n' ) {
+            auto newline = (const char*) memchr(_data + pos, '\n', _size - pos);
+            if ( newline == nullptr ) return lines;
+            pos = newline - _data + 1;
+        }
+
+        while ( pos < end ) {
+            auto newline = (const char*) memchr(_data + pos, '\n', _size - pos);
+            std::size_t lineEnd = newline == nullptr ? _size : newline - _data;
+
+            auto lineLength = lineEnd - pos;
+            if ( lineLength > 0 && _data[lineEnd - 1] == '\r' ) lineLength -= 1;
+
+            lines.emplace_back(_data + pos, lineLength);
+            pos = lineEnd + 1;
+        }
+
+        return lines;
+    }
+
+    std::vector<std::size_t> FileView::boundaries(std::size_t chunkSize) const {
+        std::vector<std::size_t> starts;
+        if ( _size == 0 ) return starts;
+        starts.push_back(0);
+
+        // Move each cut forward to the start of the next line
+        for ( auto cut = chunkSize; cut < _size; cut = starts.back() + chunkSize ) {
+            if ( _data[cut - 1] != '\n' ) {
+                auto newline = (const char*) memchr(_data + cut, '\n', _size - cut);
+                if ( newline == nullptr ) break;
+                cut = newline - _data + 1;
+            }
+
+            if ( cut >= _size ) break;
+            starts.push_back(cut);
+        }
 
-            // Set the contents as the return value of the operation
-            return {new ISA::StringReference(content)};
+        starts.push_back(_size);
+        return starts;
+    }
+
+    ResourceOperationFrame FileResource::performOperation(VirtualMachine* vm, OperationName op, ResourceOperationFrame params) {
+        if ( op == "PROLOGUE::OP::FILE::READ" ) {
+            auto contents = view()->slice(0, std::string::npos);
+            return {new ISA::StringReference(std::string(contents))};
         }
 
 
-        if ( op == "PROLOGUE::OP::FILE::WRITE" ) {
+        if ( op == "PROLOGUE::OP::FILE::WRITE" || op == "PROLOGUE::OP::FILE::APPEND" ) {
             // Try to get the contents
             assert(!params.empty());
             assert(params.at(0)->tag() == ISA::ReferenceTag::STRING);
             auto content = dynamic_cast<ISA::StringReference*>(params.at(0));
             GC_LOCAL_REF(content)
 
-            // Try to open the file
-            std::ofstream fh(path());
-            if ( !fh ) {
-                throw Errors::RuntimeError(
-                    Errors::RuntimeExCode::InvalidOrMissingFilePath,
-                    "Unable to open path to file: " + path() + "(" + strerror(errno) + ")"
-                );
+            write(content->value(), op == "PROLOGUE::OP::FILE::APPEND");
+            return {};
+        }
+
+
+        if ( op == "PROLOGUE::OP::FILE::SIZE" ) {
+            return {new ISA::NumberReference((double) view()->size())};
+        }
+
+
+        if ( op == "PROLOGUE::OP::FILE::READ_RANGE" || op == "PROLOGUE::OP::FILE::READ_LINES" ) {
+            // Get the byte range to read
+            assert(params.size() >= 2);
+            assert(params.at(0)->tag() == ISA::ReferenceTag::NUMBER);
+            assert(params.at(1)->tag() == ISA::ReferenceTag::NUMBER);
+            auto offset = (std::size_t) std::max(0.0, ((ISA::NumberReference*) params.at(0))->value());
+            auto length = (std::size_t) std::max(0.0, ((ISA::NumberReference*) params.at(1))->value());
+
+            auto fileView = view();
+            if ( op == "PROLOGUE::OP::FILE::READ_RANGE" ) {
+                return {new ISA::StringReference(std::string(fileView->slice(offset, length)))};
             }
 
-            // Write the contents to the file
-            fh << content->value();
-            return {};
+            auto lines = new ISA::EnumerationReference(Type::Primitive::of(Type::Intrinsic::STRING));
+            for ( auto line : fileView->lines(offset, length) ) {
+                lines->append(new ISA::StringReference(std::string(line)));
+            }
+
+            return {lines};
         }
 
 
-        if ( op == "PROLOGUE::OP::FILE::APPEND" ) {
-            // Try to get the contents
+        if ( op == "PROLOGUE::OP::FILE::SPLIT" ) {
             assert(!params.empty());
-            assert(params.at(0)->tag() == ISA::ReferenceTag::STRING);
-            auto content = dynamic_cast<ISA::StringReference*>(params.at(0));
-            GC_LOCAL_REF(content)
+            assert(params.at(0)->tag() == ISA::ReferenceTag::NUMBER);
+            auto chunkSize = (std::size_t) std::max(1.0, ((ISA::NumberReference*) params.at(0))->value());
+
+            auto starts = new ISA::EnumerationReference(Type::Primitive::of(Type::Intrinsic::NUMBER));
+            for ( auto start : view()->boundaries(chunkSize) ) {
+                starts->append(new ISA::NumberReference((double) start));
+            }
+
+            return {starts};
+        }
+
+
+        if ( op == "PROLOGUE::OP::FILE::STREAM_LINES" ) {
+            // Push each line onto the stream as it is read, so the file is never held as strings all at once
+            assert(!params.empty());
+            assert(params.at(0)->tag() == ISA::ReferenceTag::STREAM);
+            auto stream = ((ISA::StreamReference*) params.at(0))->stream();
+
+            auto fileView = view();
+            std::size_t count = 0;
+            for ( std::size_t offset = 0; offset < fileView->size(); offset += Configuration::FILE_CHUNK_SIZE ) {
+                for ( auto line : fileView->lines(offset, Configuration::FILE_CHUNK_SIZE) ) {
+                    stream->push(new ISA::StringReference(std::string(line)));
+                    count += 1;
+                }
+            }
+
+            return {new ISA::NumberReference((double) count)};
+        }
+
+
+        throw InvalidResourceOperation(s(this), op);
+    }
+
+    void FileResource::acquire(VirtualMachine*) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _acquired += 1;
+    }
+
+    void FileResource::release(VirtualMachine*) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if ( _acquired == 0 || --_acquired > 0 ) return;
+
+        _writer = nullptr;  // flushes and closes the handle
+        _writeBuffer = nullptr;
+        _view = nullptr;
+    }
+
+    void FileResource::forgetExpiredViews() {
+        std::erase_if(_views, [](const std::weak_ptr<FileView>& v) { return v.expired(); });
+    }
+
+    bool FileResource::hasLiveViews() {
+        forgetExpiredViews();
+        return !_views.empty();
+    }
+
+    void FileResource::replicateLocally(VirtualMachine* vm) {
+        if ( _category != ResourceCategory::REPLICATED ) {
+            IResource::replicateLocally(vm);  // throws, since tunneled files can't be replicated
+            return;
+        }
+
+        // There's nothing to copy, but the file has to actually be here
+        if ( ::access(path().c_str(), R_OK) != 0 ) {
+            throw Errors::RuntimeError(
+                Errors::RuntimeExCode::InvalidOrMissingFilePath,
+                "Unable to find local replica of file: " + path() + "(" + strerror(errno) + ")"
+            );
+        }
+
+        // The VM releases the resource after the call, which closes anything opened in the meantime
+        acquire(vm);
+    }
+
+    std::shared_ptr<FileView> FileResource::view() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if ( _view != nullptr ) return _view;
+        if ( _writer != nullptr ) _writer->flush();
+
+        auto fileView = std::make_shared<FileView>(path());
+        if ( _acquired > 0 ) _view = fileView;
+
+        // Empty views don't map anything, so a later write can't fault them
+        if ( fileView->size() > 0 ) {
+            forgetExpiredViews();
+            _views.push_back(fileView);
+        }
+
+        return fileView;
+    }
+
+    void FileResource::write(const std::string& content, bool append) {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        // Any mapped view is now out of date
+        _view = nullptr;
 
-            // Try to open the file
-            std::ofstream fh(path(), std::ios_base::app);
-            if ( !fh ) {
+        // Truncating the file under a mapping raises SIGBUS in whoever reads it next
+        if ( !append && hasLiveViews() ) {
+            throw Errors::RuntimeError(
+                Errors::RuntimeExCode::FileInUse,
+                "Unable to overwrite file while it is being read: " + path()
+            );
+        }
+
+        // A write replaces the file, so it always needs a fresh handle. Appends can reuse the
+        // handle from the current `with` block, if there is one.
+        if ( _writer == nullptr || !append ) {
+            _writer = nullptr;
+            auto writer = std::make_unique<std::ofstream>();
+            if ( _acquired > 0 ) {
+                if ( _writeBuffer == nullptr ) _writeBuffer = std::unique_ptr<char[]>(new char[Configuration::FILE_CHUNK_SIZE]);
+                writer->rdbuf()->pubsetbuf(_writeBuffer.get(), (std::streamsize) Configuration::FILE_CHUNK_SIZE);
+            }
+
+            writer->open(path(), append ? std::ios_base::app : std::ios_base::trunc);
+            if ( !*writer ) {
                 throw Errors::RuntimeError(
                     Errors::RuntimeExCode::InvalidOrMissingFilePath,
                     "Unable to open path to file: " + path() + "(" + strerror(errno) + ")"
                 );
             }
 
-            // Write the contents to the file
-            fh << content->value();
-            return {};
+            _writer = std::move(writer);
         }
 
+        // Write the contents to the file
+        *_writer << content;
 
-        throw InvalidResourceOperation(s(this), op);
+        // Outside a `with` block, there's nothing to close the handle later
+        if ( _acquired == 0 ) _writer = nullptr;
     }
 
     void ReadFileFunctionCall::execute(VirtualMachine* vm) {
@@ -170,6 +381,232 @@ namespace swarmc::Runtime::Prologue {
     }
 
 
+    void FileSizeFunctionCall::execute(VirtualMachine* vm) {
+        // Load the resource and make a few sanity checks. These should be guaranteed by the VM, but just in case.
+        auto resource = (ISA::ResourceReference*) _vector.at(0).second;
+        assert(resource->resource()->name() == "PROLOGUE::FILE");
+
+        // Perform the operation on the resource
+        auto file = resource->resource();
+        auto result = file->performOperation(vm, "PROLOGUE::OP::FILE::SIZE", {});
+
+        // Get the result and set it as the return value of the call
+        assert(!result.empty());
+        assert(result.at(0)->tag() == ISA::ReferenceTag::NUMBER);
+
+        setReturn((ISA::NumberReference*) result.at(0));
+    }
+
+    Resources FileSizeFunctionCall::needsResources() const {
+        auto resource = (ISA::ResourceReference*) _vector.at(0).second;
+        return {resource->resource()};
+    }
+
+
+    FormalTypes FileSizeFunction::paramTypes() const {
+        return {Type::Resource::of(fileType())};
+    }
+
+    Type::Type* FileSizeFunction::returnType() const {
+        return Type::Primitive::of(Type::Intrinsic::NUMBER);
+    }
+
+    PrologueFunctionCall* FileSizeFunction::call(CallVector v) const {
+        return new FileSizeFunctionCall(_provider, v, returnType());
+    }
+
+
+    void ReadFileRangeFunctionCall::execute(VirtualMachine* vm) {
+        // Load the resource and make a few sanity checks. These should be guaranteed by the VM, but just in case.
+        auto resource = (ISA::ResourceReference*) _vector.at(0).second;
+        assert(resource->resource()->name() == "PROLOGUE::FILE");
+
+        // Perform the operation on the resource
+        auto file = resource->resource();
+        auto result = file->performOperation(vm, "PROLOGUE::OP::FILE::READ_RANGE", {_vector.at(1).second, _vector.at(2).second});
+
+        // Get the result and set it as the return value of the call
+        assert(!result.empty());
+        assert(result.at(0)->tag() == ISA::ReferenceTag::STRING);
+
+        setReturn((ISA::StringReference*) result.at(0));
+    }
+
+    Resources ReadFileRangeFunctionCall::needsResources() const {
+        auto resource = (ISA::ResourceReference*) _vector.at(0).second;
+        return {resource->resource()};
+    }
+
+
+    FormalTypes ReadFileRangeFunction::paramTypes() const {
+        return {Type::Resource::of(fileType()), Type::Primitive::of(Type::Intrinsic::NUMBER), Type::Primitive::of(Type::Intrinsic::NUMBER)};
+    }
+
+    Type::Type* ReadFileRangeFunction::returnType() const {
+        return Type::Primitive::of(Type::Intrinsic::STRING);
+    }
+
+    PrologueFunctionCall* ReadFileRangeFunction::call(CallVector v) const {
+        return new ReadFileRangeFunctionCall(_provider, v, returnType());
+    }
+
+
+    void ReadFileLinesFunctionCall::execute(VirtualMachine* vm) {
+        // Load the resource and make a few sanity checks. These should be guaranteed by the VM, but just in case.
+        auto resource = (ISA::ResourceReference*) _vector.at(0).second;
+        assert(resource->resource()->name() == "PROLOGUE::FILE");
+
+        // Perform the operation on the resource
+        auto file = resource->resource();
+        auto result = file->performOperation(vm, "PROLOGUE::OP::FILE::READ_LINES", {_vector.at(1).second, _vector.at(2).second});
+
+        // Get the result and set it as the return value of the call
+        assert(!result.empty());
+        assert(result.at(0)->tag() == ISA::ReferenceTag::ENUMERATION);
+
+        setReturn((ISA::EnumerationReference*) result.at(0));
+    }
+
+    Resources ReadFileLinesFunctionCall::needsResources() const {
+        auto resource = (ISA::ResourceReference*) _vector.at(0).second;
+        return {resource->resource()};
+    }
+
+
+    FormalTypes ReadFileLinesFunction::paramTypes() const {
+        return {Type::Resource::of(fileType()), Type::Primitive::of(Type::Intrinsic::NUMBER), Type::Primitive::of(Type::Intrinsic::NUMBER)};
+    }
+
+    Type::Type* ReadFileLinesFunction::returnType() const {
+        return Type::Enumerable::of(Type::Primitive::of(Type::Intrinsic::STRING));
+    }
+
+    PrologueFunctionCall* ReadFileLinesFunction::call(CallVector v) const {
+        return new ReadFileLinesFunctionCall(_provider, v, returnType());
+    }
+
+
+    void StreamFileLinesFunctionCall::execute(VirtualMachine* vm) {
+        // Load the resource and make a few sanity checks. These should be guaranteed by the VM, but just in case.
+        auto resource = (ISA::ResourceReference*) _vector.at(0).second;
+        assert(resource->resource()->name() == "PROLOGUE::FILE");
+
+        // Perform the operation on the resource
+        auto file = resource->resource();
+        auto result = file->performOperation(vm, "PROLOGUE::OP::FILE::STREAM_LINES", {_vector.at(1).second});
+
+        // Get the result and set it as the return value of the call
+        assert(!result.empty());
+        assert(result.at(0)->tag() == ISA::ReferenceTag::NUMBER);
+
+        setReturn((ISA::NumberReference*) result.at(0));
+    }
+
+    Resources StreamFileLinesFunctionCall::needsResources() const {
+        auto resource = (ISA::ResourceReference*) _vector.at(0).second;
+        return {resource->resource()};
+    }
+
+
+    FormalTypes StreamFileLinesFunction::paramTypes() const {
+        return {Type::Resource::of(fileType()), Type::Stream::of(Type::Primitive::of(Type::Intrinsic::STRING))};
+    }
+
+    Type::Type* StreamFileLinesFunction::returnType() const {
+        return Type::Primitive::of(Type::Intrinsic::NUMBER);
+    }
+
+    PrologueFunctionCall* StreamFileLinesFunction::call(CallVector v) const {
+        return new StreamFileLinesFunctionCall(_provider, v, returnType());
+    }
+
+
+    void ForEachFileChunkFunctionCall::execute(VirtualMachine* vm) {
+        // Load the resource and make a few sanity checks. These should be guaranteed by the VM, but just in case.
+        auto resource = (ISA::ResourceReference*) _vector.at(0).second;
+        assert(resource->resource()->name() == "PROLOGUE::FILE");
+        auto chunkSize = (ISA::NumberReference*) _vector.at(1).second;
+        auto handler = (ISA::FunctionReference*) _vector.at(2).second;
+
+        // Find the line-aligned ranges. This only reads the pages around each boundary.
+        auto file = resource->resource();
+        auto result = file->performOperation(vm, "PROLOGUE::OP::FILE::SPLIT", {chunkSize});
+        assert(!result.empty());
+        assert(result.at(0)->tag() == ISA::ReferenceTag::ENUMERATION);
+        auto starts = (ISA::EnumerationReference*) result.at(0);
+        GC_LOCAL_REF(starts)
+
+        // Push one job per range, then wait for them like `enumerate` does
+        vm->enterQueueContext();
+
+        std::size_t ranges = 0;
+        for ( std::size_t i = 1; i < starts->length(); i += 1 ) {
+            auto start = (ISA::NumberReference*) starts->get(i - 1);
+            auto end = (ISA::NumberReference*) starts->get(i);
+            auto call = handler->fn()
+                ->curryi(resource)
+                ->curryi(start)
+                ->curryi(new ISA::NumberReference(end->value() - start->value()))
+                ->call();
+
+            GC_LOCAL_REF(call)
+
+            auto job = vm->pushCall(call);
+            GC_LOCAL_REF(job)
+            ranges += 1;
+        }
+
+        vm->drain();
+        vm->exitQueueContext();
+
+        setReturn(new ISA::NumberReference((double) ranges));
+    }
+
+    Resources ForEachFileChunkFunctionCall::needsResources() const {
+        auto resource = (ISA::ResourceReference*) _vector.at(0).second;
+        return {resource->resource()};
+    }
+
+
+    FormalTypes ForEachFileChunkFunction::paramTypes() const {
+        auto numberT = Type::Primitive::of(Type::Intrinsic::NUMBER);
+        auto handlerT = Type::Lambda1::of(
+            Type::Resource::of(fileType()),
+            Type::Lambda1::of(numberT, Type::Lambda1::of(numberT, Type::Primitive::of(Type::Intrinsic::VOID)))
+        );
+
+        return {Type::Resource::of(fileType()), numberT, handlerT};
+    }
+
+    Type::Type* ForEachFileChunkFunction::returnType() const {
+        return Type::Primitive::of(Type::Intrinsic::NUMBER);
+    }
+
+    PrologueFunctionCall* ForEachFileChunkFunction::call(CallVector v) const {
+        return new ForEachFileChunkFunctionCall(_provider, v, returnType());
+    }
+
+
+    void OpenReplicatedFileFunctionCall::execute(VirtualMachine*) {
+        auto global = _provider->global();
+        auto path = (ISA::StringReference*) _vector.at(0).second;
+        auto resource = new FileResource(global->getNodeId(), global->getUuid(), path->value(), ResourceCategory::REPLICATED);
+        setReturn(new ISA::ResourceReference(resource));
+    }
+
+    FormalTypes OpenReplicatedFileFunction::paramTypes() const {
+        return {Type::Primitive::of(Type::Intrinsic::STRING)};
+    }
+
+    Type::Type* OpenReplicatedFileFunction::returnType() const {
+        return Type::Resource::of(fileType());
+    }
+
+    PrologueFunctionCall* OpenReplicatedFileFunction::call(CallVector v) const {
+        return new OpenReplicatedFileFunctionCall(_provider, v, returnType());
+    }
+
+
     void OpenFileFunctionCall::execute(VirtualMachine*) {
         auto global = _provider->global();
         auto path = (ISA::StringReference*) _vector.at(0).second;
@@ -1,6 +1,11 @@
 #ifndef SWARM_FILERESOURCE_H
 #define SWARM_FILERESOURCE_H
 
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
 #include "prologue_provider.h"
 #include "../runtime/fabric.h"
 #include "../../lang/Type.h"
@@ -11,13 +16,54 @@ namespace swarmc::Runtime::Prologue {
         return Type::Opaque::of("PROLOGUE::FILE");
     }
 
+    /**
+     * A read-only, memory-mapped view of a file. Pages are loaded on demand, so
+     * slicing a multi-GB file only touches the pages which are actually read.
+     */
+    class FileView {
+    public:
+        explicit FileView(const std::string& path);
+
+        ~FileView();
+
+        FileView(const FileView&) = delete;
+        FileView& operator=(const FileView&) = delete;
+
+        [[nodiscard]] std::size_t size() const { return _size; }
+
+        /** Get up to `length` bytes starting at `offset`, clamped to the end of the file. */
+        [[nodiscard]] std::string_view slice(std::size_t offset, std::size_t length) const;
+
+        /**
+         * Get the lines which start in the byte range [offset, offset + length), without
+         * their line endings. Adjacent ranges never split or share a line, so a file can be
+         * processed in fixed-size chunks without knowing where its lines fall.
+         */
+        [[nodiscard]] std::vector<std::string_view> lines(std::size_t offset, std::size_t length) const;
+
+        /**
+         * Split the file into ranges of about `chunkSize` bytes which start at the beginning
+         * of a line. Returns the start of each range, followed by the size of the file.
+         * Only the pages around each boundary are read.
+         */
+        [[nodiscard]] std::vector<std::size_t> boundaries(std::size_t chunkSize) const;
+
+    protected:
+        const char* _data = nullptr;
+        std::size_t _size = 0;
+    };
+
     class FileResource : public IResource {
     public:
-        FileResource(NodeID owner, std::string id, std::string path):
-            _id(std::move(id)), _path(std::move(path)), _owner(std::move(owner)) {}
+        /**
+         * A REPLICATED file is assumed to exist at the same path on every node, so
+         * operations on it run against the local copy instead of tunneling to the owner.
+         */
+        FileResource(NodeID owner, std::string id, std::string path, ResourceCategory category = ResourceCategory::TUNNELED):
+            _id(std::move(id)), _path(std::move(path)), _owner(std::move(owner)), _category(category) {}
 
         [[nodiscard]] ResourceCategory category() const override {
-            return ResourceCategory::TUNNELED;
+            return _category;
         }
 
         [[nodiscard]] std::string id() const override { return _id; }
@@ -34,13 +80,45 @@ namespace swarmc::Runtime::Prologue {
 
         ResourceOperationFrame performOperation(VirtualMachine*, OperationName, ResourceOperationFrame) override;
 
+        /** Within a `with` block, writes share one buffered handle and reads share one mapped view. */
+        void acquire(VirtualMachine*) override;
+
+        /** Flush and close the handles opened during the `with` block. */
+        void release(VirtualMachine*) override;
+
+        void replicateLocally(VirtualMachine*) override;
+
+        [[nodiscard]] std::string replicaData() const override { return _path; }
+
         [[nodiscard]] std::string toString() const override {
             return "Prologue::FileResource<path: " + _path + ", owner: " + _owner + ", id: " + _id + ">";
         }
     protected:
+        /** Get a mapped view of the file, flushing any pending writes first. */
+        std::shared_ptr<FileView> view();
+
+        /** True if a view handed out by `view()` is still alive. Call with `_mutex` held. */
+        bool hasLiveViews();
+
+        void forgetExpiredViews();
+
+        /**
+         * Replace (or append to) the contents of the file. Replacing it truncates the file,
+         * which would fault any live mapping, so it fails while a view is still in use.
+         */
+        void write(const std::string& content, bool append);
+
         std::string _id;
         std::string _path;
         NodeID _owner;
+        ResourceCategory _category;
+
+        std::mutex _mutex;
+        std::size_t _acquired = 0;
+        std::unique_ptr<char[]> _writeBuffer;  // declared first, so it outlives the stream using it
+        std::unique_ptr<std::ofstream> _writer;
+        std::shared_ptr<FileView> _view;
+        std::vector<std::weak_ptr<FileView>> _views;  // every view handed out, to detect live mappings
     };
 
 
@@ -134,6 +212,126 @@ namespace swarmc::Runtime::Prologue {
     };
 
 
+    class FileSizeFunctionCall : public PrologueFunctionCall {
+    public:
+        FileSizeFunctionCall(IProvider* provider, const CallVector& vector, Type::Type* returnType):
+            PrologueFunctionCall(provider, "FILE_SIZE", vector, returnType) {}
+
+        void execute(VirtualMachine*) override;
+
+        [[nodiscard]] Resources needsResources() const override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "FileSizeFunctionCall<>";
+        }
+    };
+
+    class FileSizeFunction : public PrologueFunction {
+    public:
+        explicit FileSizeFunction(IProvider* provider) : PrologueFunction("FILE_SIZE", provider) {}
+
+        [[nodiscard]] FormalTypes paramTypes() const override;
+
+        [[nodiscard]] Type::Type* returnType() const override;
+
+        [[nodiscard]] PrologueFunctionCall* call(CallVector) const override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "FileSizeFunction<>";
+        }
+    };
+
+
+    class ReadFileRangeFunctionCall : public PrologueFunctionCall {
+    public:
+        ReadFileRangeFunctionCall(IProvider* provider, const CallVector& vector, Type::Type* returnType):
+            PrologueFunctionCall(provider, "READ_FILE_RANGE", vector, returnType) {}
+
+        void execute(VirtualMachine*) override;
+
+        [[nodiscard]] Resources needsResources() const override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "ReadFileRangeFunctionCall<>";
+        }
+    };
+
+    class ReadFileRangeFunction : public PrologueFunction {
+    public:
+        explicit ReadFileRangeFunction(IProvider* provider) : PrologueFunction("READ_FILE_RANGE", provider) {}
+
+        [[nodiscard]] FormalTypes paramTypes() const override;
+
+        [[nodiscard]] Type::Type* returnType() const override;
+
+        [[nodiscard]] PrologueFunctionCall* call(CallVector) const override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "ReadFileRangeFunction<>";
+        }
+    };
+
+
+    class ReadFileLinesFunctionCall : public PrologueFunctionCall {
+    public:
+        ReadFileLinesFunctionCall(IProvider* provider, const CallVector& vector, Type::Type* returnType):
+            PrologueFunctionCall(provider, "READ_FILE_LINES", vector, returnType) {}
+
+        void execute(VirtualMachine*) override;
+
+        [[nodiscard]] Resources needsResources() const override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "ReadFileLinesFunctionCall<>";
+        }
+    };
+
+    class ReadFileLinesFunction : public PrologueFunction {
+    public:
+        explicit ReadFileLinesFunction(IProvider* provider) : PrologueFunction("READ_FILE_LINES", provider) {}
+
+        [[nodiscard]] FormalTypes paramTypes() const override;
+
+        [[nodiscard]] Type::Type* returnType() const override;
+
+        [[nodiscard]] PrologueFunctionCall* call(CallVector) const override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "ReadFileLinesFunction<>";
+        }
+    };
+
+
+    class StreamFileLinesFunctionCall : public PrologueFunctionCall {
+    public:
+        StreamFileLinesFunctionCall(IProvider* provider, const CallVector& vector, Type::Type* returnType):
+            PrologueFunctionCall(provider, "STREAM_FILE_LINES", vector, returnType) {}
+
+        void execute(VirtualMachine*) override;
+
+        [[nodiscard]] Resources needsResources() const override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "StreamFileLinesFunctionCall<>";
+        }
+    };
+
+    class StreamFileLinesFunction : public PrologueFunction {
+    public:
+        explicit StreamFileLinesFunction(IProvider* provider) : PrologueFunction("STREAM_FILE_LINES", provider) {}
+
+        [[nodiscard]] FormalTypes paramTypes() const override;
+
+        [[nodiscard]] Type::Type* returnType() const override;
+
+        [[nodiscard]] PrologueFunctionCall* call(CallVector) const override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "StreamFileLinesFunction<>";
+        }
+    };
+
+
     class OpenFileFunctionCall : public PrologueFunctionCall {
     public:
         OpenFileFunctionCall(IProvider* provider, const CallVector& vector, Type::Type* returnType):
@@ -161,6 +359,70 @@ namespace swarmc::Runtime::Prologue {
         }
     };
 
+    /**
+     * Split a file into line-aligned ranges and push a call to the handler for each one,
+     * passing the file, the range's offset, and its length. Each job reads only its own
+     * range (e.g. with readLines), so the calling control never loads the file.
+     * Waits for every job to finish, then returns the number of ranges.
+     */
+    class ForEachFileChunkFunctionCall : public PrologueFunctionCall {
+    public:
+        ForEachFileChunkFunctionCall(IProvider* provider, const CallVector& vector, Type::Type* returnType):
+            PrologueFunctionCall(provider, "FOR_EACH_FILE_CHUNK", vector, returnType) {}
+
+        void execute(VirtualMachine*) override;
+
+        [[nodiscard]] Resources needsResources() const override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "ForEachFileChunkFunctionCall<>";
+        }
+    };
+
+    class ForEachFileChunkFunction : public PrologueFunction {
+    public:
+        explicit ForEachFileChunkFunction(IProvider* provider) : PrologueFunction("FOR_EACH_FILE_CHUNK", provider) {}
+
+        [[nodiscard]] FormalTypes paramTypes() const override;
+
+        [[nodiscard]] Type::Type* returnType() const override;
+
+        [[nodiscard]] PrologueFunctionCall* call(CallVector) const override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "ForEachFileChunkFunction<>";
+        }
+    };
+
+
+    class OpenReplicatedFileFunctionCall : public PrologueFunctionCall {
+    public:
+        OpenReplicatedFileFunctionCall(IProvider* provider, const CallVector& vector, Type::Type* returnType):
+            PrologueFunctionCall(provider, "OPEN_REPLICATED_FILE", vector, returnType) {}
+
+        void execute(VirtualMachine*) override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "OpenReplicatedFileFunctionCall<>";
+        }
+    };
+
+    class OpenReplicatedFileFunction : public PrologueFunction {
+    public:
+        explicit OpenReplicatedFileFunction(IProvider* provider) : PrologueFunction("OPEN_REPLICATED_FILE", provider) {}
+
+        [[nodiscard]] FormalTypes paramTypes() const override;
+
+        [[nodiscard]] Type::Type* returnType() const override;
+
+        [[nodiscard]] PrologueFunctionCall* call(CallVector) const override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "OpenReplicatedFileFunction<>";
+        }
+    };
+
+
     class FileTFunctionCall : public PrologueFunctionCall {
     public:
         FileTFunctionCall(IProvider* provider, const CallVector& vector, Type::Type* returnType):
@@ -1,65 +1,268 @@
 #include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
 #include "../../shared/nslib.h"
+#include "../../errors/RuntimeError.h"
 #include "SocketResource.h"
 #include "../VirtualMachine.h"
 
 namespace swarmc::Runtime::Prologue {
 
+	namespace {
+		[[noreturn]] void throwSocketError(const std::string& action, const IResource* resource) {
+			throw Errors::RuntimeError(
+				Errors::RuntimeExCode::SocketOperationFailed,
+				"Unable to " + action + " (" + s(resource) + "): " + strerror(errno)
+			);
+		}
+
+		bool wouldBlock() {
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+		}
+	}
+
+	SocketEventLoop* SocketEventLoop::get() {
+		static SocketEventLoop loop;
+		return &loop;
+	}
+
+	SocketEventLoop::SocketEventLoop() : _epoll(::epoll_create1(EPOLL_CLOEXEC)) {
+		if ( _epoll < 0 ) {
+			throw Errors::RuntimeError(
+				Errors::RuntimeExCode::SocketOperationFailed,
+				std::string("Unable to create socket event loop: ") + strerror(errno)
+			);
+		}
+	}
+
+	void SocketEventLoop::watch(int fd) {
+		{
+			std::unique_lock<std::mutex> lock(_readinessMutex);
+			_readiness[fd] = 0;
+		}
+
+		epoll_event event {};
+		event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+		event.data.fd = fd;
+		if ( ::epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &event) != 0 ) {
+			throw Errors::RuntimeError(
+				Errors::RuntimeExCode::SocketOperationFailed,
+				"Unable to watch socket descriptor " + s(fd) + ": " + strerror(errno)
+			);
+		}
+	}
+
+	void SocketEventLoop::forget(int fd) {
+		::epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, nullptr);
+
+		std::unique_lock<std::mutex> lock(_readinessMutex);
+		_readiness.erase(fd);
+	}
+
+	void SocketEventLoop::consume(int fd, std::uint32_t events) {
+		std::unique_lock<std::mutex> lock(_readinessMutex);
+		auto it = _readiness.find(fd);
+		if ( it != _readiness.end() ) it->second &= ~events;
+	}
+
+	bool SocketEventLoop::isReady(int fd, std::uint32_t events) {
+		// Errors and hang-ups are never consumed, so the next attempt on the socket reports them
+		events |= EPOLLERR | EPOLLHUP;
+		if ( events & EPOLLIN ) events |= EPOLLRDHUP;
+
+		std::unique_lock<std::mutex> lock(_readinessMutex);
+		auto it = _readiness.find(fd);
+		return it == _readiness.end() || (it->second & events) != 0;
+	}
+
+	void SocketEventLoop::waitFor(VirtualMachine* vm, int fd, std::uint32_t events) {
+		for ( int attempt = 0; !isReady(fd, events); attempt += 1 ) {
+			// Pick up events that are already pending before spinning or backing off
+			awaitEvents(std::chrono::microseconds(0));
+			if ( isReady(fd, events) ) return;
+
+			vm->whileWaitingForIO(attempt, [this](std::chrono::microseconds timeout) {
+				awaitEvents(timeout);
+			});
+		}
+	}
+
+	void SocketEventLoop::awaitEvents(std::chrono::microseconds timeout) {
+		std::unique_lock<std::mutex> pollLock(_pollMutex, std::try_to_lock);
+		if ( pollLock.owns_lock() ) {
+			// epoll_wait takes milliseconds, so round up rather than spinning on short timeouts
+			poll(static_cast<int>((timeout.count() + 999) / 1000));
+			return;
+		}
+
+		// Another control is polling, so wait for it to report new events
+		std::unique_lock<std::mutex> lock(_readinessMutex);
+		_readinessChanged.wait_for(lock, timeout);
+	}
+
+	void SocketEventLoop::poll(int timeoutMs) {
+		epoll_event events[64];
+		auto count = ::epoll_wait(_epoll, events, 64, timeoutMs);
+		if ( count <= 0 ) return;  // timed out, or interrupted
+
+		{
+			std::unique_lock<std::mutex> lock(_readinessMutex);
+			for ( int i = 0; i < count; i += 1 ) {
+				auto it = _readiness.find(events[i].data.fd);
+				if ( it != _readiness.end() ) it->second |= events[i].events;
+			}
+		}
+
+		_readinessChanged.notify_all();
+	}
+
+	std::mutex SocketBuffer::_poolMutex;
+	std::vector<std::unique_ptr<char[]>> SocketBuffer::_pool;
+
+	SocketBuffer::SocketBuffer() {
+		{
+			std::unique_lock<std::mutex> lock(_poolMutex);
+			if ( !_pool.empty() ) {
+				_data = std::move(_pool.back());
+				_pool.pop_back();
+				return;
+			}
+		}
+
+		_data = std::unique_ptr<char[]>(new char[size()]);
+	}
+
+	SocketBuffer::~SocketBuffer() {
+		// Keep about one buffer per worker thread; any more than that are rarely reused
+		std::unique_lock<std::mutex> lock(_poolMutex);
+		if ( _pool.size() < Configuration::MAX_THREADS ) _pool.push_back(std::move(_data));
+	}
+
 	ResourceOperationFrame SocketResource::performOperation(VirtualMachine* vm, OperationName op, ResourceOperationFrame params) {
 		if ( op == "PROLOGUE::OP::SOCKET::OPEN" ) {
 			// Open the socket
-			_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-			assert(_socket > 0);
+			_socket = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+			if ( _socket < 0 ) throwSocketError("open socket", this);
 
 			// Configure the socket
 			int opt = 1;
-			auto setsockoptResult = setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-			assert(setsockoptResult == 0);
-
-			setsockoptResult = setsockopt(_socket, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
-			assert(setsockoptResult == 0);
+			if ( setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) != 0 ) throwSocketError("configure socket", this);
+			if ( setsockopt(_socket, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) != 0 ) throwSocketError("configure socket", this);
 
 			// Bind the socket
-			auto bindResult = ::bind(_socket, (struct sockaddr *) &_config, sizeof(_config));
-			assert(bindResult == 0);
+			if ( ::bind(_socket, (struct sockaddr *) &_config, sizeof(_config)) != 0 ) throwSocketError("bind socket", this);
 
 			// Start listening for connections
-			auto listenResult = listen(_socket, (int) floor(_pendingConnectionLimit));
-			assert(listenResult == 0);
-
-			// TODO: handle failures in this call
+			if ( listen(_socket, (int) floor(_pendingConnectionLimit)) != 0 ) throwSocketError("listen on socket", this);
 
+			SocketEventLoop::get()->watch(_socket);
 			return {};
 		}
 
 		if ( op == "PROLOGUE::OP::SOCKET::ACCEPT" ) {
-			auto conn = new SocketConnectionResource(_owner, vm->global()->getUuid());
-			conn->acceptFromServer(_socket);
-			_connections[conn->id()] = conn;
-
+			auto conn = waitForConnection(vm);
 			return {new ISA::ResourceReference(conn)};
 		}
 
+		if ( op == "PROLOGUE::OP::SOCKET::ACCEPT_PENDING" ) {
+			// Wait for the first connection, then take every other one already in the backlog
+			ResourceOperationFrame conns = {new ISA::ResourceReference(waitForConnection(vm))};
+			while ( auto conn = tryAccept(vm) ) {
+				conns.push_back(new ISA::ResourceReference(conn));
+			}
+
+			return conns;
+		}
+
 		throw InvalidResourceOperation(s(this), op);
 	}
 
+	SocketConnectionResource* SocketResource::tryAccept(VirtualMachine* vm) {
+		auto conn = new SocketConnectionResource(_owner, vm->global()->getUuid());
+		if ( !conn->acceptFromServer(_socket) ) {
+			delete conn;
+			return nullptr;
+		}
+
+		_connections[conn->id()] = conn;
+		return conn;
+	}
+
+	SocketConnectionResource* SocketResource::waitForConnection(VirtualMachine* vm) {
+		auto loop = SocketEventLoop::get();
+		while ( true ) {
+			loop->consume(_socket, EPOLLIN);
+			if ( auto conn = tryAccept(vm) ) return conn;
+			loop->waitFor(vm, _socket, EPOLLIN);
+		}
+	}
+
 	ResourceOperationFrame SocketConnectionResource::performOperation(VirtualMachine* vm, OperationName op, ResourceOperationFrame params) {
+		auto loop = SocketEventLoop::get();
+
 		if ( op == "PROLOGUE::OP::SOCKET::CONNECTION::RECEIVE" ) {
-			std::vector<char> buffer(Configuration::SOCKET_MAX_BUFFER_SIZE);
-			std::string data;
-			std::size_t bytesReceived = ::recv(_client, &buffer[0], Configuration::SOCKET_MAX_BUFFER_SIZE, 0);
-			assert(bytesReceived >= 0);
-			data.append(buffer.cbegin(), buffer.cend());
-			return {new ISA::StringReference(data)};
+			// Returns whatever is available once the connection is readable. Empty means the peer closed it.
+			SocketBuffer buffer;
+			while ( true ) {
+				loop->consume(_client, EPOLLIN);
+				auto bytesReceived = ::recv(_client, buffer.data(), SocketBuffer::size(), 0);
+				if ( bytesReceived >= 0 ) {
+					return {new ISA::StringReference(std::string(buffer.data(), bytesReceived))};
+				}
+
+				if ( errno == EINTR ) continue;
+				if ( !wouldBlock() ) throwSocketError("receive from connection", this);
+				loop->waitFor(vm, _client, EPOLLIN);
+			}
+		}
+
+		if ( op == "PROLOGUE::OP::SOCKET::CONNECTION::SEND" ) {
+			assert(!params.empty());
+			assert(params.at(0)->tag() == ISA::ReferenceTag::STRING);
+			const auto& data = ((ISA::StringReference*) params.at(0))->value();
+
+			std::size_t sent = 0;
+			while ( sent < data.size() ) {
+				loop->consume(_client, EPOLLOUT);
+				auto bytesSent = ::send(_client, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+				if ( bytesSent >= 0 ) {
+					sent += bytesSent;
+					continue;
+				}
+
+				if ( errno == EINTR ) continue;
+				if ( !wouldBlock() ) throwSocketError("send to connection", this);
+				loop->waitFor(vm, _client, EPOLLOUT);
+			}
+
+			return {};
+		}
+
+		if ( op == "PROLOGUE::OP::SOCKET::CONNECTION::CLOSE" ) {
+			if ( _client >= 0 ) {
+				loop->forget(_client);
+				::close(_client);
+				_client = -1;
+			}
+
+			return {};
 		}
 
 		throw InvalidResourceOperation(s(this), op);
 	}
 
-	void SocketConnectionResource::acceptFromServer(int serverDescriptor) {
-		_client = ::accept4(serverDescriptor, (struct sockaddr*) &_addr, &_addrLen, 0);
-		assert(_client > 0);
-		// fixme: handle error
+	bool SocketConnectionResource::acceptFromServer(int serverDescriptor) {
+		_addrLen = sizeof(_addr);
+		_client = ::accept4(serverDescriptor, (struct sockaddr*) &_addr, &_addrLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if ( _client < 0 ) {
+			// The backlog is empty, or the client gave up before we got to it
+			if ( wouldBlock() || errno == ECONNABORTED || errno == EINTR ) return false;
+			throwSocketError("accept connection", this);
+		}
+
+		SocketEventLoop::get()->watch(_client);
+		return true;
 	}
 
 	void SocketFunctionCall::execute(VirtualMachine* vm) {
@@ -158,6 +361,85 @@ namespace swarmc::Runtime::Prologue {
 	}
 
 
+	void WriteToConnectionFunctionCall::execute(VirtualMachine* vm) {
+		// Load the resource and make some sanity checks
+		auto resource = (ISA::ResourceReference*) _vector.at(0).second;
+		assert(resource->resource()->name() == "PROLOGUE::SOCKET::CONNECTION");
+
+		// Perform the operation on the resource
+		auto conn = resource->resource();
+		conn->performOperation(vm, "PROLOGUE::OP::SOCKET::CONNECTION::SEND", {_vector.at(1).second});
+	}
+
+	FormalTypes WriteToConnectionFunction::paramTypes() const {
+		return {Type::Resource::of(socketConnectionType()), Type::Primitive::of(Type::Intrinsic::STRING)};
+	}
+
+	Type::Type* WriteToConnectionFunction::returnType() const {
+		return Type::Primitive::of(Type::Intrinsic::VOID);
+	}
+
+	PrologueFunctionCall* WriteToConnectionFunction::call(CallVector vector) const {
+		return new WriteToConnectionFunctionCall(_provider, vector, returnType());
+	}
+
+
+	void CloseConnectionFunctionCall::execute(VirtualMachine* vm) {
+		// Load the resource and make some sanity checks
+		auto resource = (ISA::ResourceReference*) _vector.at(0).second;
+		assert(resource->resource()->name() == "PROLOGUE::SOCKET::CONNECTION");
+
+		// Perform the operation on the resource
+		auto conn = resource->resource();
+		conn->performOperation(vm, "PROLOGUE::OP::SOCKET::CONNECTION::CLOSE", {});
+	}
+
+	FormalTypes CloseConnectionFunction::paramTypes() const {
+		return {Type::Resource::of(socketConnectionType())};
+	}
+
+	Type::Type* CloseConnectionFunction::returnType() const {
+		return Type::Primitive::of(Type::Intrinsic::VOID);
+	}
+
+	PrologueFunctionCall* CloseConnectionFunction::call(CallVector vector) const {
+		return new CloseConnectionFunctionCall(_provider, vector, returnType());
+	}
+
+
+	void ServeSocketFunctionCall::execute(VirtualMachine* vm) {
+		// Load the resource and make some sanity checks
+		auto resource = (ISA::ResourceReference*) _vector.at(0).second;
+		assert(resource->resource()->name() == "PROLOGUE::SOCKET");
+		auto handler = (ISA::FunctionReference*) _vector.at(1).second;
+
+		// Accept the pending connections and hand each one off to a job
+		auto socket = resource->resource();
+		auto conns = socket->performOperation(vm, "PROLOGUE::OP::SOCKET::ACCEPT_PENDING", {});
+		for ( auto conn : conns ) {
+			assert(conn->tag() == ISA::ReferenceTag::RESOURCE);
+			vm->pushCall(handler->fn()->curryi(conn)->call());
+		}
+
+		setReturn(new ISA::NumberReference((double) conns.size()));
+	}
+
+	FormalTypes ServeSocketFunction::paramTypes() const {
+		return {
+			Type::Resource::of(socketType()),
+			Type::Lambda1::of(Type::Resource::of(socketConnectionType()), Type::Primitive::of(Type::Intrinsic::VOID)),
+		};
+	}
+
+	Type::Type* ServeSocketFunction::returnType() const {
+		return Type::Primitive::of(Type::Intrinsic::NUMBER);
+	}
+
+	PrologueFunctionCall* ServeSocketFunction::call(CallVector vector) const {
+		return new ServeSocketFunctionCall(_provider, vector, returnType());
+	}
+
+
 	void SocketTFunctionCall::execute(VirtualMachine*) {
 		setReturn(new ISA::TypeReference(socketType()));
 	}
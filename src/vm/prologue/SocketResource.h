@@ -2,10 +2,17 @@
 #define SWARM_SOCKETRESOURCE_H
 
 #include <cstdio>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <utility>
+#include <vector>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/ip.h>
+#include "../../Configuration.h"
 #include "prologue_provider.h"
 #include "../runtime/fabric.h"
 #include "../../lang/Type.h"
@@ -14,6 +21,72 @@ namespace swarmc::Runtime::Prologue {
 
     class SocketConnectionResource;
 
+    /**
+     * A process-wide, edge-triggered epoll instance watching every prologue socket.
+     * Sockets are non-blocking: when an operation would block, the control waits here
+     * for the descriptor to become ready and runs pending jobs in the meantime. Whichever
+     * waiting control holds the poll lock collects events on behalf of all of them.
+     */
+    class SocketEventLoop {
+    public:
+        static SocketEventLoop* get();
+
+        /** Start watching a (non-blocking) descriptor for readiness. */
+        void watch(int fd);
+
+        /** Stop watching a descriptor. Call before closing it. */
+        void forget(int fd);
+
+        /**
+         * Clear the recorded readiness for `events` on `fd`. Do this before each attempt
+         * which may fail with EAGAIN, so an edge arriving after the attempt isn't missed.
+         */
+        void consume(int fd, std::uint32_t events);
+
+        /** Wait until `fd` is ready for one of `events`, or has errored or hung up. */
+        void waitFor(VirtualMachine*, int fd, std::uint32_t events);
+
+    protected:
+        SocketEventLoop();
+
+        bool isReady(int fd, std::uint32_t events);
+
+        /** Poll for events if no other control is, otherwise wait for that control to report them. */
+        void awaitEvents(std::chrono::microseconds timeout);
+
+        void poll(int timeoutMs);
+
+        int _epoll;
+        std::mutex _pollMutex;
+        std::mutex _readinessMutex;
+        std::condition_variable _readinessChanged;
+        std::unordered_map<int, std::uint32_t> _readiness;
+    };
+
+    /**
+     * A receive buffer of SOCKET_MAX_BUFFER_SIZE bytes, leased from a process-wide pool
+     * and returned to it on destruction, so reads don't allocate a fresh 64 KiB each time.
+     */
+    class SocketBuffer {
+    public:
+        SocketBuffer();
+
+        ~SocketBuffer();
+
+        SocketBuffer(const SocketBuffer&) = delete;
+        SocketBuffer& operator=(const SocketBuffer&) = delete;
+
+        [[nodiscard]] char* data() const { return _data.get(); }
+
+        [[nodiscard]] static std::size_t size() { return Configuration::SOCKET_MAX_BUFFER_SIZE; }
+
+    protected:
+        std::unique_ptr<char[]> _data;
+
+        static std::mutex _poolMutex;
+        static std::vector<std::unique_ptr<char[]>> _pool;
+    };
+
     inline Type::Opaque* socketType() {
         return Type::Opaque::of("PROLOGUE::SOCKET");
     }
@@ -49,6 +122,12 @@ namespace swarmc::Runtime::Prologue {
         }
 
     protected:
+        /** Accept a pending connection without blocking, or return nullptr if there is none. */
+        SocketConnectionResource* tryAccept(VirtualMachine*);
+
+        /** Accept a connection, waiting on the event loop until one arrives. */
+        SocketConnectionResource* waitForConnection(VirtualMachine*);
+
         NodeID _owner;
         std::string _id;
         int _socket;
@@ -65,7 +144,7 @@ namespace swarmc::Runtime::Prologue {
     class SocketConnectionResource : public IResource {
     public:
         SocketConnectionResource(NodeID owner, std::string id)
-            : _owner(std::move(owner)), _id(std::move(id)), _client(0), _addrLen(sizeof(_addr)) {}
+            : _owner(std::move(owner)), _id(std::move(id)), _client(-1), _addrLen(sizeof(_addr)) {}
 
         [[nodiscard]] ResourceCategory category() const override {
             return ResourceCategory::TUNNELED;
@@ -77,7 +156,8 @@ namespace swarmc::Runtime::Prologue {
 
         [[nodiscard]] std::string name() const override { return "PROLOGUE::SOCKET::CONNECTION"; }
 
-        void acceptFromServer(int serverDescriptor);
+        /** Accept a pending connection without blocking. Returns false if none is pending. */
+        bool acceptFromServer(int serverDescriptor);
 
         [[nodiscard]] Type::Type* innerType() const override {
             return socketConnectionType();
@@ -205,6 +285,92 @@ namespace swarmc::Runtime::Prologue {
         }
     };
 
+    class WriteToConnectionFunctionCall : public PrologueFunctionCall {
+    public:
+        WriteToConnectionFunctionCall(IProvider* provider, const CallVector& vector, Type::Type* returnType):
+                PrologueFunctionCall(provider, "WRITE_TO_CONNECTION", vector, returnType) {}
+
+        void execute(VirtualMachine*) override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "WriteToConnectionFunctionCall<>";
+        }
+    };
+
+    class WriteToConnectionFunction : public PrologueFunction {
+    public:
+        explicit WriteToConnectionFunction(IProvider* provider) : PrologueFunction("WRITE_TO_CONNECTION", provider) {}
+
+        [[nodiscard]] FormalTypes paramTypes() const override;
+
+        [[nodiscard]] Type::Type* returnType() const override;
+
+        [[nodiscard]] PrologueFunctionCall* call(CallVector) const override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "WriteToConnectionFunction<>";
+        }
+    };
+
+    class CloseConnectionFunctionCall : public PrologueFunctionCall {
+    public:
+        CloseConnectionFunctionCall(IProvider* provider, const CallVector& vector, Type::Type* returnType):
+                PrologueFunctionCall(provider, "CLOSE_CONNECTION", vector, returnType) {}
+
+        void execute(VirtualMachine*) override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "CloseConnectionFunctionCall<>";
+        }
+    };
+
+    class CloseConnectionFunction : public PrologueFunction {
+    public:
+        explicit CloseConnectionFunction(IProvider* provider) : PrologueFunction("CLOSE_CONNECTION", provider) {}
+
+        [[nodiscard]] FormalTypes paramTypes() const override;
+
+        [[nodiscard]] Type::Type* returnType() const override;
+
+        [[nodiscard]] PrologueFunctionCall* call(CallVector) const override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "CloseConnectionFunction<>";
+        }
+    };
+
+    /**
+     * Wait for connections on a socket, accept every one that is pending, and push a call
+     * to the handler for each onto the queue, so they can be served in parallel by workers.
+     * Returns the number of connections dispatched.
+     */
+    class ServeSocketFunctionCall : public PrologueFunctionCall {
+    public:
+        ServeSocketFunctionCall(IProvider* provider, const CallVector& vector, Type::Type* returnType):
+                PrologueFunctionCall(provider, "SERVE_SOCKET", vector, returnType) {}
+
+        void execute(VirtualMachine*) override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "ServeSocketFunctionCall<>";
+        }
+    };
+
+    class ServeSocketFunction : public PrologueFunction {
+    public:
+        explicit ServeSocketFunction(IProvider* provider) : PrologueFunction("SERVE_SOCKET", provider) {}
+
+        [[nodiscard]] FormalTypes paramTypes() const override;
+
+        [[nodiscard]] Type::Type* returnType() const override;
+
+        [[nodiscard]] PrologueFunctionCall* call(CallVector) const override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "ServeSocketFunction<>";
+        }
+    };
+
     class SocketTFunctionCall : public PrologueFunctionCall {
     public:
         SocketTFunctionCall(IProvider* provider, const CallVector& vector, Type::Type* returnType):
@@ -26,7 +26,7 @@ namespace swarmc::Runtime::Prologue {
 
         [[nodiscard]] FormalTypes paramTypes() const override {
             return {
-                new Type::Enumerable(Type::Ambiguous::of())
+                Type::Enumerable::of(Type::Ambiguous::of())
             };
         }
 
@@ -0,0 +1,52 @@
+#include <chrono>
+#include "enumerate.h"
+#include "../VirtualMachine.h"
+
+namespace swarmc::Runtime::Prologue {
+
+    void EnumerateBatchFunctionCall::execute(VirtualMachine* vm) {
+        auto callback = (ISA::FunctionReference*) _vector.at(0).second;
+        auto elements = (ISA::EnumerationReference*) _vector.at(1).second;
+        auto first = static_cast<std::size_t>(((ISA::NumberReference*) _vector.at(2).second)->value());
+
+        auto start = std::chrono::steady_clock::now();
+
+        // One VM runs the whole range; each call returns before the next one starts.
+        // A failing element is logged like a failed job, and the rest of the range still runs.
+        std::size_t failed = 0;
+        vm->copy([callback, elements, first, &failed](VirtualMachine* rangeVm) {
+            for ( std::size_t i = 0; i < elements->length(); i += 1 ) {
+                auto call = callback->fn()
+                    ->curryi(elements->get(i))
+                    ->curryi(new ISA::NumberReference(static_cast<double>(first + i)))
+                    ->call();
+
+                GC_LOCAL_REF(call)
+                try {
+                    rangeVm->executeCall(call);
+                } catch (Errors::SwarmError& rte) {
+                    Console::get()->error("Thread error: " + s(rte));
+                    failed += 1;
+                } catch (...) {
+                    Console::get()->error("Unknown thread error!");
+                    failed += 1;
+                }
+            }
+        });
+
+        if ( failed > 0 ) {
+            throw Errors::RuntimeError(
+                Errors::RuntimeExCode::ParallelJobFailed,
+                s(failed) + " of " + s(elements->length()) + " element(s) in the range starting at " + s(first) + " failed"
+            );
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        setReturn(new ISA::NumberReference(static_cast<double>(elapsed.count())));
+    }
+
+    PrologueFunctionCall* EnumerateBatchFunction::call(CallVector vector) const {
+        return new EnumerateBatchFunctionCall(_provider, vector, returnType());
+    }
+
+}
@@ -0,0 +1,55 @@
+#ifndef SWARMVM_ENUMERATE
+#define SWARMVM_ENUMERATE
+
+#include <utility>
+
+#include "prologue_provider.h"
+#include "../isa_meta.h"
+
+namespace swarmc::Runtime::Prologue {
+
+    /**
+     * Runs an `enumerate` callback over a contiguous range of elements as a single job.
+     * The VM pushes these in place of one job per element when the prologue is loaded
+     * (see `ExecuteWalk::enumerateInBatches`). Takes the callback, the elements in the
+     * range, and the index of the first one, and returns the microseconds the elements
+     * took so the VM can size the next ranges.
+     */
+    class EnumerateBatchFunctionCall : public PrologueFunctionCall {
+    public:
+        EnumerateBatchFunctionCall(IProvider* provider, const CallVector& vector, Type::Type* returnType):
+            PrologueFunctionCall(provider, "ENUMERATE_BATCH", vector, returnType) {}
+
+        void execute(VirtualMachine*) override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "EnumerateBatchFunctionCall<>";
+        }
+    };
+
+    class EnumerateBatchFunction : public PrologueFunction {
+    public:
+        explicit EnumerateBatchFunction(IProvider* provider) : PrologueFunction("ENUMERATE_BATCH", provider) {}
+
+        [[nodiscard]] FormalTypes paramTypes() const override {
+            return {
+                Type::Ambiguous::of(),
+                Type::Enumerable::of(Type::Ambiguous::of()),
+                Type::Primitive::of(Type::Intrinsic::NUMBER),
+            };
+        }
+
+        [[nodiscard]] Type::Type* returnType() const override {
+            return Type::Primitive::of(Type::Intrinsic::NUMBER);
+        }
+
+        [[nodiscard]] PrologueFunctionCall* call(CallVector) const override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "EnumerateBatchFunction<>";
+        }
+    };
+
+}
+
+#endif //SWARMVM_ENUMERATE
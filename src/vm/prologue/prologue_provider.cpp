@@ -13,10 +13,19 @@
 #include "vectors.h"
 #include "SocketResource.h"
 #include "string_helpers.h"
+#include "reduce.h"
+#include "enumerate.h"
 
 
 namespace swarmc::Runtime::Prologue {
 
+    Provider::Provider(IGlobalServices* global) : _global(useref(global)) {
+        // Lets REPLICATED files be rebuilt on the nodes they are sent to
+        Fabric::registerReplica("PROLOGUE::FILE", [](const std::string& id, const NodeID& owner, const std::string& path) -> IResource* {
+            return new FileResource(owner, id, path, ResourceCategory::REPLICATED);
+        });
+    }
+
     PrologueFunction* Provider::loadFunction(std::string name) {
         if ( name == "NUMBER_TO_STRING" ) return new NumberToStringFunction(this);
         if ( name == "BOOLEAN_TO_STRING" ) return new BooleanToStringFunction(this);
@@ -27,11 +36,22 @@ namespace swarmc::Runtime::Prologue {
         if ( name == "RANDOM_VECTOR" ) return new RandomVectorFunction(this);
         if ( name == "RANDOM_MATRIX" ) return new RandomMatrixFunction(this);
         if ( name == "RANGE" ) return new RangeFunction(this);
+        if ( name == "REDUCE" ) return new ReduceFunction(this);
+        if ( name == "MAP_REDUCE" ) return new MapReduceFunction(this);
+        if ( name == "REDUCE_BLOCK" ) return new ReduceBlockFunction(this, false);
+        if ( name == "MAP_REDUCE_BLOCK" ) return new ReduceBlockFunction(this, true);
+        if ( name == "ENUMERATE_BATCH" ) return new EnumerateBatchFunction(this);
         if ( name == "TAG" ) return new TagFunction(this);
         if ( name == "OPEN_FILE" ) return new OpenFileFunction(this);
         if ( name == "READ_FILE" ) return new ReadFileFunction(this);
         if ( name == "WRITE_FILE" ) return new WriteFileFunction(this);
         if ( name == "APPEND_FILE" ) return new AppendFileFunction(this);
+        if ( name == "FILE_SIZE" ) return new FileSizeFunction(this);
+        if ( name == "READ_FILE_RANGE" ) return new ReadFileRangeFunction(this);
+        if ( name == "READ_FILE_LINES" ) return new ReadFileLinesFunction(this);
+        if ( name == "STREAM_FILE_LINES" ) return new StreamFileLinesFunction(this);
+        if ( name == "FOR_EACH_FILE_CHUNK" ) return new ForEachFileChunkFunction(this);
+        if ( name == "OPEN_REPLICATED_FILE" ) return new OpenReplicatedFileFunction(this);
         if ( name == "RESOURCE_T" ) return new ResourceTFunction(this);
         if ( name == "FILE_T" ) return new FileTFunction(this);
         if ( name == "TAG_T" ) return new TagTFunction(this);
@@ -58,6 +78,9 @@ namespace swarmc::Runtime::Prologue {
         if ( name == "OPEN_SOCKET" ) return new OpenSocketFunction(this);
         if ( name == "ACCEPT_SOCKET_CONNECTION" ) return new AcceptSocketConnectionFunction(this);
         if ( name == "READ_FROM_CONNECTION" ) return new ReadFromConnectionFunction(this);
+        if ( name == "WRITE_TO_CONNECTION" ) return new WriteToConnectionFunction(this);
+        if ( name == "CLOSE_CONNECTION" ) return new CloseConnectionFunction(this);
+        if ( name == "SERVE_SOCKET" ) return new ServeSocketFunction(this);
         if ( name == "CHAR_COUNT" ) return new CharCountFunction(this);
         if ( name == "CHAR_AT" ) return new CharAtFunction(this);
 
@@ -51,7 +51,7 @@ namespace swarmc::Runtime::Prologue {
 
     class Provider : public IProvider {
     public:
-        explicit Provider(IGlobalServices* global) : _global(useref(global)) {}
+        explicit Provider(IGlobalServices* global);
 
         ~Provider() override {
             freeref(_global);
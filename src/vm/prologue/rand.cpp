@@ -33,7 +33,7 @@ namespace swarmc::Runtime::Prologue {
     }
 
     Type::Type* RandomVectorFunction::returnType() const {
-        return new Type::Enumerable(Type::Primitive::of(Type::Intrinsic::NUMBER));
+        return Type::Enumerable::of(Type::Primitive::of(Type::Intrinsic::NUMBER));
     }
 
     PrologueFunctionCall* RandomVectorFunction::call(CallVector vector) const {
@@ -45,7 +45,7 @@ namespace swarmc::Runtime::Prologue {
         auto nRows = (ISA::NumberReference*) _vector.at(0).second;
         auto nCols = (ISA::NumberReference*) _vector.at(1).second;
 
-        auto enumOfNumsType = new Type::Enumerable(Type::Primitive::of(Type::Intrinsic::NUMBER));
+        auto enumOfNumsType = Type::Enumerable::of(Type::Primitive::of(Type::Intrinsic::NUMBER));
         auto matrix = new ISA::EnumerationReference(enumOfNumsType);
         matrix->reserve(static_cast<std::size_t>(nRows->value()));
 
@@ -71,8 +71,8 @@ namespace swarmc::Runtime::Prologue {
     }
 
     Type::Type* RandomMatrixFunction::returnType() const {
-        auto enumOfNumsType = new Type::Enumerable(Type::Primitive::of(Type::Intrinsic::NUMBER));
-        return new Type::Enumerable(enumOfNumsType);
+        auto enumOfNumsType = Type::Enumerable::of(Type::Primitive::of(Type::Intrinsic::NUMBER));
+        return Type::Enumerable::of(enumOfNumsType);
     }
 
     PrologueFunctionCall* RandomMatrixFunction::call(CallVector vector) const {
@@ -38,7 +38,7 @@ namespace swarmc::Runtime::Prologue {
     }
 
     Type::Type* RangeFunction::returnType() const {
-        return new Type::Enumerable(Type::Primitive::of(Type::Intrinsic::NUMBER));
+        return Type::Enumerable::of(Type::Primitive::of(Type::Intrinsic::NUMBER));
     }
 
     PrologueFunctionCall* RangeFunction::call(CallVector vector) const {
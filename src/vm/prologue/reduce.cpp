@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include "reduce.h"
+#include "../VirtualMachine.h"
+
+namespace swarmc::Runtime::Prologue {
+
+    namespace {
+        using References = std::vector<ISA::Reference*>;
+
+        /** Run `call` to completion in `vm` and return its result, with a reference held on it. */
+        ISA::Reference* runForValue(VirtualMachine* vm, IFunctionCall* call) {
+            GC_LOCAL_REF(call)
+            vm->executeCall(call);
+
+            auto result = call->getReturn();
+            if ( result == nullptr ) {
+                throw Errors::RuntimeError(
+                    Errors::RuntimeExCode::ParallelJobFailed,
+                    "Call " + s(call) + " finished without returning a value"
+                );
+            }
+
+            return useref(result);
+        }
+
+        /**
+         * Fold `elements` from left to right with `combine`, mapping each element with `map`
+         * first if it is set. Runs on a copy of `vm`, one call after another. Returns the
+         * result with a reference held on it.
+         */
+        ISA::Reference* foldInOrder(VirtualMachine* vm, ISA::FunctionReference* map, ISA::FunctionReference* combine, ISA::EnumerationReference* elements) {
+            ISA::Reference* acc = nullptr;
+            vm->copy([map, combine, elements, &acc](VirtualMachine* foldVm) {
+                ISA::Reference* value = nullptr;
+                try {
+                    for ( std::size_t i = 0; i < elements->length(); i += 1 ) {
+                        value = useref(elements->get(i));
+                        if ( map != nullptr ) {
+                            auto mapped = runForValue(foldVm, map->fn()->curryi(value)->call());
+                            freeref(value);
+                            value = mapped;
+                        }
+
+                        if ( acc == nullptr ) {
+                            acc = value;
+                            value = nullptr;
+                            continue;
+                        }
+
+                        auto next = runForValue(foldVm, combine->fn()->curryi(acc)->curryi(value)->call());
+                        freeref(value);
+                        freeref(acc);
+                        value = nullptr;
+                        acc = next;
+                    }
+                } catch (...) {
+                    if ( value != nullptr ) freeref(value);
+                    if ( acc != nullptr ) freeref(acc);
+                    throw;
+                }
+            });
+
+            return acc;
+        }
+
+        /**
+         * Split `values` into `count` contiguous blocks of nearly equal size and push the call
+         * `build` makes for each block in a queue context of their own. Waits for them, and
+         * returns their results (with a reference held on each) in block order.
+         */
+        References foldBlocks(VirtualMachine* vm, ISA::EnumerationReference* values, std::size_t count, const std::function<IFunctionCall*(ISA::EnumerationReference*)>& build) {
+            auto enumType = values->type();
+            GC_LOCAL_REF(enumType)
+
+            vm->enterQueueContext();
+
+            std::vector<JobID> jobs;
+            jobs.reserve(count);
+            auto length = values->length();
+            for ( std::size_t block = 0; block < count; block += 1 ) {
+                auto first = block * length / count;
+                auto last = (block + 1) * length / count;
+
+                auto elements = new ISA::EnumerationReference(enumType->values());
+                GC_LOCAL_REF(elements)
+                elements->reserve(last - first);
+                for ( auto i = first; i < last; i += 1 ) elements->append(values->get(i));
+
+                auto call = build(elements);
+                GC_LOCAL_REF(call)
+
+                auto job = vm->pushCall(call);
+                GC_LOCAL_REF(job)
+                jobs.push_back(job->id());
+            }
+
+            auto returns = vm->drain();
+            vm->exitQueueContext();
+
+            References results;
+            results.reserve(count);
+            for ( auto id : jobs ) {
+                auto result = returns.find(id);
+                if ( result == returns.end() || result->second == nullptr ) {
+                    for ( auto ref : results ) freeref(ref);
+                    throw Errors::RuntimeError(
+                        Errors::RuntimeExCode::ParallelJobFailed,
+                        "Job " + s(id) + " finished without returning a value"
+                    );
+                }
+
+                results.push_back(useref(result->second));
+            }
+
+            return results;
+        }
+
+        /**
+         * Reduce a non-empty enumeration by folding one contiguous block per worker (or per element,
+         * for short inputs) in a job each, then folding the partial results on the calling control.
+         * Returns the result with a reference held on it.
+         */
+        ISA::Reference* reduceInBlocks(VirtualMachine* vm, ISA::FunctionReference* map, ISA::FunctionReference* combine, ISA::EnumerationReference* values) {
+            auto blocks = std::min(values->length(), vm->workerCount());
+
+            auto fold = vm->loadProviderFunction(map == nullptr ? "REDUCE_BLOCK" : "MAP_REDUCE_BLOCK");
+            GC_LOCAL_REF(fold)
+
+            auto partials = foldBlocks(vm, values, blocks, [fold, map, combine](ISA::EnumerationReference* elements) -> IFunctionCall* {
+                if ( map == nullptr ) return fold->curryi(combine)->curryi(elements)->call();
+                return fold->curryi(map)->curryi(combine)->curryi(elements)->call();
+            });
+
+            auto enumType = values->type();
+            GC_LOCAL_REF(enumType)
+
+            auto combined = new ISA::EnumerationReference(enumType->values());
+            GC_LOCAL_REF(combined)
+            combined->reserve(partials.size());
+            for ( auto partial : partials ) {
+                combined->append(partial);
+                freeref(partial);
+            }
+
+            return foldInOrder(vm, nullptr, combine, combined);
+        }
+
+        Type::Lambda1* numberToNumberToNumber() {
+            auto numberT = Type::Primitive::of(Type::Intrinsic::NUMBER);
+            return Type::Lambda1::of(numberT, Type::Lambda1::of(numberT, numberT));
+        }
+    }
+
+    void ReduceFunctionCall::execute(VirtualMachine* vm) {
+        auto enumeration = (ISA::EnumerationReference*) _vector.at(0).second;
+        auto identity = _vector.at(1).second;
+        auto combine = (ISA::FunctionReference*) _vector.at(2).second;
+
+        if ( enumeration->length() < 1 ) {
+            setReturn(identity);
+            return;
+        }
+
+        auto result = reduceInBlocks(vm, nullptr, combine, enumeration);
+        setReturn(result);
+        freeref(result);
+    }
+
+    FormalTypes ReduceFunction::paramTypes() const {
+        return {
+            Type::Enumerable::of(Type::Primitive::of(Type::Intrinsic::NUMBER)),
+            Type::Primitive::of(Type::Intrinsic::NUMBER),
+            numberToNumberToNumber(),
+        };
+    }
+
+    Type::Type* ReduceFunction::returnType() const {
+        return Type::Primitive::of(Type::Intrinsic::NUMBER);
+    }
+
+    PrologueFunctionCall* ReduceFunction::call(CallVector vector) const {
+        return new ReduceFunctionCall(_provider, vector, returnType());
+    }
+
+
+    void MapReduceFunctionCall::execute(VirtualMachine* vm) {
+        auto enumeration = (ISA::EnumerationReference*) _vector.at(0).second;
+        auto identity = _vector.at(1).second;
+        auto map = (ISA::FunctionReference*) _vector.at(2).second;
+        auto combine = (ISA::FunctionReference*) _vector.at(3).second;
+
+        if ( enumeration->length() < 1 ) {
+            setReturn(identity);
+            return;
+        }
+
+        auto result = reduceInBlocks(vm, map, combine, enumeration);
+        setReturn(result);
+        freeref(result);
+    }
+
+    FormalTypes MapReduceFunction::paramTypes() const {
+        auto numberT = Type::Primitive::of(Type::Intrinsic::NUMBER);
+        return {
+            Type::Enumerable::of(numberT),
+            numberT,
+            Type::Lambda1::of(numberT, numberT),
+            numberToNumberToNumber(),
+        };
+    }
+
+    Type::Type* MapReduceFunction::returnType() const {
+        return Type::Primitive::of(Type::Intrinsic::NUMBER);
+    }
+
+    PrologueFunctionCall* MapReduceFunction::call(CallVector vector) const {
+        return new MapReduceFunctionCall(_provider, vector, returnType());
+    }
+
+
+    void ReduceBlockFunctionCall::execute(VirtualMachine* vm) {
+        std::size_t arg = 0;
+        auto map = _mapped ? (ISA::FunctionReference*) _vector.at(arg++).second : nullptr;
+        auto combine = (ISA::FunctionReference*) _vector.at(arg++).second;
+        auto elements = (ISA::EnumerationReference*) _vector.at(arg).second;
+
+        auto result = foldInOrder(vm, map, combine, elements);
+        setReturn(result);
+        freeref(result);
+    }
+
+    FormalTypes ReduceBlockFunction::paramTypes() const {
+        auto numberT = Type::Primitive::of(Type::Intrinsic::NUMBER);
+        FormalTypes types;
+        if ( _mapped ) types.push_back(Type::Lambda1::of(numberT, numberT));
+        types.push_back(numberToNumberToNumber());
+        types.push_back(Type::Enumerable::of(numberT));
+        return types;
+    }
+
+    Type::Type* ReduceBlockFunction::returnType() const {
+        return Type::Primitive::of(Type::Intrinsic::NUMBER);
+    }
+
+    PrologueFunctionCall* ReduceBlockFunction::call(CallVector vector) const {
+        return new ReduceBlockFunctionCall(_provider, vector, returnType(), _mapped);
+    }
+
+}
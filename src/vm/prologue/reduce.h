@@ -0,0 +1,120 @@
+#ifndef SWARMVM_REDUCE
+#define SWARMVM_REDUCE
+
+#include <utility>
+
+#include "prologue_provider.h"
+#include "../isa_meta.h"
+
+namespace swarmc::Runtime::Prologue {
+
+    /**
+     * Combine the elements of an enumeration without a shared accumulator. The elements
+     * are split into about two contiguous blocks per worker, each folded by one job on the
+     * queue, and the calling control folds the partial results. Inputs with no more
+     * elements than that are folded by the calling control directly. The combining function
+     * should be associative; the order of the elements is preserved. Empty enumerations
+     * reduce to the given identity. Typed over numbers, since prologue signatures have no
+     * generics.
+     */
+    class ReduceFunctionCall : public PrologueFunctionCall {
+    public:
+        ReduceFunctionCall(IProvider* provider, const CallVector& vector, Type::Type* returnType):
+            PrologueFunctionCall(provider, "REDUCE", vector, returnType) {}
+
+        void execute(VirtualMachine*) override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "ReduceFunctionCall<>";
+        }
+    };
+
+    class ReduceFunction : public PrologueFunction {
+    public:
+        explicit ReduceFunction(IProvider* provider) : PrologueFunction("REDUCE", provider) {}
+
+        [[nodiscard]] FormalTypes paramTypes() const override;
+
+        [[nodiscard]] Type::Type* returnType() const override;
+
+        [[nodiscard]] PrologueFunctionCall* call(CallVector) const override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "ReduceFunction<>";
+        }
+    };
+
+    /**
+     * Like REDUCE, but maps each element first. Each block's job maps and folds its own
+     * elements, so mapped values never go through the queue one at a time.
+     */
+    class MapReduceFunctionCall : public PrologueFunctionCall {
+    public:
+        MapReduceFunctionCall(IProvider* provider, const CallVector& vector, Type::Type* returnType):
+            PrologueFunctionCall(provider, "MAP_REDUCE", vector, returnType) {}
+
+        void execute(VirtualMachine*) override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "MapReduceFunctionCall<>";
+        }
+    };
+
+    class MapReduceFunction : public PrologueFunction {
+    public:
+        explicit MapReduceFunction(IProvider* provider) : PrologueFunction("MAP_REDUCE", provider) {}
+
+        [[nodiscard]] FormalTypes paramTypes() const override;
+
+        [[nodiscard]] Type::Type* returnType() const override;
+
+        [[nodiscard]] PrologueFunctionCall* call(CallVector) const override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "MapReduceFunction<>";
+        }
+    };
+
+
+    /**
+     * Folds one block of elements for REDUCE (or MAP_REDUCE, which also takes the map
+     * function first). Takes the combining function and the block, and returns the
+     * block's partial result. Pushed by the VM, not exposed to the language.
+     */
+    class ReduceBlockFunctionCall : public PrologueFunctionCall {
+    public:
+        ReduceBlockFunctionCall(IProvider* provider, const CallVector& vector, Type::Type* returnType, bool mapped):
+            PrologueFunctionCall(provider, mapped ? "MAP_REDUCE_BLOCK" : "REDUCE_BLOCK", vector, returnType), _mapped(mapped) {}
+
+        void execute(VirtualMachine*) override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "ReduceBlockFunctionCall<mapped: " + s(_mapped) + ">";
+        }
+
+    protected:
+        bool _mapped;
+    };
+
+    class ReduceBlockFunction : public PrologueFunction {
+    public:
+        ReduceBlockFunction(IProvider* provider, bool mapped):
+            PrologueFunction(mapped ? "MAP_REDUCE_BLOCK" : "REDUCE_BLOCK", provider), _mapped(mapped) {}
+
+        [[nodiscard]] FormalTypes paramTypes() const override;
+
+        [[nodiscard]] Type::Type* returnType() const override;
+
+        [[nodiscard]] PrologueFunctionCall* call(CallVector) const override;
+
+        [[nodiscard]] std::string toString() const override {
+            return "ReduceBlockFunction<mapped: " + s(_mapped) + ">";
+        }
+
+    protected:
+        bool _mapped;
+    };
+
+}
+
+#endif //SWARMVM_REDUCE
@@ -79,7 +79,7 @@ namespace swarmc::Runtime::Prologue {
         explicit VectorToStringFunction(IProvider* provider) : PrologueFunction("VECTOR_TO_STRING", provider) {}
 
         [[nodiscard]] FormalTypes paramTypes() const override {
-            return {new Type::Enumerable(Type::Primitive::of(Type::Intrinsic::NUMBER))};
+            return {Type::Enumerable::of(Type::Primitive::of(Type::Intrinsic::NUMBER))};
         }
 
         [[nodiscard]] Type::Type* returnType() const override {
@@ -110,7 +110,7 @@ namespace swarmc::Runtime::Prologue {
         explicit MatrixToStringFunction(IProvider* provider) : PrologueFunction("MATRIX_TO_STRING", provider) {}
 
         [[nodiscard]] FormalTypes paramTypes() const override {
-            return {new Type::Enumerable(new Type::Enumerable(Type::Primitive::of(Type::Intrinsic::NUMBER)))};
+            return {Type::Enumerable::of(Type::Enumerable::of(Type::Primitive::of(Type::Intrinsic::NUMBER)))};
         }
 
         [[nodiscard]] Type::Type* returnType() const override {
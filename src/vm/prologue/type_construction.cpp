@@ -6,7 +6,7 @@ namespace swarmc::Runtime::Prologue {
 
     void Lambda0FunctionCall::execute(VirtualMachine*) {
         auto opd = (ISA::TypeReference*) _vector.at(0).second;
-        setReturn(new ISA::TypeReference(new Type::Lambda0(opd->value())));
+        setReturn(new ISA::TypeReference(Type::Lambda0::of(opd->value())));
     }
 
     FormalTypes Lambda0Function::paramTypes() const {
@@ -25,7 +25,7 @@ namespace swarmc::Runtime::Prologue {
     void Lambda1FunctionCall::execute(VirtualMachine*) {
         auto arg = (ISA::TypeReference*) _vector.at(0).second;
         auto ret = (ISA::TypeReference*) _vector.at(1).second;
-        setReturn(new ISA::TypeReference(new Type::Lambda1(arg->value(), ret->value())));
+        setReturn(new ISA::TypeReference(Type::Lambda1::of(arg->value(), ret->value())));
     }
 
     FormalTypes Lambda1Function::paramTypes() const {
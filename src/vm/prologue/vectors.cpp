@@ -30,7 +30,7 @@ namespace swarmc::Runtime::Prologue {
         auto nRows = (ISA::NumberReference*) _vector.at(0).second;
         auto nCols = (ISA::NumberReference*) _vector.at(1).second;
 
-        auto enumOfNumsType = new Type::Enumerable(Type::Primitive::of(Type::Intrinsic::NUMBER));
+        auto enumOfNumsType = Type::Enumerable::of(Type::Primitive::of(Type::Intrinsic::NUMBER));
         auto matrix = new ISA::EnumerationReference(enumOfNumsType);
         auto zero = new ISA::NumberReference(0);
         matrix->reserve(static_cast<std::size_t>(nRows->value()));
@@ -99,7 +99,7 @@ namespace swarmc::Runtime::Prologue {
             actualXs = matrix->length() - x0;
         }
 
-        auto sliced = new ISA::EnumerationReference(new Type::Enumerable(Type::Primitive::of(Type::Intrinsic::NUMBER)));
+        auto sliced = new ISA::EnumerationReference(Type::Enumerable::of(Type::Primitive::of(Type::Intrinsic::NUMBER)));
         sliced->reserve(actualXs);
 
         for ( std::size_t x = 0; x < actualXs; x += 1 ) {
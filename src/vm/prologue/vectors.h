@@ -27,7 +27,7 @@ namespace swarmc::Runtime::Prologue {
         }
 
         [[nodiscard]] Type::Type* returnType() const override {
-            return new Type::Enumerable(Type::Primitive::of(Type::Intrinsic::NUMBER));
+            return Type::Enumerable::of(Type::Primitive::of(Type::Intrinsic::NUMBER));
         }
 
         [[nodiscard]] PrologueFunctionCall* call(CallVector) const override;
@@ -59,7 +59,7 @@ namespace swarmc::Runtime::Prologue {
         }
 
         [[nodiscard]] Type::Type* returnType() const override {
-            return new Type::Enumerable(new Type::Enumerable(Type::Primitive::of(Type::Intrinsic::NUMBER)));
+            return Type::Enumerable::of(Type::Enumerable::of(Type::Primitive::of(Type::Intrinsic::NUMBER)));
         }
 
         [[nodiscard]] PrologueFunctionCall* call(CallVector) const override;
@@ -89,12 +89,12 @@ namespace swarmc::Runtime::Prologue {
             return {
                 Type::Primitive::of(Type::Intrinsic::NUMBER),  // startAt
                 Type::Primitive::of(Type::Intrinsic::NUMBER),  // length
-                new Type::Enumerable(Type::Primitive::of(Type::Intrinsic::NUMBER)),  // vector
+                Type::Enumerable::of(Type::Primitive::of(Type::Intrinsic::NUMBER)),  // vector
             };
         }
 
         [[nodiscard]] Type::Type* returnType() const override {
-            return new Type::Enumerable(Type::Primitive::of(Type::Intrinsic::NUMBER));
+            return Type::Enumerable::of(Type::Primitive::of(Type::Intrinsic::NUMBER));
         }
 
         [[nodiscard]] PrologueFunctionCall* call(CallVector) const override;
@@ -126,12 +126,12 @@ namespace swarmc::Runtime::Prologue {
                 Type::Primitive::of(Type::Intrinsic::NUMBER),  // x1
                 Type::Primitive::of(Type::Intrinsic::NUMBER),  // y0
                 Type::Primitive::of(Type::Intrinsic::NUMBER),  // y1
-                new Type::Enumerable(new Type::Enumerable(Type::Primitive::of(Type::Intrinsic::NUMBER))),  // matrix
+                Type::Enumerable::of(Type::Enumerable::of(Type::Primitive::of(Type::Intrinsic::NUMBER))),  // matrix
             };
         }
 
         [[nodiscard]] Type::Type* returnType() const override {
-            return new Type::Enumerable(new Type::Enumerable(Type::Primitive::of(Type::Intrinsic::NUMBER)));
+            return Type::Enumerable::of(Type::Enumerable::of(Type::Primitive::of(Type::Intrinsic::NUMBER)));
         }
 
         [[nodiscard]] PrologueFunctionCall* call(CallVector) const override;
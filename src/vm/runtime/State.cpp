@@ -3,37 +3,62 @@
 #include "../../shared/nslib.h"
 #include "../../errors/SwarmError.h"
 #include "State.h"
+#include "../walk/SharedLocationsWalk.h"
 
 namespace swarmc::Runtime {
 
+    std::atomic<ScopeId> ScopeFrame::_nextId = 0;
+
+    const ScopeOrigin& ScopeFrame::localOrigin() {
+        static const ScopeOrigin origin = std::make_shared<const std::string>(nslib::uuid());
+        return origin;
+    }
+
     void ScopeFrame::shadow(ISA::LocationReference* ref) {
-        auto name = ref->name() + "@" + _id;
-        if ( _map.find(ISA::LocationReference::affinityString(ref->affinity()) + ":" + name) != _map.end() ) {
+        assert(!isShared());
+        auto& entry = _map[ref->slot()];
+        if ( entry.location != nullptr ) {
             throw Errors::SwarmError("Attempted to shadow reference in a scope where it was already shadowed: " + ref->toString());
         }
 
-        _map[ISA::LocationReference::affinityString(ref->affinity()) + ":" + name] = useref(new ISA::LocationReference(ref->affinity(), name));
+        entry.nominal = useref(ref);
+        entry.location = useref(ref->shadowedAs(*_origin + ":" + std::to_string(_id)));
     }
 
     ISA::LocationReference* ScopeFrame::map(ISA::LocationReference* ref) const {
-        auto name = ISA::LocationReference::affinityString(ref->affinity()) + ":" + ref->name() + "@" + _id;
-        if ( _map.find(name) != _map.end() ) {
-            return _map.at(name);
+        auto slot = ref->slot();
+        if ( auto entry = _map.find(slot) ) {
+            return entry->location;
+        }
+
+        if ( auto cached = _resolved.find(slot) ) {
+            return *cached == nullptr ? ref : *cached;
         }
 
+        ISA::LocationReference* resolved = nullptr;
         if ( _parent != nullptr ) {
-            return _parent->map(ref);
+            auto parentLoc = _parent->map(ref);
+            if ( parentLoc != ref ) resolved = parentLoc;
         }
 
-        return ref;
+        if ( !isShared() ) _resolved[slot] = resolved;
+        return resolved == nullptr ? ref : resolved;
+    }
+
+    std::map<std::string, ISA::LocationReference*> ScopeFrame::nameMap() const {
+        std::map<std::string, ISA::LocationReference*> names;
+        _map.forEach([&names](std::size_t, const Shadow& e) {
+            names[e.nominal->fqName()] = e.location;
+        });
+        return names;
     }
 
     ScopeFrame* ScopeFrame::newChild() {
-        return new ScopeFrame(_global, nslib::uuid(), this);
+        return new ScopeFrame(_global, nextId(), this);
     }
 
     ScopeFrame* ScopeFrame::newCall(IFunctionCall* call) {
-        return new ScopeFrame(_global, nslib::uuid(), this, call);
+        return new ScopeFrame(_global, nextId(), this, call);
     }
 
     ScopeFrame* ScopeFrame::overrideCall(IFunctionCall* fc) const {
@@ -43,10 +68,10 @@ namespace swarmc::Runtime {
     }
 
     std::string ScopeFrame::toString() const {
-        return "ScopeFrame<id: " + _id + ", #symbols: " + std::to_string(_map.size()) + ">";
+        return "ScopeFrame<id: " + *_origin + ":" + std::to_string(_id) + ", #symbols: " + std::to_string(_map.size()) + ">";
     }
 
-    void State::extractMetadata() {
+    void Program::extractMetadata() {
         std::size_t pc = 0;
         _is.erase(std::remove_if(_is.begin(), _is.end(), [&pc, this](ISA::Instruction* i) {
             pc += 1;
@@ -60,7 +85,7 @@ namespace swarmc::Runtime {
         }), _is.end());
     }
 
-    void State::annotate()  {
+    void Program::annotate() {
         std::stack<std::string> nesting;
         for ( auto it = _is.begin(); it != _is.end(); ++it ) {
             auto i = *it;
@@ -87,12 +112,199 @@ namespace swarmc::Runtime {
         }
     }
 
+    const std::vector<ISA::LocationReference*> State::_noSharedLocations;
+
+    std::mutex Program::_loadedMutex;
+    std::unordered_map<std::string, Program*>* Program::_loaded = nullptr;
+
+    std::string Program::imageHash() const {
+        std::unique_lock<std::mutex> lock(_loadedMutex);
+        return _imageHash;
+    }
+
+    void Program::remember(const std::string& hash) {
+        std::unique_lock<std::mutex> lock(_loadedMutex);
+        if ( _loaded == nullptr ) {
+            _loaded = new std::unordered_map<std::string, Program*>;
+            Framework::onShutdown([]() {
+                std::unique_lock<std::mutex> lock(_loadedMutex);
+                for ( const auto& pair : *_loaded ) freeref(pair.second);
+                delete _loaded;
+                _loaded = nullptr;
+            });
+        }
+
+        _imageHash = hash;
+        if ( _loaded->find(hash) == _loaded->end() ) {
+            _loaded->emplace(hash, useref(this));
+        }
+    }
+
+    Program* Program::loaded(const std::string& hash) {
+        std::unique_lock<std::mutex> lock(_loadedMutex);
+        if ( _loaded == nullptr ) return nullptr;
+
+        auto iter = _loaded->find(hash);
+        if ( iter == _loaded->end() ) return nullptr;
+        return iter->second;
+    }
+
+    void Program::analyzeSharedLocations() {
+        ISA::SharedLocationsWalk walk;
+        _sharedLocations.clear();
+        _sharedLocations.reserve(_is.size());
+        for ( auto i : _is ) {
+            _sharedLocations.push_back(walk.walkLockSet(i));
+        }
+    }
+
+    void Program::analyzeAtomicUpdates() {
+        _atomicUpdates.clear();
+        for ( pc_t pc = 0; pc < _is.size(); pc += 1 ) {
+            if ( _is[pc]->tag() != ISA::Tag::LOCK ) continue;
+            if ( auto update = matchAtomicUpdate(pc) ) {
+                _atomicUpdates.emplace(pc, std::move(*update));
+            }
+        }
+    }
+
+    /** Returns true if the instruction only computes a value from its operands (so it can be executed early). */
+    static bool isPureEval(ISA::Instruction* inst) {
+        switch ( inst->tag() ) {
+            case ISA::Tag::EQUAL: case ISA::Tag::COMPATIBLE:
+            case ISA::Tag::AND: case ISA::Tag::OR: case ISA::Tag::XOR:
+            case ISA::Tag::NAND: case ISA::Tag::NOR: case ISA::Tag::NOT:
+            case ISA::Tag::MAPGET: case ISA::Tag::MAPLENGTH:
+            case ISA::Tag::ENUMLENGTH: case ISA::Tag::ENUMGET:
+            case ISA::Tag::STRCONCAT: case ISA::Tag::STRLENGTH:
+            case ISA::Tag::STRSLICEFROM: case ISA::Tag::STRSLICEFROMTO:
+            case ISA::Tag::PLUS: case ISA::Tag::MINUS: case ISA::Tag::TIMES: case ISA::Tag::DIVIDE:
+            case ISA::Tag::POWER: case ISA::Tag::MOD: case ISA::Tag::NEG:
+            case ISA::Tag::GT: case ISA::Tag::GTE: case ISA::Tag::LT: case ISA::Tag::LTE:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    std::optional<AtomicUpdate> Program::matchAtomicUpdate(pc_t pc) const {
+        auto loc = ((ISA::Lock*) _is[pc])->first();
+        if ( loc->affinity() != ISA::Affinity::SHARED ) return std::nullopt;
+
+        auto isLoc = [loc](const ISA::Reference* ref) {
+            return ref->tag() == ISA::ReferenceTag::LOCATION && ((ISA::LocationReference*) ref)->is(loc);
+        };
+
+        // Recognize: self-assignments of the location (from the compiler loading it), instructions
+        // which don't touch it, a single update of it, and (for arithmetic) the store of the result.
+        AtomicUpdate update{};
+        update.location = loc;
+        bool modified = false;
+        bool stored = false;
+
+        for ( pc_t i = pc + 1; i < _is.size(); i += 1 ) {
+            auto inst = _is[i];
+            auto tag = inst->tag();
+
+            if ( tag == ISA::Tag::UNLOCK ) {
+                if ( !isLoc(((ISA::Unlock*) inst)->first()) ) return std::nullopt;
+                if ( !modified || (update.result != nullptr && !stored) ) return std::nullopt;
+                update.unlock = i;
+                return update;
+            }
+
+            if ( tag == ISA::Tag::ASSIGNVALUE ) {
+                auto assign = (ISA::AssignValue*) inst;
+                if ( isLoc(assign->first()) && isLoc(assign->second()) && !modified ) continue;
+
+                if ( isLoc(assign->first()) && modified && !stored && update.result != nullptr
+                     && assign->second()->tag() == ISA::ReferenceTag::LOCATION
+                     && ((ISA::LocationReference*) assign->second())->is(update.result) ) {
+                    stored = true;
+                    continue;
+                }
+            }
+
+            // Everything else in the section must use only this location, exactly once
+            if ( !modified ) {
+                auto& shared = _sharedLocations[i];
+                if ( shared.size() == 1 && shared[0]->is(loc) ) {
+                    if ( tag == ISA::Tag::ENUMAPPEND ) {
+                        auto append = (ISA::EnumAppend*) inst;
+                        if ( !isLoc(append->second()) || isLoc(append->first()) ) return std::nullopt;
+                        update.op = AtomicOp::ENUM_APPEND;
+                        update.operand = append->first();
+                        modified = true;
+                        continue;
+                    }
+
+                    if ( tag == ISA::Tag::MAPSET ) {
+                        auto set = (ISA::MapSet*) inst;
+                        if ( !isLoc(set->third()) || isLoc(set->first()) || isLoc(set->second()) ) return std::nullopt;
+                        update.op = AtomicOp::MAP_SET;
+                        update.key = set->first();
+                        update.operand = set->second();
+                        modified = true;
+                        continue;
+                    }
+
+                    if ( tag != ISA::Tag::ASSIGNEVAL ) return std::nullopt;
+                    auto assign = (ISA::AssignEval*) inst;
+                    if ( assign->first()->affinity() != ISA::Affinity::LOCAL ) return std::nullopt;
+
+                    auto eval = assign->second();
+                    auto evalTag = eval->tag();
+                    if ( evalTag != ISA::Tag::PLUS && evalTag != ISA::Tag::MINUS
+                         && evalTag != ISA::Tag::TIMES && evalTag != ISA::Tag::DIVIDE ) return std::nullopt;
+
+                    auto arith = (ISA::BinaryReferenceInstruction*) eval;
+                    auto commutes = evalTag == ISA::Tag::PLUS || evalTag == ISA::Tag::TIMES;
+                    if ( isLoc(arith->first()) && !isLoc(arith->second()) ) update.operand = arith->second();
+                    else if ( commutes && isLoc(arith->second()) && !isLoc(arith->first()) ) update.operand = arith->first();
+                    else return std::nullopt;
+
+                    if ( evalTag == ISA::Tag::PLUS ) update.op = AtomicOp::ADD;
+                    else if ( evalTag == ISA::Tag::MINUS ) update.op = AtomicOp::SUBTRACT;
+                    else if ( evalTag == ISA::Tag::TIMES ) update.op = AtomicOp::MULTIPLY;
+                    else update.op = AtomicOp::DIVIDE;
+
+                    update.result = assign->first();
+                    modified = true;
+                    continue;
+                }
+
+                // Instructions computing the operand must be side-effect free and write only locals
+                if ( shared.empty() && tag == ISA::Tag::POSITION ) {
+                    update.prelude.push_back(inst);
+                    continue;
+                }
+
+                if ( shared.empty() && tag == ISA::Tag::ASSIGNVALUE
+                     && ((ISA::AssignValue*) inst)->first()->affinity() == ISA::Affinity::LOCAL ) {
+                    update.prelude.push_back(inst);
+                    continue;
+                }
+
+                if ( shared.empty() && tag == ISA::Tag::ASSIGNEVAL
+                     && ((ISA::AssignEval*) inst)->first()->affinity() == ISA::Affinity::LOCAL
+                     && isPureEval(((ISA::AssignEval*) inst)->second()) ) {
+                    update.prelude.push_back(inst);
+                    continue;
+                }
+            }
+
+            return std::nullopt;
+        }
+
+        return std::nullopt;
+    }
+
     std::vector<ISA::FunctionParam*> State::loadInlineFunctionParams(ISA::Instructions::size_type pc) const {
-        assert(pc < _is.size() && _is[pc]->tag() == ISA::Tag::BEGINFN);
+        assert(pc < _program->_is.size() && _program->_is[pc]->tag() == ISA::Tag::BEGINFN);
 
         std::vector<ISA::FunctionParam*> ps;
-        for ( ISA::Instructions::size_type i = pc+1; i < _is.size(); i += 1 ) {
-            auto inst = _is[i];
+        for ( ISA::Instructions::size_type i = pc+1; i < _program->_is.size(); i += 1 ) {
+            auto inst = _program->_is[i];
             // fnparam instructions must be the first instructions after the beginfn
             if ( inst->tag() != ISA::Tag::FNPARAM ) break;
             ps.push_back((ISA::FunctionParam*) inst);
@@ -102,7 +314,7 @@ namespace swarmc::Runtime {
     }
 
     ISA::BeginFunction* State::getInlineFunctionHeader(ISA::Instructions::size_type pc) const {
-        assert(pc < _is.size() && _is[pc]->tag() == ISA::Tag::BEGINFN);
-        return (ISA::BeginFunction*) _is[pc];
+        assert(pc < _program->_is.size() && _program->_is[pc]->tag() == ISA::Tag::BEGINFN);
+        return (ISA::BeginFunction*) _program->_is[pc];
     }
 }
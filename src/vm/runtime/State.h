@@ -5,11 +5,18 @@
 #include <stack>
 #include <utility>
 #include <optional>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
 #include "../../shared/nslib.h"
 #include "../../errors/SwarmError.h"
 #include "../../errors/EmptyCallStackError.h"
 #include "../isa_meta.h"
 #include "../debug/Metadata.h"
+#include "slot_map.h"
+#include "interfaces.h"
 
 
 
@@ -24,6 +31,10 @@ namespace swarmc::Runtime {
     class IFunction;
 
     using pc_t = ISA::Instructions::size_type;
+    using ScopeId = std::uint64_t;
+
+    /** Globally unique ID of the process which created a scope. Shared by every frame from that process. */
+    using ScopeOrigin = std::shared_ptr<const std::string>;
 //    using CallStackFrame = std::pair<pc_t, ISA::Instruction*>;
 //    using CallStack = std::stack<CallStackFrame>;
     using ExceptionHandlerId = std::string;
@@ -55,23 +66,37 @@ namespace swarmc::Runtime {
      */
     class ScopeFrame : public IStringable, public serial::ISerializable, public IRefCountable {
     public:
-        ScopeFrame(IGlobalServices* global, std::string id, ScopeFrame* parent) : IRefCountable(), _parent(useref(parent)), _global(useref(global)) {
-            _id = std::move(id);
-        }
-        ScopeFrame(IGlobalServices* global, std::string id, ScopeFrame* parent, IFunctionCall* call) : IRefCountable(), _parent(useref(parent)), _call(useref(call)), _global(useref(global)) {
-            _id = std::move(id);
-        }
+        ScopeFrame(IGlobalServices* global, ScopeId id, ScopeFrame* parent) : IRefCountable(), _parent(useref(parent)), _id(id), _global(useref(global)) {}
+        ScopeFrame(IGlobalServices* global, ScopeId id, ScopeFrame* parent, IFunctionCall* call) : IRefCountable(), _parent(useref(parent)), _id(id), _call(useref(call)), _global(useref(global)) {}
         ~ScopeFrame() override {
             freeref(_global);
             freeref(_parent);
             freeref(_call);
-            for ( const auto& e : _map ) freeref(e.second);
+            _map.forEach([](std::size_t, const Shadow& e) {
+                freeref(e.nominal);
+                freeref(e.location);
+            });
+        }
+
+        /**
+         * Generate a new scope ID. IDs are only sequential within a process, so they are paired
+         * with the frame's origin wherever they must be unique across nodes (e.g. shadow names).
+         */
+        static ScopeId nextId() {
+            return _nextId.fetch_add(1, std::memory_order_relaxed);
         }
 
+        /** The origin of scopes created by this process. */
+        static const ScopeOrigin& localOrigin();
+
         [[nodiscard]] serial::tag_t getSerialKey() const override {
             return "swarm::Runtime::ScopeFrame";
         }
 
+        [[nodiscard]] serial::index_t getSerialIndex() const override {
+            return 0;
+        }
+
         /** Make this instance the parent scope of the given location. */
         void shadow(ISA::LocationReference*);
 
@@ -98,16 +123,26 @@ namespace swarmc::Runtime {
 
         [[nodiscard]] std::string toString() const override;
 
-        /** Create a deep copy of this scope. */
+        /**
+         * Create a copy of this scope. The copy shares this scope's parents instead of
+         * duplicating them, so they are marked shared and must not be modified afterward.
+         */
         [[nodiscard]] ScopeFrame* copy() const {
-            auto copy = new ScopeFrame(_global, _id, _parent == nullptr ? nullptr : _parent->copy());
+            if ( _parent != nullptr ) _parent->markShared();
+
+            auto copy = new ScopeFrame(_global, _id, _parent);
+            copy->_origin = _origin;
             copy->_call = _call == nullptr ? nullptr : useref(_call);
             copy->_returnTo = _returnTo;
             copy->_isExceptionFrame = _isExceptionFrame;
             copy->_shouldCaptureReturn = _shouldCaptureReturn;
             copy->_return = _return == nullptr ? nullptr : useref(_return);
             copy->_map = _map;
-            for ( const auto& e : copy->_map ) useref(e.second);
+            copy->_map.forEach([](std::size_t, const Shadow& e) {
+                useref(e.nominal);
+                useref(e.location);
+            });
+            copy->_resolved = _resolved;
 
             copy->_handlers = _handlers;
             stl::stackLoop<ExceptionHandler>(_handlers, [](ExceptionHandler e) { useref(unpackExceptionHandler(std::move(e))); });
@@ -115,6 +150,14 @@ namespace swarmc::Runtime {
             return copy;
         }
 
+        /**
+         * Returns true if this scope may be visible to more than one VM (i.e. it is the parent of a copied scope).
+         * Shared scopes are immutable. To modify one, make a `copy()` and use that instead.
+         */
+        [[nodiscard]] bool isShared() const {
+            return _shared.load(std::memory_order_acquire);
+        }
+
         ExceptionHandlerId pushExceptionHandler(IFunction* selector, IFunction* handler) {
             auto id = getNextHandlerId();
             _handlers.emplace(id, std::make_pair(std::nullopt, useref(selector)), useref(handler));
@@ -194,13 +237,32 @@ namespace swarmc::Runtime {
             return _shouldCaptureReturn;
         }
 
-        [[nodiscard]] std::string id() const { return _id; }
+        [[nodiscard]] ScopeId id() const { return _id; }
+
+        [[nodiscard]] const std::string& origin() const { return *_origin; }
 
-        [[nodiscard]] std::map<std::string, ISA::LocationReference*> nameMap() const { return _map; }
+        /** Get the shadowed locations in this frame, keyed by the fully-qualified name of the location they shadow. */
+        [[nodiscard]] std::map<std::string, ISA::LocationReference*> nameMap() const;
     protected:
+        /** A location shadowed in this frame, along with the nominal location it shadows. */
+        struct Shadow {
+            ISA::LocationReference* nominal = nullptr;
+            ISA::LocationReference* location = nullptr;
+        };
+
         ScopeFrame* _parent = nullptr;
-        std::map<std::string, ISA::LocationReference*> _map;
-        std::string _id;
+        SlotMap<Shadow> _map;  // nominal slot -> shadow
+
+        /**
+         * Cache of locations this frame resolved through its parents (nullptr if unshadowed).
+         * Frames only gain shadows while they are the innermost scope, so a descendant's
+         * cached resolution can't be invalidated while it is still executing.
+         * Not written once the frame is shared, since other threads may be reading it.
+         */
+        mutable SlotMap<ISA::LocationReference*> _resolved;
+
+        ScopeId _id;
+        ScopeOrigin _origin = localOrigin();
         IFunctionCall* _call = nullptr;
         IFunctionCall* _return = nullptr;
         ExceptionHandlers _handlers;
@@ -213,6 +275,107 @@ namespace swarmc::Runtime {
             return _global->getUuid();
         }
 
+        /** Mark this scope and its parents as shared. */
+        void markShared() const {
+            for ( auto frame = this; frame != nullptr && !frame->isShared(); frame = frame->_parent ) {
+                frame->_shared.store(true, std::memory_order_release);
+            }
+        }
+
+        mutable std::atomic<bool> _shared = false;
+
+        static std::atomic<ScopeId> _nextId;
+
+        friend class Wire;
+    };
+
+
+    /**
+     * A critical section which the program uses only to read-modify-write a single shared location.
+     * e.g. `s:x += e` compiles to `lock s:x`, `s:x <- s:x`, the instructions computing `e`,
+     * `l:t <- plus s:x e`, `s:x <- l:t`, `unlock s:x`. Stores which support atomic updates
+     * can apply these without the VM taking the lock. See Program::analyzeAtomicUpdates.
+     */
+    struct AtomicUpdate {
+        AtomicOp op;
+        ISA::LocationReference* location;  // the shared location being updated
+        ISA::Reference* operand;  // the right-hand number, or the value being appended/set
+        ISA::Reference* key = nullptr;  // the key, for MAP_SET
+        ISA::LocationReference* result = nullptr;  // receives the new value, for arithmetic ops
+        std::vector<ISA::Instruction*> prelude;  // the section's instructions which don't use the location
+        pc_t unlock = 0;  // position of the closing `unlock`
+    };
+
+    /**
+     * The loaded form of an SVI program: the instructions along with the tables derived
+     * from them when it is loaded. A Program is immutable once loaded, so every State
+     * forked from the same program shares a single instance.
+     */
+    class Program : public IRefCountable, public serial::ISerializable {
+    public:
+        ~Program() override {
+            for ( auto e : _is ) freeref(e);
+        }
+
+        [[nodiscard]] serial::tag_t getSerialKey() const override {
+            return "swarm::Runtime::Program";
+        }
+
+        /**
+         * Get the content hash this program's image was published under, or an empty
+         * string if it hasn't been. States of a published program serialize the hash
+         * instead of the full instruction list.
+         */
+        [[nodiscard]] std::string imageHash() const;
+
+        /** Register this program as loaded in this process under the given image hash. */
+        void remember(const std::string& hash);
+
+        /** Get the program loaded in this process with the given image hash, or nullptr if there isn't one. */
+        static Program* loaded(const std::string& hash);
+
+    protected:
+        Program(ISA::Instructions is, bool shouldInitialize) : _is(std::move(is)) {
+            for ( auto e : _is ) useref(e);
+            if ( shouldInitialize ) initialize();
+            else {
+                analyzeSharedLocations();
+                analyzeAtomicUpdates();
+            }
+        }
+
+        ISA::Instructions _is;
+        std::map<std::string, pc_t> _fJumps;
+        std::map<std::string, pc_t> _fSkips;
+        Debug::Metadata _meta;
+
+        /** Per-PC lock sets, parallel to `_is`. */
+        std::vector<std::vector<ISA::LocationReference*>> _sharedLocations;
+
+        /** Critical sections which can be applied as atomic updates, keyed by the position of their `lock`. */
+        std::unordered_map<pc_t, AtomicUpdate> _atomicUpdates;
+
+        void initialize() {
+            extractMetadata();
+            annotate();
+            analyzeSharedLocations();
+            analyzeAtomicUpdates();
+        }
+
+        void extractMetadata();
+        void annotate();
+        void analyzeSharedLocations();
+        void analyzeAtomicUpdates();
+
+        /** Try to recognize the critical section starting at `pc` as an atomic update. */
+        std::optional<AtomicUpdate> matchAtomicUpdate(pc_t pc) const;
+
+        std::string _imageHash;
+
+        static std::mutex _loadedMutex;
+        static std::unordered_map<std::string, Program*>* _loaded;
+
+        friend class State;
         friend class Wire;
     };
 
@@ -228,7 +391,7 @@ namespace swarmc::Runtime {
         explicit State(ISA::Instructions is) : State(std::move(is), true) {}
 
         ~State() override {
-            for ( auto e : _is ) freeref(e);
+            freeref(_program);
         }
 
         [[nodiscard]] serial::tag_t getSerialKey() const override {
@@ -237,20 +400,38 @@ namespace swarmc::Runtime {
 
         /** Get the current instruction. */
         ISA::Instruction* current() {
-            if ( _rewindToHead && !_is.empty() ) return _is[0];
-            if ( _pc >= _is.size() ) return nullptr;
-            return _is[_pc];
+            if ( _rewindToHead && !_program->_is.empty() ) return _program->_is[0];
+            if ( _pc >= _program->_is.size() ) return nullptr;
+            return _program->_is[_pc];
+        }
+
+        /**
+         * Get the shared locations which must be locked to execute the current instruction,
+         * in canonical lock order. These are computed once when the program is loaded.
+         */
+        [[nodiscard]] const std::vector<ISA::LocationReference*>& currentSharedLocations() const {
+            if ( _rewindToHead && !_program->_sharedLocations.empty() ) return _program->_sharedLocations[0];
+            if ( _pc >= _program->_sharedLocations.size() ) return _noSharedLocations;
+            return _program->_sharedLocations[_pc];
+        }
+
+        /** Get the atomic update beginning at the current instruction, or nullptr if it doesn't begin one. */
+        [[nodiscard]] const AtomicUpdate* currentAtomicUpdate() const {
+            if ( _rewindToHead ) return nullptr;
+            auto iter = _program->_atomicUpdates.find(_pc);
+            if ( iter == _program->_atomicUpdates.end() ) return nullptr;
+            return &iter->second;
         }
 
         /** Look up a specific instruction. */
         ISA::Instruction* lookup(pc_t pc) {
-            if ( pc < _is.size() ) return _is[pc];
+            if ( pc < _program->_is.size() ) return _program->_is[pc];
             return nullptr;
         }
 
         /** Returns true if there are no more instructions to be executed. */
         [[nodiscard]] bool isEndOfProgram() const {
-            return _pc >= _is.size();
+            return _pc >= _program->_is.size();
         }
 
         /** Advance the position of the program to the next instruction. */
@@ -285,12 +466,12 @@ namespace swarmc::Runtime {
 
         /** Jump to the end of the program. */
         void jumpEnd() {
-            _pc = _is.size();
+            _pc = _program->_is.size();
         }
 
         /** Jump to a specific position in the program. */
         void jump(pc_t i) {
-            if ( i >= _is.size() ) throw Errors::SwarmError("Cannot advance beyond end of program.");
+            if ( i >= _program->_is.size() ) throw Errors::SwarmError("Cannot advance beyond end of program.");
             _pc = i;
         }
 
@@ -317,8 +498,16 @@ namespace swarmc::Runtime {
                 //
                 // Inherited call -- before: PC = 123, stack = (scope A, returnTo: nullptr) :: (scope B, returnTo 28) :: (scope C, nullptr)
                 //                   after: PC = 28, stack = (scope C, nullptr)
-                if ( returnTo != std::nullopt && returnTo != _is.size() ) {
+                if ( returnTo != std::nullopt && returnTo != _program->_is.size() ) {
                     jump(*returnTo);
+
+                    // Don't modify a frame that a forked VM can still see
+                    if ( current->isShared() ) {
+                        auto owned = useref(current->copy());
+                        freeref(current);
+                        current = owned;
+                    }
+
                     current->clearReturnPC();
                     releaseref(current);
                     return current;
@@ -343,14 +532,16 @@ namespace swarmc::Runtime {
 
         /** Get the position of the inline function with the given name. */
         pc_t getInlineFunctionPC(const std::string& name) {
-            if ( _fJumps.find(name) == _fJumps.end() ) throw Errors::SwarmError("Unable to find pc for inline function f:" + name);
-            return _fJumps[name];
+            auto iter = _program->_fJumps.find(name);
+            if ( iter == _program->_fJumps.end() ) throw Errors::SwarmError("Unable to find pc for inline function f:" + name);
+            return iter->second;
         }
 
         /** Get the position of the first instruction after the inline function with the given name. */
         pc_t getInlineFunctionSkipPC(const std::string& name) {
-            if ( _fSkips.find(name) == _fJumps.end() ) throw Errors::SwarmError("Unable to find pc to skip inline function f:" + name);
-            return _fSkips[name];
+            auto iter = _program->_fSkips.find(name);
+            if ( iter == _program->_fSkips.end() ) throw Errors::SwarmError("Unable to find pc to skip inline function f:" + name);
+            return iter->second;
         }
 
         /** Get the `beginfn` instruction for the function at the given position. */
@@ -358,48 +549,39 @@ namespace swarmc::Runtime {
 
         /** Returns true if the loaded program has an inline function with the given name. */
         bool hasInlineFunction(const std::string& name) {
-            return _fJumps.find(name) != _fJumps.end();
+            return _program->_fJumps.find(name) != _program->_fJumps.end();
         }
 
         [[nodiscard]] std::string toString() const override {
             return "Runtime::State<>";
         }
 
-        /** Create a deep copy of this state object. */
+        /** Create a copy of this state object. The copy shares the loaded program, so this is O(1). */
         [[nodiscard]] State* copy() const {
-            auto copy = new State(_is);
+            auto copy = new State(_program);
             copy->_pc = _pc;
+            copy->_rewindToHead = _rewindToHead;
             return copy;
         }
 
         [[nodiscard]] Debug::Metadata getMetadata() const {
-            return _meta;
-        }
-    protected:
-        State(ISA::Instructions is, bool shouldInitialize) : _is(std::move(is)) {
-            for ( auto e : _is ) useref(e);
-            if ( shouldInitialize ) initialize();
+            return _program->_meta;
         }
 
-        static State* withoutInitialization(ISA::Instructions is) {
-            return new State(std::move(is), false);
+        /** Get the loaded program this state is executing. */
+        [[nodiscard]] Program* program() const {
+            return _program;
         }
+    protected:
+        State(ISA::Instructions is, bool shouldInitialize) : State(new Program(std::move(is), shouldInitialize)) {}
 
-        ISA::Instructions _is;
-        std::map<std::string, pc_t> _fJumps;
-        std::map<std::string, pc_t> _fSkips;
+        explicit State(Program* program) : _program(useref(program)) {}
+
+        Program* _program;
         pc_t _pc = 0;
-        Debug::Metadata _meta;
         bool _rewindToHead = false;
 
-        void initialize() {
-            _pc = 0;
-            extractMetadata();
-            annotate();
-        }
-
-        void extractMetadata();
-        void annotate();
+        static const std::vector<ISA::LocationReference*> _noSharedLocations;
 
         friend class Wire;
     };
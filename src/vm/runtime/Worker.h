@@ -12,8 +12,7 @@ namespace swarmc::Runtime {
     
         void wait() {
             while ( !Configuration::THREAD_EXIT ) {
-                _queue->tick();
-                std::this_thread::sleep_for(std::chrono::microseconds(Configuration::WAITER_SLEEP_uS));
+                _queue->waitForJob();
             }
         }
     protected:
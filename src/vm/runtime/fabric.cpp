@@ -41,7 +41,7 @@ namespace swarmc::Runtime {
 
         // fixme: error handling
         auto result = job->getCall()->getReturn();
-        auto enumAnyT = new Type::Enumerable(Type::Ambiguous::of());
+        auto enumAnyT = Type::Enumerable::of(Type::Ambiguous::of());
         GC_LOCAL_REF(enumAnyT);
         assert(result->typei()->isAssignableTo(enumAnyT));
 
@@ -88,13 +88,20 @@ namespace swarmc::Runtime {
             );
         }
 
+        // binn copies strings and nested containers into the parent
         binn* info = binn_map();
-        binn_map_set_str(info, BC_OWNER, strdup(resource->owner().c_str()));
-        binn_map_set_str(info, BC_NAME, strdup(resource->name().c_str()));
-        binn_map_set_map(info, BC_TYPE, Wire::types()->reduce(resource->innerType(), nullptr));
+        binn* type = Wire::types()->reduce(resource->innerType(), nullptr);
+        binn_map_set_str(info, BC_OWNER, (char*) resource->owner().c_str());
+        binn_map_set_str(info, BC_NAME, (char*) resource->name().c_str());
+        binn_map_set_map(info, BC_TYPE, type);
         binn_map_set_uint64(info, BC_CATEGORY, (uint64_t) resource->category());
+        if ( resource->category() == ResourceCategory::REPLICATED ) {
+            binn_map_set_str(info, BC_REPLICA, (char*) resource->replicaData().c_str());
+        }
+        binn_free(type);
 
         std::string serialized((char*) binn_ptr(info), binn_size(info));
+        binn_free(info);
         _vm->global()->putKeyValue(key, serialized);
     }
 
@@ -122,23 +129,36 @@ namespace swarmc::Runtime {
             );
         }
 
-
-        std::stringstream ss;
-        ss << *serialized;
-        void* buf = malloc(sizeof(char) * (*serialized).size());
-        ss.read(static_cast<char*>(buf), static_cast<std::streamsize>((*serialized).size()));
-        auto info = binn_open((char*)buf);
-
+        // Read the resource info in-place from the stored value
+        auto info = binn_open(serialized->data());
         std::string owner = binn_map_str(info, BC_OWNER);
         std::string name = binn_map_str(info, BC_NAME);
         auto type = Wire::types()->produce((binn*) binn_map_map(info, BC_TYPE), nullptr);
         auto category = (ResourceCategory) binn_map_uint64(info, BC_CATEGORY);
+        std::string replica = category == ResourceCategory::REPLICATED ? binn_map_str(info, BC_REPLICA) : "";
+        binn_free(info);
 
         if ( category == ResourceCategory::TUNNELED ) {
             return new TunneledResource(id, owner, name, type);
         }
 
-        throw std::runtime_error("Invalid resource category (currently only TUNNELED is supported)");
+        if ( category == ResourceCategory::REPLICATED ) {
+            std::unique_lock<std::mutex> lock(_replicasMutex);
+            auto factory = _replicas.find(name);
+            if ( factory != _replicas.end() ) {
+                return factory->second(id, owner, replica);
+            }
+        }
+
+        throw std::runtime_error("Invalid resource category (only TUNNELED and registered REPLICATED resources are supported)");
+    }
+
+    std::mutex Fabric::_replicasMutex;
+    std::unordered_map<std::string, ReplicaFactory> Fabric::_replicas;
+
+    void Fabric::registerReplica(const std::string& name, ReplicaFactory factory) {
+        std::unique_lock<std::mutex> lock(_replicasMutex);
+        _replicas[name] = std::move(factory);
     }
 
 }
@@ -1,6 +1,9 @@
 #ifndef SWARMVM_FABRIC
 #define SWARMVM_FABRIC
 
+#include <functional>
+#include <mutex>
+#include <unordered_map>
 #include <utility>
 
 #include "../../../mod/binn/src/binn.h"
@@ -49,9 +52,16 @@ namespace swarmc::Runtime {
         virtual void replicateLocally(VirtualMachine*) {
             throw Errors::RuntimeError(Errors::RuntimeExCode::AttemptedCloneOfNonReplicableResource, "Cannot clone non-replicable resource: " + s(this));
         }
+
+        /** Whatever a REPLICATED resource needs to be rebuilt on another node (see Fabric::registerReplica). */
+        [[nodiscard]] virtual std::string replicaData() const { return {}; }
     };
 
 
+    /** Rebuilds a REPLICATED resource from its ID, owner, and `replicaData()`. */
+    using ReplicaFactory = std::function<IResource*(const std::string& id, const NodeID& owner, const std::string& data)>;
+
+
     class TunneledResourceOperationFunctionCall : public IFunctionCall {
     public:
         TunneledResourceOperationFunctionCall(CallVector vector, Type::Type* returnType) :
@@ -68,12 +78,12 @@ namespace swarmc::Runtime {
         [[nodiscard]] FormalTypes paramTypes() const override {
             // 3 params: the ID of the resource, the name of the operation, and a list of parameters to the operation
             auto stringT = Type::Primitive::of(Type::Intrinsic::STRING);
-            auto enumAnyT = new Type::Enumerable(Type::Ambiguous::of());  // yes, this is equivalent to (void*) but in swarm
+            auto enumAnyT = Type::Enumerable::of(Type::Ambiguous::of());  // yes, this is equivalent to (void*) but in swarm
             return {stringT, stringT, enumAnyT};
         }
 
         [[nodiscard]] Type::Type* returnType() const override {
-            return new Type::Enumerable(Type::Ambiguous::of());
+            return Type::Enumerable::of(Type::Ambiguous::of());
         }
 
         [[nodiscard]] CallVector getCallVector() const override {
@@ -151,12 +161,18 @@ namespace swarmc::Runtime {
 
         virtual IResource* load(const std::string& id);
 
+        /** Register how REPLICATED resources with the given name are rebuilt when loaded on another node. */
+        static void registerReplica(const std::string& name, ReplicaFactory factory);
+
         [[nodiscard]] std::string toString() const override {
             return "Fabric<>";
         }
 
     protected:
         VirtualMachine* _vm;
+
+        static std::mutex _replicasMutex;
+        static std::unordered_map<std::string, ReplicaFactory> _replicas;
     };
 
 }
@@ -1,11 +1,16 @@
 #ifndef SWARMVM_INTERFACES
 #define SWARMVM_INTERFACES
 
+#include <chrono>
+#include <thread>
 #include <utility>
 #include <vector>
 #include <map>
 #include <algorithm>
+#include <functional>
 #include "../../shared/nslib.h"
+#include "../../Configuration.h"
+#include "../../errors/SwarmError.h"
 
 using namespace nslib;
 
@@ -40,6 +45,19 @@ namespace swarmc::Runtime {
     using NodeID = std::string;
     using ReturnMap = std::unordered_map<JobID, ISA::Reference*>;
 
+    /** Read-modify-write operations which storage backends may apply to a location atomically. */
+    enum class AtomicOp: std::size_t {
+        ADD,
+        SUBTRACT,
+        MULTIPLY,
+        DIVIDE,
+        ENUM_APPEND,
+        MAP_SET,
+    };
+
+    /** Computes the new value of a location from its current value, raising if the update is invalid. */
+    using AtomicApply = std::function<ISA::Reference*(ISA::Reference*)>;
+
     /** Tracks the status of a queued function call. */
     enum class JobState: std::size_t {
         UNKNOWN = 1 << 0,
@@ -146,13 +164,42 @@ namespace swarmc::Runtime {
          */
         virtual IStorageLock* acquire(ISA::LocationReference*) = 0;
 
+        /**
+         * Block until the lock on the given location may have been released, or `timeout` passes.
+         * This just sleeps by default. Backends which can be notified of releases should override it.
+         */
+        virtual void waitForUnlock(ISA::LocationReference*, std::chrono::microseconds timeout) {
+            std::this_thread::sleep_for(timeout);
+        }
+
         /** Forget all stored variables. */
         virtual void clear() = 0;
 
+        /** Get a store for a forked VM. Implementations may freeze this store's state to share it. */
         virtual IStorageInterface* copy() = 0;
 
         /** Returns true if the VM should acquire locks before accessing variables in this store. */
         [[nodiscard]] virtual bool shouldLockAccesses() const { return true; }
+
+        /**
+         * Overwrite the number held by a location in place, if nothing else references it.
+         * Returns false, changing nothing, if the caller needs to store a new reference instead.
+         */
+        virtual bool overwriteNumber(ISA::LocationReference*, double) { return false; }
+
+        /** Returns true if this backend can apply `update` without the VM locking the location. */
+        [[nodiscard]] virtual bool supportsAtomicUpdates() const { return false; }
+
+        /**
+         * Replace the value of a location with `apply(current)` in a single atomic step,
+         * without the caller holding its lock. For arithmetic ops, `operand` is the right-hand
+         * number, and backends may compute the result themselves instead of calling `apply`.
+         * Returns the new value. If the update can't be applied right now (e.g. another control
+         * holds the location's lock), nullptr is returned and the caller should retry.
+         */
+        virtual ISA::Reference* update(ISA::LocationReference*, AtomicOp, ISA::Reference* operand, const AtomicApply& apply) {
+            throw Errors::SwarmError("Storage backend " + toString() + " does not support atomic updates.");
+        }
     };
 
 
@@ -223,6 +270,18 @@ namespace swarmc::Runtime {
         virtual const ReturnMap getJobReturns(QueueContextID) = 0;
 
         virtual void tick() = 0;
+
+        /** The number of workers which run this queue's jobs in parallel, used to decide how finely to split work. */
+        virtual std::size_t workerCount() { return 1; }
+
+        /**
+         * Wait for a job to become available and run it. This is called in a loop by dedicated
+         * workers, which have nothing else to do. By default, it ticks and then sleeps briefly.
+         */
+        virtual void waitForJob() {
+            tick();
+            std::this_thread::sleep_for(std::chrono::microseconds(Configuration::WAITER_SLEEP_uS));
+        }
     };
 
 
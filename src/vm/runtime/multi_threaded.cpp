@@ -1,35 +1,173 @@
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include "multi_threaded.h"
 #include "../VirtualMachine.h"
 #include "../../errors/ClearLockedReferences.h"
+#include "../../errors/InvalidStoreLocationError.h"
 
 namespace swarmc::Runtime::MultiThreaded {
 
-    IStorageLock *SharedStorageInterface::acquire(ISA::LocationReference *loc) {
-        if ( _locks.find(loc->fqName()) != _locks.end() ) return nullptr;
-        _locks[loc->fqName()] = new StorageLock(this, loc, _mutexes[loc->fqName()]);
-        return _locks[loc->fqName()];
+    SharedStorageInterface::~SharedStorageInterface() noexcept {
+        for ( auto& shard : _shards ) {
+            shard.slots.forEach([](std::size_t, const Slot& slot) {
+                freeref(slot.loc);
+                freeref(slot.value);
+                freeref(slot.type);
+                freeref(slot.lock);
+            });
+        }
+    }
+
+    SharedStorageInterface::Slot& SharedStorageInterface::slotFor(Shard& shard, ISA::LocationReference* loc) {
+        auto& slot = shard.slots[loc->slot()];
+        if ( slot.loc == nullptr ) slot.loc = useref(loc);
+        return slot;
+    }
+
+    void SharedStorageInterface::assign(Slot& slot, ISA::Reference* value) {
+        if ( slot.type == nullptr ) slot.type = useref(value->type());
+        assert(value->typei()->isAssignableTo(slot.type));
+
+        if ( slot.value == nullptr ) {
+            slot.value = useref(value);
+            _count.fetch_add(1, std::memory_order_relaxed);
+        } else if ( slot.value != value ) {
+            freeref(slot.value);
+            slot.value = useref(value);
+        }
+    }
+
+    ISA::Reference* SharedStorageInterface::load(ISA::LocationReference* loc) {
+        auto& shard = shardFor(loc);
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        auto slot = shard.slots.find(loc->slot());
+        if ( slot == nullptr || slot->value == nullptr ) throw Errors::InvalidStoreLocationError(s(loc), s(this));
+        return slot->value;
+    }
+
+    void SharedStorageInterface::store(ISA::LocationReference* loc, ISA::Reference* value) {
+        auto& shard = shardFor(loc);
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        assign(slotFor(shard, loc), value);
+    }
+
+    bool SharedStorageInterface::has(ISA::LocationReference* loc) {
+        auto& shard = shardFor(loc);
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        auto slot = shard.slots.find(loc->slot());
+        return slot != nullptr && slot->value != nullptr;
+    }
+
+    bool SharedStorageInterface::manages(ISA::LocationReference* loc) {
+        return loc->affinity() == ISA::Affinity::SHARED;
+    }
+
+    void SharedStorageInterface::drop(ISA::LocationReference* loc) {
+        auto& shard = shardFor(loc);
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        auto slot = shard.slots.find(loc->slot());
+        if ( slot == nullptr || slot->value == nullptr ) return;
+
+        // Keep the slot itself, since its lock may be held
+        freeref(slot->value);
+        freeref(slot->type);
+        slot->value = nullptr;
+        slot->type = nullptr;
+        _count.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    const Type::Type* SharedStorageInterface::typeOf(ISA::LocationReference* loc) {
+        auto& shard = shardFor(loc);
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        auto slot = shard.slots.find(loc->slot());
+        if ( slot == nullptr ) return nullptr;
+        return slot->type;
+    }
+
+    void SharedStorageInterface::typify(ISA::LocationReference* loc, Type::Type* type) {
+        auto& shard = shardFor(loc);
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        auto& slot = slotFor(shard, loc);
+        if ( slot.type != type ) {
+            freeref(slot.type);
+            slot.type = useref(type);
+        }
+    }
+
+    IStorageLock* SharedStorageInterface::acquire(ISA::LocationReference* loc) {
+        auto& shard = shardFor(loc);
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        auto& slot = slotFor(shard, loc);
+        if ( slot.lock == nullptr ) slot.lock = useref(new StorageLock(this, slot.loc));
+        if ( !slot.lock->tryAcquire() ) return nullptr;
+        return slot.lock;
+    }
+
+    void SharedStorageInterface::waitForUnlock(ISA::LocationReference* loc, std::chrono::microseconds timeout) {
+        auto& shard = shardFor(loc);
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        auto slot = shard.slots.find(loc->slot());
+        if ( slot == nullptr || slot->lock == nullptr ) return;
+
+        // The slot may move while we wait, but its lock won't
+        auto held = slot->lock;
+        shard.waiters += 1;
+        shard.released.wait_for(lock, timeout, [held]() { return !held->isHeld(); });
+        shard.waiters -= 1;
+    }
+
+    void SharedStorageInterface::notifyReleased(const ISA::LocationReference* loc) {
+        auto& shard = shardFor(loc);
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        if ( shard.waiters > 0 ) shard.released.notify_all();
+    }
+
+    ISA::Reference* SharedStorageInterface::update(ISA::LocationReference* loc, AtomicOp, ISA::Reference*, const AtomicApply& apply) {
+        auto& shard = shardFor(loc);
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        auto slot = shard.slots.find(loc->slot());
+        if ( slot == nullptr || slot->value == nullptr ) throw Errors::InvalidStoreLocationError(s(loc), s(this));
+        if ( slot->lock != nullptr && slot->lock->isHeld() ) return nullptr;
+
+        auto value = apply(slot->value);
+        assign(*slot, value);
+        return value;
     }
 
     void SharedStorageInterface::clear() {
-        if ( !_locks.empty() ) throw Errors::ClearLockedReferences();
-        _map.clear();
-        _types.clear();
-        _mutexes.clear();
+        for ( auto& shard : _shards ) {
+            std::unique_lock<std::mutex> lock(shard.mutex);
+            shard.slots.forEach([](std::size_t, const Slot& slot) {
+                if ( slot.lock != nullptr && slot.lock->isHeld() ) throw Errors::ClearLockedReferences();
+            });
+        }
+
+        for ( auto& shard : _shards ) {
+            std::unique_lock<std::mutex> lock(shard.mutex);
+            shard.slots.forEach([](std::size_t, const Slot& slot) {
+                freeref(slot.loc);
+                freeref(slot.value);
+                freeref(slot.type);
+                freeref(slot.lock);
+            });
+            shard.slots.clear();
+        }
+
+        _count.store(0, std::memory_order_relaxed);
     }
 
-    ISA::LocationReference *StorageLock::location() const {
+    ISA::LocationReference* StorageLock::location() const {
         return _loc;
     }
 
     void StorageLock::release() {
-        delete _lock;
-        _store->_locks.erase(_loc->fqName());
+        _held.store(false, std::memory_order_release);
+        _store->notifyReleased(_loc);
     }
 
     std::string StorageLock::toString() const {
-        return "SingleThreaded::StorageLock<loc: " + _loc->toString() + ">";
+        return "MultiThreaded::StorageLock<loc: " + _loc->toString() + ">";
     }
 
     QueueJob::QueueJob(
@@ -41,7 +179,15 @@ namespace swarmc::Runtime::MultiThreaded {
         delete _vm;
     }
 
+    thread_local Queue* Queue::_workerQueue = nullptr;
+    thread_local std::size_t Queue::_workerIndex = 0;
+
     Queue::Queue(VirtualMachine* vm) : _jobRetMap(new std::unordered_map<QueueContextID, ReturnMap>()) {
+        for ( std::size_t i = 0; i <= Configuration::MAX_THREADS; i += 1 ) {
+            _deques.push_back(new JobDeque);
+            _currentContext.emplace_back("");
+        }
+
         vm->lifecycle()->listen<VirtualMachineInitializingEvent>([this](VirtualMachineInitializingEvent& e) {
             spawnThreads();
         });
@@ -57,68 +203,89 @@ namespace swarmc::Runtime::MultiThreaded {
 
     void Queue::push(VirtualMachine* vm, IQueueJob* job) {
         auto context = vm->getQueueContext();
-        std::unique_lock<std::mutex> queueLock(_queueMutex);
 
-        auto queueIter = _contextQueues.find(context);
-        if ( queueIter == _contextQueues.end() ) {
-            std::queue<IQueueJob*> queue;
-            queue.push(useref(job));
-            _contextQueues[context] = queue;
-            return;
+        {
+            std::unique_lock<std::mutex> queueLock(_queueMutex);
+            _contextJobsOutstanding[context] += 1;
         }
 
-        queueIter->second.push(useref(job));
+        {
+            auto deque = _deques.at(ownDeque());
+            std::unique_lock<std::mutex> dequeLock(deque->mutex);
+            deque->jobs.push_back({useref(job), context});
+            _pending += 1;
+        }
+
+        // Wake up a parked worker, if there is one. (Workers register as parked before
+        // re-checking _pending, so either they will see this job or we will see them.)
+        if ( _parked > 0 ) {
+            std::unique_lock<std::mutex> parkLock(_parkMutex);
+            _parkCondition.notify_one();
+        }
     }
 
     IQueueJob* Queue::pop() {
-        std::unique_lock<std::mutex> queueLock(_queueMutex);
+        auto context = getContext();
+        for ( auto deque : _deques ) {
+            std::unique_lock<std::mutex> dequeLock(deque->mutex);
+            auto iter = std::find_if(deque->jobs.begin(), deque->jobs.end(), [&context](const PendingJob& pending) {
+                return pending.context == context;
+            });
+
+            if ( iter == deque->jobs.end() ) continue;
 
-        auto queueIter = _contextQueues.find(_context);
-        if ( queueIter == _contextQueues.end() || queueIter->second.empty() ) {
-            return nullptr;
+            auto job = iter->job;
+            deque->jobs.erase(iter);
+            _pending -= 1;
+            dequeLock.unlock();
+
+            decrementProcessingCount(context);
+            releaseref(job);
+            return job;
         }
 
-        auto job = queueIter->second.front();
-        queueIter->second.pop();
-        releaseref(job);
-        return job;
+        return nullptr;
     }
 
     void Queue::tick() {
         // This is called while we are waiting for jobs to drain.
         // So, try to process any pending jobs here so we can wait productively.
         // This also helps avoid infinite waiting loops.
-        tryToProcessJob(Configuration::MAX_THREADS);
+        tryToProcessJob(ownDeque());
 
         // Also, tick threads to keep nslib happy
         Framework::tick();
     }
 
-    void Queue::tryToProcessJob(int tid) {
+    bool Queue::tryToProcessJob(std::size_t tid) {
+        auto pending = popForProcessing(tid);
+        if ( !pending ) return false;
+
         // Currently, the semantics of the VM guarantees that a Queue will only receive the instances of
         // IQueueJob that its Queue::build(...) method returns, so we're safe to cast the IQueueJob* as
         // QueueJob* here.
-        auto jobPair = popForProcessing(tid);
-        auto job = dynamic_cast<QueueJob*>(jobPair.first);
+        auto job = dynamic_cast<QueueJob*>(pending->job);
         if ( job != nullptr ) {
             GC_LOCAL_REF(job)
             auto call = job->getCall();
             try {
                 Console::get()->debug("Running job: " + s(job));
                 job->getVM()->executeCall(call);
-                setJobReturn(jobPair.second, job->id(), call->getReturn());
+                setJobReturn(pending->context, job->id(), call->getReturn());
                 job->setState(JobState::COMPLETE);
-                decrementProcessingCount(jobPair.second);
+                decrementProcessingCount(pending->context);
             } catch (Errors::SwarmError& rte) {
                 Console::get()->error("Thread error: " + s(rte));
                 job->setState(JobState::ERROR);
-                decrementProcessingCount(jobPair.second);
+                decrementProcessingCount(pending->context);
             } catch (...) {
                 Console::get()->error("Unknown thread error!");
                 job->setState(JobState::ERROR);
-                decrementProcessingCount(jobPair.second);
+                decrementProcessingCount(pending->context);
             }
         }
+
+        return true;
     }
 
     void Queue::spawnThreads() {
@@ -127,62 +294,104 @@ namespace swarmc::Runtime::MultiThreaded {
             return;  // We've already done this!
         }
 
-        Console::get()->debug("Starting " + s(Configuration::MAX_THREADS) + " worker threads...");
-        for ( std::size_t i = 0; i < Configuration::MAX_THREADS; i += 1 ) {
+        // (the last deque belongs to threads outside the pool)
+        auto workers = _deques.size() - 1;
+        Console::get()->debug("Starting " + s(workers) + " worker threads...");
+        for ( std::size_t i = 0; i < workers; i += 1 ) {
             auto ctx = Framework::newThread([this, i]() -> int {
                 Console::get()->debug("Started worker thread.");
+                _workerQueue = this;
+                _workerIndex = i;
 
                 while ( !_shouldExit ) {
-                    tryToProcessJob(i);
-                    std::this_thread::sleep_for(std::chrono::microseconds(Configuration::QUEUE_SLEEP_uS));
+                    if ( !tryToProcessJob(i) ) park();
                 }
 
                 return 0;
             });
 
             _threads.push_back(ctx);
-            _currentContext.push_back("");
         }
-        _currentContext.push_back(_context);
+        setCurrentContext(_deques.size() - 1, getContext());
 
         // Trigger the worker threads to exit when the main thread shuts down.
         Framework::onShuttingDown([this]() {
-            _shouldExit = true;
+            {
+                std::unique_lock<std::mutex> parkLock(_parkMutex);
+                _shouldExit = true;
+            }
+            _parkCondition.notify_all();
         });
     }
 
-    std::pair<IQueueJob*, QueueContextID> Queue::popForProcessing(int tid) {
-        std::unique_lock<std::mutex> queueLock(_queueMutex);
+    std::size_t Queue::ownDeque() const {
+        if ( _workerQueue == this ) return _workerIndex;
+        return _deques.size() - 1;
+    }
 
-        // Try to pop a job from the current context first
-        auto job = popForProcessingFromContext(_currentContext.at(tid));
-        if ( job != nullptr ) {
-            return {job, _currentContext.at(tid)};
+    void Queue::park() {
+        std::unique_lock<std::mutex> parkLock(_parkMutex);
+        _parked += 1;
+        _parkCondition.wait(parkLock, [this]() {
+            return _pending > 0 || _shouldExit;
+        });
+        _parked -= 1;
+    }
+
+    std::optional<Queue::PendingJob> Queue::popForProcessing(std::size_t tid) {
+        auto current = getCurrentContext(tid);
+        auto count = _deques.size();
+
+        // Try to pop a job from the current context first, starting with our own deque.
+        // Thieves start at different offsets so they don't all contend on the same victim.
+        if ( !current.empty() ) {
+            for ( std::size_t i = 0; i < count; i += 1 ) {
+                auto pending = takeFrom((tid + i) % count, i == 0, current);
+                if ( pending ) return pending;
+            }
         }
 
         // Otherwise, run any jobs pending in other contexts
-        for ( const auto& pair : _contextQueues ) {
-            auto otherJob = popForProcessingFromContext(pair.first);
-            if ( otherJob != nullptr ) {
-                if ( _currentContext.at(tid) == "" ) _currentContext.at(tid) = pair.first;
-                return {otherJob, pair.first};
+        for ( std::size_t i = 0; i < count; i += 1 ) {
+            auto pending = takeFrom((tid + i) % count, i == 0, std::nullopt);
+            if ( pending ) {
+                if ( current.empty() ) setCurrentContext(tid, pending->context);
+                return pending;
             }
         }
 
-        return {nullptr, _currentContext.at(tid)};
+        return std::nullopt;
+    }
+
+    QueueContextID Queue::getCurrentContext(std::size_t tid) {
+        if ( tid + 1 < _deques.size() ) return _currentContext.at(tid);
+        std::unique_lock<std::mutex> contextLock(_sharedContextMutex);
+        return _currentContext.back();
     }
 
-    IQueueJob* Queue::popForProcessingFromContext(const QueueContextID& context) {
-        auto queueIter = _contextQueues.find(context);
-        if ( queueIter == _contextQueues.end() || queueIter->second.empty() ) {
-            return nullptr;
+    void Queue::setCurrentContext(std::size_t tid, const QueueContextID& context) {
+        if ( tid + 1 < _deques.size() ) {
+            _currentContext.at(tid) = context;
+            return;
         }
 
-        auto job = queueIter->second.front();
-        queueIter->second.pop();
-        _contextJobsInProgress[context] += 1;
+        std::unique_lock<std::mutex> contextLock(_sharedContextMutex);
+        if ( _currentContext.back().empty() ) _currentContext.back() = context;
+    }
+
+    std::optional<Queue::PendingJob> Queue::takeFrom(std::size_t idx, bool owner, const std::optional<QueueContextID>& context) {
+        auto deque = _deques.at(idx);
+        std::unique_lock<std::mutex> dequeLock(deque->mutex);
+        if ( deque->jobs.empty() ) return std::nullopt;
+
+        auto& candidate = owner ? deque->jobs.back() : deque->jobs.front();
+        if ( context && candidate.context != *context ) return std::nullopt;
 
-        return job;
+        auto pending = candidate;
+        if ( owner ) deque->jobs.pop_back();
+        else deque->jobs.pop_front();
+        _pending -= 1;
+        return pending;
     }
 
     void Queue::setJobReturn(QueueContextID qid, JobID id, ISA::Reference* value) {
@@ -207,7 +416,7 @@ namespace swarmc::Runtime::MultiThreaded {
 
     void Queue::decrementProcessingCount(const QueueContextID& context) {
         std::unique_lock<std::mutex> queueLock(_queueMutex);
-        _contextJobsInProgress[context] -= 1;
+        _contextJobsOutstanding[context] -= 1;
     }
 
     Stream::~Stream() noexcept {
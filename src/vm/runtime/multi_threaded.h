@@ -1,11 +1,17 @@
 #ifndef SWARMVM_MULTI_THREADED_H
 #define SWARMVM_MULTI_THREADED_H
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <mutex>
+#include <optional>
 #include <queue>
 #include "../../shared/nslib.h"
 #include "../ISA.h"
 #include "single_threaded.h"
+#include "slot_map.h"
 #include "interfaces.h"
 
 namespace swarmc::Runtime {
@@ -26,38 +32,122 @@ namespace swarmc::Runtime::MultiThreaded {
         }
     };
 
-    class SharedStorageInterface : public SingleThreaded::StorageInterface {
+    /**
+     * The store for shared variables, used concurrently by every worker thread.
+     *
+     * Locations are spread over SHARD_COUNT shards by slot number, and each shard's mutex is
+     * only held for a single lookup or write, so threads using different variables rarely
+     * contend. A location's lock is a flag on its slot claimed by compare-and-swap, so `acquire`
+     * never blocks: if the lock is taken it returns nullptr and the VM retries (see VirtualMachine::lock).
+     * Controls waiting to retry park on their shard's condition variable until a lock in it is released.
+     */
+    class SharedStorageInterface : public IStorageInterface {
     public:
-        explicit SharedStorageInterface() : StorageInterface(ISA::Affinity::SHARED) {}
+        SharedStorageInterface() = default;
+
+        ~SharedStorageInterface() noexcept override;
+
+        ISA::Reference* load(ISA::LocationReference*) override;
+
+        void store(ISA::LocationReference*, ISA::Reference*) override;
+
+        bool has(ISA::LocationReference*) override;
+
+        bool manages(ISA::LocationReference*) override;
+
+        void drop(ISA::LocationReference*) override;
+
+        const Type::Type* typeOf(ISA::LocationReference*) override;
+
+        void typify(ISA::LocationReference*, Type::Type*) override;
 
         IStorageLock* acquire(ISA::LocationReference*) override;
 
+        void waitForUnlock(ISA::LocationReference*, std::chrono::microseconds timeout) override;
+
         void clear() override;
 
-        bool shouldLockAccesses() const override { return true; }
+        /** Every VM in the process shares the same store. */
+        IStorageInterface* copy() override { return this; }
+
+        [[nodiscard]] bool shouldLockAccesses() const override { return true; }
+
+        [[nodiscard]] bool supportsAtomicUpdates() const override { return true; }
+
+        /** Applies the update while holding the location's shard, unless the location is locked. */
+        ISA::Reference* update(ISA::LocationReference*, AtomicOp, ISA::Reference* operand, const AtomicApply& apply) override;
 
         [[nodiscard]] virtual serial::tag_t getSerialKey() const override { return "swarm::MultiThreaded::SharedStorageInterface"; }
+
+        [[nodiscard]] std::string toString() const override {
+            return "MultiThreaded::SharedStorageInterface<#loc: " + std::to_string(_count.load(std::memory_order_relaxed)) + ">";
+        }
+
     protected:
-        std::map<std::string, std::mutex> _mutexes;
+        static constexpr std::size_t SHARD_COUNT = 64;
+
+        /** The value, declared type, and lock of a single location. */
+        struct Slot {
+            ISA::LocationReference* loc = nullptr;
+            ISA::Reference* value = nullptr;
+            Type::Type* type = nullptr;
+            StorageLock* lock = nullptr;  // created with the slot and re-used by every acquire
+        };
+
+        struct Shard {
+            std::mutex mutex;
+            SlotMap<Slot> slots;
+            std::condition_variable released;
+            std::size_t waiters = 0;
+        };
+
+        std::array<Shard, SHARD_COUNT> _shards;
+        std::atomic<std::size_t> _count = 0;
+
+        Shard& shardFor(const ISA::LocationReference* loc) {
+            return _shards[loc->slot() % SHARD_COUNT];
+        }
+
+        /** Get the slot for the given location, creating it if necessary. The shard's mutex must be held. */
+        Slot& slotFor(Shard&, ISA::LocationReference*);
+
+        /** Replace the value of a slot. The shard's mutex must be held. */
+        void assign(Slot&, ISA::Reference*);
+
+        /** Wake the controls waiting for a lock to be released in the location's shard. */
+        void notifyReleased(const ISA::LocationReference*);
 
         friend class StorageLock;
     };
 
+    /** The lock of a single location in a SharedStorageInterface. Owned by the store, and re-used across acquisitions. */
     class StorageLock : public IStorageLock {
     public:
-        StorageLock(SharedStorageInterface* store, ISA::LocationReference* loc, std::mutex& m) : _store(store), _loc(loc) {
-            _lock = new std::lock_guard<std::mutex>(m);
+        StorageLock(SharedStorageInterface* store, ISA::LocationReference* loc) : _store(store), _loc(useref(loc)) {}
+
+        ~StorageLock() noexcept override {
+            freeref(_loc);
         }
 
         [[nodiscard]] ISA::LocationReference* location() const override;
 
+        /** Claim the lock. Returns false if it is already held. */
+        bool tryAcquire() {
+            bool expected = false;
+            return _held.compare_exchange_strong(expected, true, std::memory_order_acquire, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] bool isHeld() const {
+            return _held.load(std::memory_order_acquire);
+        }
+
         void release() override;
 
         [[nodiscard]] std::string toString() const override;
     protected:
-        SharedStorageInterface* _store = nullptr;
+        SharedStorageInterface* _store = nullptr;  // not ref-counted, since the store owns its locks
         ISA::LocationReference* _loc = nullptr;
-        std::lock_guard<std::mutex>* _lock;
+        std::atomic<bool> _held = false;
     };
 
     class QueueJob : public IQueueJob {
@@ -91,19 +181,29 @@ namespace swarmc::Runtime::MultiThreaded {
         VirtualMachine* _vm;
     };
 
+    /**
+     * A work-stealing job queue backed by a pool of worker threads.
+     *
+     * Each worker has its own deque of pending jobs (plus one shared by threads outside the
+     * pool, like the main thread). Jobs pushed from a worker go onto that worker's deque, and
+     * the owner takes them back newest-first, so a thread draining a nested context runs its
+     * own jobs first. Idle workers steal the oldest jobs from other deques, preferring jobs from
+     * their current context, and park on a condition variable when there is nothing to do.
+     */
     class Queue : public IQueue {
     public:
         explicit Queue(VirtualMachine*);
 
         ~Queue() {
             delete _jobRetMap;
+            for ( auto deque : _deques ) delete deque;
         }
 
         void setContext(QueueContextID ctx) override {
             std::unique_lock<std::mutex> queueLock(_queueMutex);
             _context = ctx;
-            if ( _contextJobsInProgress.find(_context) == _contextJobsInProgress.end() ) {
-                _contextJobsInProgress[_context] = 0;
+            if ( _contextJobsOutstanding.find(_context) == _contextJobsOutstanding.end() ) {
+                _contextJobsOutstanding[_context] = 0;
             }
         }
 
@@ -122,8 +222,8 @@ namespace swarmc::Runtime::MultiThreaded {
 
         bool isEmpty(QueueContextID context) override {
             std::unique_lock<std::mutex> lock(_queueMutex);
-            auto queueIter = _contextQueues.find(context);
-            return (queueIter == _contextQueues.end() || queueIter->second.empty()) && _contextJobsInProgress[context] == 0;
+            auto iter = _contextJobsOutstanding.find(context);
+            return iter == _contextJobsOutstanding.end() || iter->second == 0;
         }
 
         [[nodiscard]] std::string toString() const override {
@@ -132,30 +232,87 @@ namespace swarmc::Runtime::MultiThreaded {
 
         void tick() override;
 
-        void tryToProcessJob(int);
+        std::size_t workerCount() override {
+            // One deque belongs to the control thread, the rest to the spawned workers
+            return std::max<std::size_t>(1, _deques.size() - 1);
+        }
+
+        /** Run a single pending job on the calling thread, if there is one. Returns true if a job was run. */
+        bool tryToProcessJob(std::size_t);
 
         virtual void setJobReturn(QueueContextID qid, JobID id, ISA::Reference* value) override;
 
         virtual const ReturnMap getJobReturns(QueueContextID) override;
 
     protected:
-        JobID _nextId = 0;
+        /** A pending job, along with the context it was pushed in. */
+        struct PendingJob {
+            IQueueJob* job;
+            QueueContextID context;
+        };
+
+        /** The pending jobs owned by one thread. The owner uses the back, thieves take from the front. */
+        struct JobDeque {
+            std::mutex mutex;
+            std::deque<PendingJob> jobs;
+        };
+
+        std::atomic<JobID> _nextId = 0;
         QueueContextID _context;
         std::mutex _queueMutex;
         std::mutex _threadMutex;
         std::vector<IThreadContext*> _threads;
-        std::map<QueueContextID, std::queue<IQueueJob*>> _contextQueues;
-        std::map<QueueContextID, std::size_t> _contextJobsInProgress;
+
+        /** One deque per worker thread, plus a final one shared by threads outside the pool. */
+        std::vector<JobDeque*> _deques;
+
+        /** Number of jobs pushed in each context that haven't finished running. */
+        std::map<QueueContextID, std::size_t> _contextJobsOutstanding;
         std::unordered_map<QueueContextID, ReturnMap>* _jobRetMap;
+
+        /**
+         * The context each thread (by deque index) prefers to take jobs from. Worker slots are
+         * only touched by their own worker. The last slot is shared by every thread outside the
+         * pool, so it is guarded by `_sharedContextMutex`.
+         */
         std::vector<QueueContextID> _currentContext;
+        std::mutex _sharedContextMutex;
+
+        /** Total number of jobs sitting in the deques. Workers park while this is 0. */
+        std::atomic<std::size_t> _pending = 0;
+        std::atomic<std::size_t> _parked = 0;
+        std::mutex _parkMutex;
+        std::condition_variable _parkCondition;
+
+        std::atomic<bool> _shouldExit = false;
+
+        /** The queue whose pool the current thread belongs to (nullptr outside of worker threads). */
+        static thread_local Queue* _workerQueue;
 
-        bool _shouldExit = false;
+        /** The current thread's index in `_workerQueue`'s pool. */
+        static thread_local std::size_t _workerIndex;
 
         void spawnThreads();
 
-        std::pair<IQueueJob*, QueueContextID> popForProcessing(int);
+        /** Get the index of the deque owned by the calling thread. */
+        [[nodiscard]] std::size_t ownDeque() const;
+
+        /** Block the calling worker until there may be jobs to run, or the queue is shutting down. */
+        void park();
+
+        std::optional<PendingJob> popForProcessing(std::size_t);
+
+        /** Read the preferred context of the given deque's thread(s). */
+        QueueContextID getCurrentContext(std::size_t tid);
+
+        /** Set the preferred context of the given deque's thread(s). The shared slot is only set once. */
+        void setCurrentContext(std::size_t tid, const QueueContextID& context);
 
-        IQueueJob* popForProcessingFromContext(const QueueContextID&);
+        /**
+         * Remove a job from the given deque. The owner takes from the back, anyone else takes
+         * from the front. If `context` is set, only a job from that context will be taken.
+         */
+        std::optional<PendingJob> takeFrom(std::size_t deque, bool owner, const std::optional<QueueContextID>& context);
 
         void decrementProcessingCount(const QueueContextID&);
     };
@@ -1,9 +1,13 @@
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
 #include <sstream>
 #include <sw/redis++/redis++.h>
 #include "../../errors/InvalidStoreLocationError.h"
 #include "../ISA.h"
 #include "../walk/BinaryISAWalk.h"
+#include "../walk/binary_const.h"
 #include "../VirtualMachine.h"
 #include "redis_driver.h"
 #include <iostream>
@@ -27,28 +31,37 @@ namespace swarmc::Runtime::RedisDriver {
     }
 
     bool redisSet(const std::string& key, ISA::Reference* ref, VirtualMachine* vm) {
-        auto bin = Wire::references()->reduce(ref, vm);
-        std::string s((char*)binn_ptr(bin), binn_size(bin));
-        return getRedis()->set(key, s);
+        return getRedis()->set(key, redisSerialize(ref, vm).view());
     }
 
     bool redisSet(const std::string& key, Type::Type* ref, VirtualMachine* vm) {
-        auto bin = Wire::types()->reduce(ref, vm);
-        std::string s((char*)binn_ptr(bin), binn_size(bin));
-        return getRedis()->set(key, s);
+        return getRedis()->set(key, redisSerialize(ref, vm).view());
     }
 
-    binn* redisRead(sw::redis::OptionalString val) {
-        if ( !val ) return nullptr;
-        std::stringstream ss;
+    sw::redis::StringView binnView(binn* obj) {
+        return {static_cast<const char*>(binn_ptr(obj)), static_cast<std::size_t>(binn_size(obj))};
+    }
+
+    RedisBinn redisSerialize(ISA::Reference* ref, VirtualMachine* vm) {
+        return RedisBinn(Wire::references()->reduce(ref, vm));
+    }
 
-        ss << val.value();
-        auto length = val.value().size();
+    RedisBinn redisSerialize(Type::Type* ref, VirtualMachine* vm) {
+        return RedisBinn(Wire::types()->reduce(ref, vm));
+    }
 
-        void* buf = malloc(sizeof(char) * length);
-        ss.read(static_cast<char*>(buf), static_cast<std::streamsize>(length));
+    std::string contentHash(sw::redis::StringView data) {
+        // 64-bit FNV-1a, qualified with the length. This only needs to be stable across
+        // nodes and builds, which std::hash doesn't guarantee.
+        std::uint64_t hash = 0xcbf29ce484222325ull;
+        for ( auto c : data ) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 0x100000001b3ull;
+        }
 
-        return binn_open((char*)buf);
+        std::stringstream ss;
+        ss << std::hex << hash << "-" << std::dec << data.size();
+        return ss.str();
     }
 
     std::optional<std::string> GlobalServices::getKeyValue(const std::string &key) {
@@ -63,27 +76,133 @@ namespace swarmc::Runtime::RedisDriver {
         getRedis()->del(key);
     }
 
-    ISA::Reference* RedisStorageInterface::load(ISA::LocationReference* loc) {
-        auto b = redisRead(_redis->get(Configuration::REDIS_PREFIX + loc->fqName()));
-        if ( !b ) throw Errors::InvalidStoreLocationError(s(loc), s(this));
-        auto ref = Wire::references()->produce(b, _vm);
+    const std::string RedisStorageInterface::ATOMIC_ARITHMETIC_SCRIPT = R"lua(
+        if redis.call('EXISTS', KEYS[2]) == 1 then return 'locked' end
+        local current = redis.call('GET', KEYS[1])
+        if not current then return 'missing' end
+        if string.sub(current, 1, 1) ~= '#' then return 'value' end
+
+        -- tonumber() can't read back the inf/nan that %.17g writes for non-finite numbers,
+        -- so those are left to the caller, which falls back to compare-and-set
+        local lhs = tonumber(string.sub(current, 2))
+        local rhs = tonumber(ARGV[2])
+        if not lhs or not rhs then return 'nonfinite' end
+
+        local result
+        if ARGV[1] == '+' then result = lhs + rhs
+        elseif ARGV[1] == '-' then result = lhs - rhs
+        elseif ARGV[1] == '*' then result = lhs * rhs
+        else result = lhs / rhs end
+        if result ~= result or result == math.huge or result == -math.huge then return 'nonfinite' end
+
+        local encoded = '#' .. string.format('%.17g', result)
+        redis.call('SET', KEYS[1], encoded)
+        return encoded
+    )lua";
+
+    const std::string RedisStorageInterface::COMPARE_AND_SET_SCRIPT = R"lua(
+        if redis.call('EXISTS', KEYS[2]) == 1 then return 0 end
+        if redis.call('GET', KEYS[1]) ~= ARGV[1] then return 0 end
+        redis.call('SET', KEYS[1], ARGV[2])
+        return 1
+    )lua";
+
+    static std::string encodeNumber(double value) {
+        // %.17g round-trips every double
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "#%.17g", value);
+        return buf;
+    }
+
+    static std::optional<std::string> encodeNative(const ISA::Reference* value) {
+        if ( value->tag() != ISA::ReferenceTag::NUMBER ) return std::nullopt;
+        return encodeNumber(((ISA::NumberReference*) value)->value());
+    }
+
+    static std::optional<double> decodeNumber(const std::string& data) {
+        // Serialized values are binn containers, which never begin with '#'
+        if ( data.empty() || data[0] != '#' ) return std::nullopt;
+        return std::strtod(data.c_str() + 1, nullptr);
+    }
+
+    static const char* arithmeticOperator(AtomicOp op) {
+        if ( op == AtomicOp::ADD ) return "+";
+        if ( op == AtomicOp::SUBTRACT ) return "-";
+        if ( op == AtomicOp::MULTIPLY ) return "*";
+        if ( op == AtomicOp::DIVIDE ) return "/";
+        return nullptr;
+    }
+
+    ISA::Reference* RedisStorageInterface::decode(const std::string& data) {
+        if ( auto number = decodeNumber(data) ) return new ISA::NumberReference(*number);
+
+        auto b = binn_open((void*) data.data());
+        auto value = Wire::references()->produce(b, _vm);
         binn_free(b);
-        return ref;
+        return value;
+    }
+
+    ISA::Reference* RedisStorageInterface::load(ISA::LocationReference* loc) {
+        auto data = _redis->get(Configuration::REDIS_PREFIX + loc->fqName());
+        if ( !data ) throw Errors::InvalidStoreLocationError(s(loc), s(this));
+        return decode(*data);
     }
 
     void RedisStorageInterface::store(ISA::LocationReference* loc, ISA::Reference* value) {
-        auto typeBinn = redisRead(_redis->get(Configuration::REDIS_PREFIX + "type:" + loc->fqName()));
-        Type::Type* type = nullptr;
-        if ( !typeBinn ) {
-            redisSet(Configuration::REDIS_PREFIX + "type:" + loc->fqName(), value->type(), _vm);
-            type = value->type();
-        } else {
-            type = Wire::types()->produce(typeBinn, _vm);
-            binn_free(typeBinn);
-        }
+        auto native = encodeNative(value);
+        RedisBinn serialized(native ? nullptr : Wire::references()->reduce(value, _vm));
+
+        // Constrain the location to the value's type if it doesn't have one yet, read back
+        // whichever type it ends up with, and write the value, all in one round-trip.
+        auto typeKey = Configuration::REDIS_PREFIX + "type:" + loc->fqName();
+        [[maybe_unused]] auto replies = _redis->pipeline(false)
+            .set(typeKey, redisSerialize(value->type(), _vm).view(), std::chrono::milliseconds(0), sw::redis::UpdateType::NOT_EXIST)
+            .get(typeKey)
+            .set(Configuration::REDIS_PREFIX + loc->fqName(), native ? sw::redis::StringView(*native) : serialized.view())
+            .exec();
+
+#ifndef NDEBUG
+        RedisBinn typeBinn(replies.get<sw::redis::OptionalString>(1));
+        auto type = Wire::types()->produce(typeBinn.get(), _vm);
         assert(value->type()->isAssignableTo(type));
+#endif
+    }
+
+    ISA::Reference* RedisStorageInterface::update(ISA::LocationReference* loc, AtomicOp op, ISA::Reference* operand, const AtomicApply& apply) {
+        auto key = Configuration::REDIS_PREFIX + loc->fqName();
+        auto lockKey = Configuration::REDIS_PREFIX + "lock:" + loc->fqName();
+
+        auto arithmetic = arithmeticOperator(op);
+        if ( arithmetic != nullptr && operand->tag() == ISA::ReferenceTag::NUMBER ) {
+            auto rhs = encodeNumber(((ISA::NumberReference*) operand)->value()).substr(1);
+            auto reply = _redis->eval<std::string>(ATOMIC_ARITHMETIC_SCRIPT, {key, lockKey}, {arithmetic, rhs});
+            if ( reply == "locked" ) return nullptr;
+            if ( reply == "missing" ) throw Errors::InvalidStoreLocationError(s(loc), s(this));
+            if ( auto number = decodeNumber(reply) ) return new ISA::NumberReference(*number);
+            // Otherwise, the current value isn't a number (so `apply` raises the error), or the
+            // operands or result aren't finite, which the compare-and-set below handles instead.
+        }
+
+        auto current = _redis->get(key);
+        if ( !current ) throw Errors::InvalidStoreLocationError(s(loc), s(this));
+
+        auto value = apply(decode(*current));
+        auto native = encodeNative(value);
+        RedisBinn serialized(native ? nullptr : Wire::references()->reduce(value, _vm));
+
+        auto replaced = _redis->eval<long long>(
+            COMPARE_AND_SET_SCRIPT,
+            {key, lockKey},
+            {*current, native ? sw::redis::StringView(*native) : serialized.view()}
+        );
+
+        if ( !replaced ) {
+            // The location was locked or changed underneath us, so try again later
+            GC_LOCAL_REF(value)
+            return nullptr;
+        }
 
-        redisSet(Configuration::REDIS_PREFIX + loc->fqName(), value, _vm);
+        return value;
     }
 
     bool RedisStorageInterface::has(ISA::LocationReference* ref) {
@@ -95,14 +214,17 @@ namespace swarmc::Runtime::RedisDriver {
     }
 
     void RedisStorageInterface::drop(ISA::LocationReference* ref) {
-        _redis->del(Configuration::REDIS_PREFIX + "type:" + ref->fqName());
-        _redis->del(Configuration::REDIS_PREFIX + ref->fqName());
+        std::vector<std::string> keys = {
+            Configuration::REDIS_PREFIX + "type:" + ref->fqName(),
+            Configuration::REDIS_PREFIX + ref->fqName(),
+        };
+        _redis->del(keys.begin(), keys.end());
     }
 
     const Type::Type* RedisStorageInterface::typeOf(ISA::LocationReference* ref) {
-        auto type = redisRead(_redis->get(Configuration::REDIS_PREFIX + "type:" + ref->fqName()));
+        RedisBinn type(_redis->get(Configuration::REDIS_PREFIX + "type:" + ref->fqName()));
         if ( type ) {
-            return Wire::types()->produce(type, _vm);
+            return Wire::types()->produce(type.get(), _vm);
         }
         return nullptr;
     }
@@ -123,8 +245,8 @@ namespace swarmc::Runtime::RedisDriver {
             );
             if ( cursor == 0 ) break;
         }
-        for ( const auto& key : keys ) {
-            _redis->del(key);
+        if ( !keys.empty() ) {
+            _redis->del(keys.begin(), keys.end());
         }
     }
 
@@ -140,9 +262,25 @@ namespace swarmc::Runtime::RedisDriver {
         return nullptr;
     }
 
+    void RedisStorageInterface::waitForUnlock(ISA::LocationReference* ref, std::chrono::microseconds timeout) {
+        // BLPOP takes fractional seconds (Redis >= 6), where 0 would mean forever
+        char seconds[32];
+        std::snprintf(seconds, sizeof(seconds), "%.6f", std::max<double>(static_cast<double>(timeout.count()) / 1e6, 0.001));
+        _redis->command<sw::redis::OptionalStringPair>("BLPOP", Configuration::REDIS_PREFIX + "unlocked:" + ref->fqName(), seconds);
+    }
+
     void RedisStorageLock::release() {
         _store->_locks.erase(_loc->fqName());
-        getRedis()->del(Configuration::REDIS_PREFIX + "lock:" + _loc->fqName());
+
+        // Drop the lock and wake one waiting control. The release list only needs to hold a
+        // single token, and expires in case nobody is waiting.
+        auto releaseKey = Configuration::REDIS_PREFIX + "unlocked:" + _loc->fqName();
+        getRedis()->pipeline(false)
+            .del(Configuration::REDIS_PREFIX + "lock:" + _loc->fqName())
+            .lpush(releaseKey, "1")
+            .ltrim(releaseKey, 0, 0)
+            .expire(releaseKey, 1)
+            .exec();
     }
 
     void RedisQueue::setContext(QueueContextID context) {
@@ -159,6 +297,7 @@ namespace swarmc::Runtime::RedisDriver {
     }
 
     IQueueJob* RedisQueue::build(VirtualMachine* vm, IFunctionCall* call) {
+        publishProgram(vm->getState()->program(), vm);
         auto id = _redis->incr(Configuration::REDIS_PREFIX + "nextJobID");
         auto dummyLocal = ISA::LocationReference(ISA::Affinity::LOCAL, "dummy");
         return new RedisQueueJob(
@@ -173,22 +312,25 @@ namespace swarmc::Runtime::RedisDriver {
     void RedisQueue::push(VirtualMachine* vm, IQueueJob* job) {
         // We should only accept RedisQueueJobs anyway, cast so I can get its important members
         auto rjob = dynamic_cast<RedisQueueJob*>(job);
-        // convert binn to strings to be pushed to redis
-        std::string callstr((char*)binn_ptr(rjob->getCallBinn()), binn_size(rjob->getCallBinn()));
-        std::string statestr((char*)binn_ptr(rjob->getStateBinn()), binn_size(rjob->getStateBinn()));
-        std::string scopestr((char*)binn_ptr(rjob->getScopeBinn()), binn_size(rjob->getScopeBinn()));
-        std::string storestr((char*)binn_ptr(rjob->getLocalStoreBinn()), binn_size(rjob->getLocalStoreBinn()));
-
-        std::unordered_map<std::string, std::string> m = {
-            {"ID", s(job->id())},
-            {"Call", callstr},
-            {"VMState", statestr},
-            {"VMScope", scopestr},
-            {"LocalStore", storestr}
+        auto id = s(job->id());
+
+        // The serialized fields are passed straight from the job's binn buffers
+        std::vector<std::pair<sw::redis::StringView, sw::redis::StringView>> m = {
+            {"ID", id},
+            {"Context", _context},
+            {"Call", binnView(rjob->getCallBinn())},
+            {"VMState", binnView(rjob->getStateBinn())},
+            {"VMScope", binnView(rjob->getScopeBinn())},
+            {"LocalStore", binnView(rjob->getLocalStoreBinn())}
         };
-        _redis->hset(Configuration::REDIS_PREFIX + "job_" + m["ID"], m.begin(), m.end());
-        _redis->set(Configuration::REDIS_PREFIX + "status_" + m["ID"], s(JobState::PENDING), Configuration::REDIS_DEFAULT_TLL);
-        _redis->lpush(Configuration::REDIS_PREFIX + "queue_" + _context, Configuration::REDIS_PREFIX + "job_" + m["ID"]);
+
+        // Write the payload and enqueue the job atomically, so workers never see a queued job without its payload
+        _redis->transaction(true, false)
+            .hset(rjob->key(), m.begin(), m.end())
+            .set(Configuration::REDIS_PREFIX + "status_" + id, s(JobState::PENDING), std::chrono::milliseconds(Configuration::REDIS_DEFAULT_TLL))
+            .lpush(Configuration::REDIS_PREFIX + "queue_" + _context, rjob->key())
+            .lpush(Configuration::REDIS_PREFIX + "ready", _context)
+            .exec();
     }
 
     IQueueJob* RedisQueue::pop() {
@@ -196,23 +338,52 @@ namespace swarmc::Runtime::RedisDriver {
     }
 
     bool RedisQueue::isEmpty(QueueContextID id) {
-        return !_redis->exists(Configuration::REDIS_PREFIX + "queue_" + id) && finished(id);
+        auto replies = _redis->pipeline(false)
+            .exists(Configuration::REDIS_PREFIX + "queue_" + id)
+            .hget(Configuration::REDIS_PREFIX + "contextProgress", id)
+            .exec();
+
+        return replies.get<long long>(0) == 0 && replies.get<sw::redis::OptionalString>(1).value_or("0") == "0";
     }
 
     void RedisQueue::tick() {
+        reapExpiredLeases();
         tryToProcessJob();
         Framework::tick();
     }
 
+    void RedisQueue::waitForJob() {
+        announceWorker();
+
+        // Every pushed job adds its context to the ready list, so there is at least one entry
+        // per queued job. An entry can be stale (e.g. the job was already run by a tick()),
+        // in which case we come up empty and go back to blocking.
+        auto ready = _redis->brpop(Configuration::REDIS_PREFIX + "ready", Configuration::WAITER_BLOCK_S);
+        if ( ready ) {
+            tryToProcessJob(popJob(ready->second, true, true, false));
+        } else {
+            reapExpiredLeases();
+        }
+
+        Framework::tick();
+    }
+
     void RedisQueue::tryToProcessJob() {
-        auto job = tryGetJob();
+        tryToProcessJob(tryGetJob());
+    }
+
+    void RedisQueue::tryToProcessJob(const std::pair<IQueueJob*, QueueContextID>& job) {
         // we have to restore the vm, so we need a Jobject that contains State and ScopeFrame info
         auto rjob = dynamic_cast<RedisQueueJob*>(job.first);
 
         if ( job.first != nullptr ) {
             _vm->enterQueueContext(job.second);
+
+            // Keep our lease on the job alive while it runs, so it isn't handed to another worker
+            _heartbeat.hold(rjob->lease());
             try {
                 Console::get()->debug("Running job: " + s(rjob));
+                loadProgram(rjob->getStateBinn(), _vm);
 
                 ISA::Reference* ret = nullptr;
                 _vm->copy([rjob, &ret](VirtualMachine* vm) -> void {
@@ -226,72 +397,291 @@ namespace swarmc::Runtime::RedisDriver {
                     }
                 });
 
-                setJobReturn(job.second, rjob->id(), ret);
-                rjob->setState(JobState::COMPLETE);
+                completeJob(rjob, job.second, JobState::COMPLETE, ret);
             } catch (Errors::SwarmError& e) {
                 Console::get()->error(e.what());
-                rjob->setState(JobState::ERROR);
+                completeJob(rjob, job.second, JobState::ERROR, nullptr);
             }
+            _heartbeat.release(rjob->lease());
             _vm->exitQueueContext();
-            _redis->hincrby(Configuration::REDIS_PREFIX + "contextProgress", job.second, -1);
             delete rjob;
         }
     }
 
     std::pair<IQueueJob*, QueueContextID> RedisQueue::tryGetJob() {
-        // attempt popping from context
-        auto incontext = popFromContext(_context);
-        std::string contextProgress = Configuration::REDIS_PREFIX + "contextProgress";
-        if ( !incontext ) {
-            // scan for other contexts
-            auto cursor = 0LL;
-            while ( true ) {
-                std::vector<std::string> contexts;
-                cursor = _redis->hscan(
-                    contextProgress,
-                    cursor,
-                    "*",
-                    10,
-                    std::inserter(contexts, contexts.begin())
-                );
-                for ( auto context : contexts ) {
-                    if ( auto job = popFromContext(context) ) {
-                        _redis->hincrby(contextProgress, context, 1);
-                        return { job, context };
-                    }
-                }
-                if ( cursor == 0 ) break;
+        // Prefer the current context, but fall back to jobs from any other context
+        return popJob(_context, true, true, true);
+    }
+
+    IQueueJob* RedisQueue::popFromContext(const QueueContextID& context) {
+        return popJob(context, false, false, true).first;
+    }
+
+    const std::string RedisQueue::POP_JOB_SCRIPT = R"(
+        redis.replicate_commands()
+        local time = redis.call('TIME')
+        local now = tonumber(time[1]) * 1000 + math.floor(tonumber(time[2]) / 1000)
+
+        local function pop(context)
+            local job = redis.call('RPOP', ARGV[1] .. 'queue_' .. context)
+            if not job then return nil end
+            local lease = ''
+            if ARGV[4] == '1' then
+                lease = job .. '#' .. redis.call('INCR', ARGV[1] .. 'leaseAttempts')
+                redis.call('HINCRBY', KEYS[1], context, 1)
+                redis.call('ZADD', KEYS[3], now + tonumber(ARGV[6]), lease)
+            end
+            if ARGV[5] == '1' then redis.call('RPOP', KEYS[2]) end
+            local fields = redis.call('HGETALL', job)
+            table.insert(fields, 1, lease)
+            table.insert(fields, 1, context)
+            return fields
+        end
+
+        local found = pop(ARGV[2])
+        if found then return found end
+        if ARGV[3] ~= '1' then return {} end
+
+        for _, context in ipairs(redis.call('HKEYS', KEYS[1])) do
+            if context ~= ARGV[2] then
+                found = pop(context)
+                if found then return found end
+            end
+        end
+        return {}
+    )";
+
+    std::pair<IQueueJob*, QueueContextID> RedisQueue::popJob(const QueueContextID& context, bool anyContext, bool track, bool consumeReady) {
+        // Reply is [context, lease, field1, value1, field2, value2, ...], or empty if there was no job
+        std::vector<std::string> reply;
+        _redis->eval(
+            POP_JOB_SCRIPT,
+            {Configuration::REDIS_PREFIX + "contextProgress", Configuration::REDIS_PREFIX + "ready", Configuration::REDIS_PREFIX + "leases"},
+            {
+                Configuration::REDIS_PREFIX, context, anyContext ? "1" : "0", track ? "1" : "0",
+                consumeReady ? "1" : "0", s(Configuration::REDIS_LEASE_MS),
+            },
+            std::back_inserter(reply)
+        );
+
+        if ( reply.empty() ) return { nullptr, context };
+
+        // The job keeps the payload strings and opens its binn containers directly over them
+        std::unordered_map<std::string, std::string> jobValues;
+        for ( std::size_t i = 2; i + 1 < reply.size(); i += 2 ) {
+            jobValues[std::move(reply[i])] = std::move(reply[i + 1]);
+        }
+
+        auto id = static_cast<JobID>(std::atoi(jobValues["ID"].c_str()));
+        return { new RedisQueueJob(id, std::move(jobValues), std::move(reply[1])), reply[0] };
+    }
+
+    void RedisQueue::publishProgram(Program* program, VirtualMachine* vm) {
+        if ( !program->imageHash().empty() ) return;
+
+        RedisBinn image(Wire::programs()->reduce(program, vm));
+        auto hash = contentHash(image.view());
+        _redis->setnx(Configuration::REDIS_PREFIX + "program_" + hash, image.view());
+        program->remember(hash);
+    }
+
+    void RedisQueue::loadProgram(binn* state, VirtualMachine* vm) {
+        auto hash = binn_map_str(state, BC_PROGRAM);
+        if ( hash == nullptr || Program::loaded(hash) != nullptr ) return;
+
+        RedisBinn image(_redis->get(Configuration::REDIS_PREFIX + "program_" + hash));
+        if ( !image ) throw Errors::SwarmError("Unable to find program image: " + std::string(hash));
+
+        Console::get()->debug("Loading program image: " + std::string(hash));
+        auto program = useref(Wire::programs()->produce(image.get(), vm));
+        program->remember(hash);
+        freeref(program);
+    }
+
+    void RedisQueue::setJobReturn(QueueContextID qid, JobID id, ISA::Reference* value) {
+        if ( value == nullptr ) {
+            Console::get()->debug("Job with ID " + s(id) + " returned");
+            return;
+        }
+        Console::get()->debug("Job with ID " + s(id) + " returned with value " + s(value) + " in context " + s(qid));
+
+        _redis->hset(qid, s(id), redisSerialize(value, _vm).view());
+    }
+
+    const std::string RedisQueue::COMPLETE_JOB_SCRIPT = R"(
+        if redis.call('ZREM', KEYS[1], ARGV[1]) == 0 then return 0 end
+        if ARGV[6] == '1' then redis.call('HSET', KEYS[4], ARGV[3], ARGV[7]) end
+        redis.call('SET', KEYS[3], ARGV[4], 'PX', ARGV[5])
+        redis.call('HINCRBY', KEYS[2], ARGV[2], -1)
+        return 1
+    )";
+
+    void RedisQueue::completeJob(RedisQueueJob* job, const QueueContextID& qid, JobState state, ISA::Reference* value) {
+        if ( state == JobState::COMPLETE ) {
+            if ( value == nullptr ) {
+                Console::get()->debug("Job with ID " + s(job->id()) + " returned");
+            } else {
+                Console::get()->debug("Job with ID " + s(job->id()) + " returned with value " + s(value) + " in context " + s(qid));
+            }
+        }
+
+        // Record the result and mark the job done in one round-trip, but only if we still hold the
+        // job's lease. If it expired and the job was handed to another worker, that run counts instead,
+        // and its lease (a different attempt of the same job) is left alone.
+        // (The return value is written before the in-progress count drops, so drain() sees it.)
+        RedisBinn serialized(value == nullptr ? nullptr : Wire::references()->reduce(value, _vm));
+        auto completed = _redis->eval<long long>(
+            COMPLETE_JOB_SCRIPT,
+            {
+                Configuration::REDIS_PREFIX + "leases",
+                Configuration::REDIS_PREFIX + "contextProgress",
+                Configuration::REDIS_PREFIX + "status_" + s(job->id()),
+                qid,
+            },
+            {
+                job->lease(), qid, s(job->id()), s(state), s(Configuration::REDIS_DEFAULT_TLL),
+                value == nullptr ? "0" : "1", value == nullptr ? sw::redis::StringView() : serialized.view(),
             }
-            return { nullptr, _context };
+        );
+
+        if ( !completed ) {
+            Console::get()->warn("Lost the lease on job " + s(job->id()) + " before it finished; discarding its result");
         }
-        _redis->hincrby(contextProgress, _context, 1);
-        return { incontext, _context };
     }
 
-    IQueueJob* RedisQueue::popFromContext(const QueueContextID& context) {
-        auto job = _redis->rpop(Configuration::REDIS_PREFIX + "queue_" + context);
-        if ( !job ) return nullptr;
-        std::map<std::string, std::string> jobValues;
-        _redis->hgetall(job.value(), std::inserter(jobValues, jobValues.begin()));
-        // for ( const auto& p : jobValues ) {
-        //     _redis->hdel(job.value(), p.first);
-        // }
-
-        auto qjob = new RedisQueueJob(
-            static_cast<JobID>(std::atoi(jobValues["ID"].c_str())),
-            redisRead(jobValues["Call"]),
-            redisRead(jobValues["VMState"]),
-            redisRead(jobValues["VMScope"]),
-            redisRead(jobValues["LocalStore"])
+    const std::string RedisQueue::REAP_LEASES_SCRIPT = R"(
+        redis.replicate_commands()
+        local time = redis.call('TIME')
+        local now = tonumber(time[1]) * 1000 + math.floor(tonumber(time[2]) / 1000)
+
+        local expired = redis.call('ZRANGEBYSCORE', KEYS[1], '-inf', now)
+        for _, lease in ipairs(expired) do
+            redis.call('ZREM', KEYS[1], lease)
+            local job = string.match(lease, '^(.*)#%d+$') or lease
+            local context = redis.call('HGET', job, 'Context')
+            if context then
+                redis.call('HINCRBY', KEYS[2], context, -1)
+                redis.call('RPUSH', ARGV[1] .. 'queue_' .. context, job)
+                redis.call('LPUSH', KEYS[3], context)
+            end
+        end
+        return #expired
+    )";
+
+    void RedisQueue::reapExpiredLeases() {
+        auto now = std::chrono::steady_clock::now();
+        if ( now - _lastReap < std::chrono::milliseconds(Configuration::REDIS_LEASE_MS / 2) ) return;
+        _lastReap = now;
+
+        auto reaped = _redis->eval<long long>(
+            REAP_LEASES_SCRIPT,
+            {
+                Configuration::REDIS_PREFIX + "leases",
+                Configuration::REDIS_PREFIX + "contextProgress",
+                Configuration::REDIS_PREFIX + "ready",
+            },
+            {Configuration::REDIS_PREFIX}
+        );
+
+        if ( reaped > 0 ) {
+            Console::get()->warn("Re-queued " + s(reaped) + " job(s) whose worker stopped renewing its lease");
+        }
+    }
+
+    const std::string RedisQueue::ANNOUNCE_WORKER_SCRIPT = R"(
+        redis.replicate_commands()
+        local time = redis.call('TIME')
+        local now = tonumber(time[1]) * 1000 + math.floor(tonumber(time[2]) / 1000)
+        redis.call('ZADD', KEYS[1], now, ARGV[1])
+        return 1
+    )";
+
+    void RedisQueue::announceWorker() {
+        auto now = std::chrono::steady_clock::now();
+        if ( now - _lastAnnounce < std::chrono::milliseconds(Configuration::REDIS_LEASE_MS / 2) ) return;
+        _lastAnnounce = now;
+
+        _redis->eval<long long>(
+            ANNOUNCE_WORKER_SCRIPT,
+            {Configuration::REDIS_PREFIX + "workers"},
+            {_vm->global()->getNodeId()}
+        );
+    }
+
+    const std::string RedisQueue::COUNT_WORKERS_SCRIPT = R"(
+        redis.replicate_commands()
+        local time = redis.call('TIME')
+        local now = tonumber(time[1]) * 1000 + math.floor(tonumber(time[2]) / 1000)
+        redis.call('ZREMRANGEBYSCORE', KEYS[1], '-inf', now - tonumber(ARGV[1]))
+        return redis.call('ZCARD', KEYS[1])
+    )";
+
+    std::size_t RedisQueue::workerCount() {
+        auto workers = _redis->eval<long long>(
+            COUNT_WORKERS_SCRIPT,
+            {Configuration::REDIS_PREFIX + "workers"},
+            {s(Configuration::REDIS_WORKER_TIMEOUT_MS)}
         );
 
-        return qjob;
+        return std::max<std::size_t>(1, static_cast<std::size_t>(std::max<long long>(0, workers)));
+    }
+
+    const std::string LeaseHeartbeat::RENEW_LEASE_SCRIPT = R"(
+        redis.replicate_commands()
+        if not redis.call('ZSCORE', KEYS[1], ARGV[1]) then return 0 end
+        local time = redis.call('TIME')
+        local now = tonumber(time[1]) * 1000 + math.floor(tonumber(time[2]) / 1000)
+        redis.call('ZADD', KEYS[1], 'XX', now + tonumber(ARGV[2]), ARGV[1])
+        return 1
+    )";
+
+    void LeaseHeartbeat::hold(const std::string& lease) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _leases.insert(lease);
+        if ( _thread.joinable() ) return;
+
+        _refCounts.emplace();
+        _thread = std::thread([this]() { renewUntilStopped(); });
+    }
+
+    void LeaseHeartbeat::release(const std::string& lease) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _leases.erase(lease);
+    }
+
+    void LeaseHeartbeat::renewUntilStopped() {
+        auto interval = std::chrono::milliseconds(Configuration::REDIS_LEASE_MS / 3);
+        while ( true ) {
+            std::vector<std::string> leases;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if ( _condition.wait_for(lock, interval, [this]() { return _stopped; }) ) return;
+                leases.assign(_leases.begin(), _leases.end());
+            }
+
+            // Talk to Redis without holding the lock, so starting/finishing jobs never waits on it.
+            // A failed renewal is retried next interval; the lease only lapses if they keep failing.
+            for ( const auto& lease : leases ) {
+                try {
+                    getRedis()->eval<long long>(
+                        RENEW_LEASE_SCRIPT,
+                        {Configuration::REDIS_PREFIX + "leases"},
+                        {lease, s(Configuration::REDIS_LEASE_MS)}
+                    );
+                } catch (sw::redis::Error& e) {
+                    Console::get()->warn("Unable to renew lease " + lease + ": " + e.what());
+                }
+            }
+        }
     }
 
-    bool RedisQueue::finished(const QueueContextID& context) {
-        // return true if inProgress is 0 or if context doesnt exist
-        auto val = _redis->hget(Configuration::REDIS_PREFIX + "contextProgress", context);
-        return val.value_or("0") == "0";
+    LeaseHeartbeat::~LeaseHeartbeat() {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _stopped = true;
+        }
+        _condition.notify_all();
+        if ( _thread.joinable() ) _thread.join();
     }
 
     Stream::~Stream() noexcept {
@@ -310,10 +700,8 @@ namespace swarmc::Runtime::RedisDriver {
     }
 
     void Stream::setKeys() {
-        auto bin = Wire::types()->reduce(_innerType, _vm);
-        std::string s((char*)binn_ptr(bin), binn_size(bin));
-
-        if ( _redis->setnx(Configuration::REDIS_PREFIX + _id + "_type", s) ) {
+        RedisBinn type(Wire::types()->reduce(_innerType, _vm));
+        if ( _redis->setnx(Configuration::REDIS_PREFIX + _id + "_type", type.view()) ) {
             _redis->setnx(Configuration::REDIS_PREFIX + _id + "_open", "true");
         }
     }
@@ -324,15 +712,13 @@ namespace swarmc::Runtime::RedisDriver {
     }
 
     void Stream::push(ISA::Reference* val) {
-        auto bin = Wire::references()->reduce(val, _vm);
-        std::string s((char*)binn_ptr(bin), binn_size(bin));
-        _redis->lpush(Configuration::REDIS_PREFIX + _id, s);
+        _redis->lpush(Configuration::REDIS_PREFIX + _id, redisSerialize(val, _vm).view());
     }
 
     ISA::Reference* Stream::pop() {
         assert(!isEmpty());
-        auto ref = redisRead(_redis->rpop(Configuration::REDIS_PREFIX + _id));
-        return Wire::references()->produce(ref, _vm);
+        RedisBinn ref(_redis->rpop(Configuration::REDIS_PREFIX + _id));
+        return Wire::references()->produce(ref.get(), _vm);
     }
 
     std::string Stream::toString() const {
@@ -1,6 +1,12 @@
 #ifndef SWARMVM_REDIS_DRIVER_H
 #define SWARMVM_REDIS_DRIVER_H
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <thread>
 #include <sw/redis++/redis++.h>
 #include "interfaces.h"
 #include "single_threaded.h"
@@ -17,7 +23,48 @@ namespace swarmc::Runtime::RedisDriver {
     sw::redis::Redis* getRedis();
     bool redisSet(const std::string&, ISA::Reference*, VirtualMachine*);
     bool redisSet(const std::string&, Type::Type*, VirtualMachine*);
-    binn* redisRead(sw::redis::OptionalString);
+
+    /** View the serialized bytes of a binn container, e.g. to pass as a Redis command argument without copying. */
+    sw::redis::StringView binnView(binn*);
+
+    /**
+     * A binn container read from or written to Redis, along with the memory backing it.
+     * Reads open the container in-place over the reply, and writes pass the container's
+     * own buffer as the command argument, so payloads are never copied into intermediate
+     * buffers. The container is freed when this goes out of scope.
+     */
+    class RedisBinn {
+    public:
+        /** Take ownership of a container, e.g. one built by a Wire reducer. */
+        explicit RedisBinn(binn* obj) : _binn(obj) {}
+
+        /** Open a container over a Redis reply. The reply is kept alive as long as this is. */
+        explicit RedisBinn(sw::redis::OptionalString reply) : _reply(std::move(reply)) {
+            if ( _reply ) _binn = binn_open(_reply->data());
+        }
+
+        RedisBinn(const RedisBinn&) = delete;
+        RedisBinn& operator=(const RedisBinn&) = delete;
+
+        ~RedisBinn() {
+            if ( _binn != nullptr ) binn_free(_binn);
+        }
+
+        [[nodiscard]] binn* get() const { return _binn; }
+
+        explicit operator bool() const { return _binn != nullptr; }
+
+        [[nodiscard]] sw::redis::StringView view() const { return binnView(_binn); }
+    protected:
+        sw::redis::OptionalString _reply;
+        binn* _binn = nullptr;
+    };
+
+    RedisBinn redisSerialize(ISA::Reference*, VirtualMachine*);
+    RedisBinn redisSerialize(Type::Type*, VirtualMachine*);
+
+    /** Compute a stable hash of some serialized data, used to name content-addressed keys (e.g. program images). */
+    std::string contentHash(sw::redis::StringView);
 
     class GlobalServices : public SingleThreaded::GlobalServices {
     public:
@@ -66,11 +113,23 @@ namespace swarmc::Runtime::RedisDriver {
 
         virtual IStorageLock* acquire(ISA::LocationReference*) override;
 
+        /** Blocks on the location's release list (see RedisStorageLock::release) instead of polling the lock. */
+        void waitForUnlock(ISA::LocationReference*, std::chrono::microseconds timeout) override;
+
         /** Forget all stored variables. */
         virtual void clear() override;
 
         virtual IStorageInterface* copy() override;
 
+        [[nodiscard]] bool supportsAtomicUpdates() const override { return true; }
+
+        /**
+         * Arithmetic on numbers runs as a Lua script on the server. Other updates read the value,
+         * apply the change here, and write it back only if the value is unchanged (compare-and-set).
+         * Both fail (and are retried) while another control holds the location's lock.
+         */
+        ISA::Reference* update(ISA::LocationReference*, AtomicOp, ISA::Reference* operand, const AtomicApply& apply) override;
+
         [[nodiscard]] virtual serial::tag_t getSerialKey() const override { return "swarm::RedisDriver::RedisStorageInterface"; }
 
         [[nodiscard]] std::string toString() const override {
@@ -81,6 +140,15 @@ namespace swarmc::Runtime::RedisDriver {
         VirtualMachine* _vm;
         std::unordered_map<std::string, RedisStorageLock*> _locks;
 
+        /**
+         * Values are stored serialized, except numbers, which are stored as `#` followed by their
+         * decimal text so server-side scripts can do arithmetic on them.
+         */
+        ISA::Reference* decode(const std::string&);
+
+        static const std::string ATOMIC_ARITHMETIC_SCRIPT;
+        static const std::string COMPARE_AND_SET_SCRIPT;
+
         friend class RedisStorageLock;
     };
 
@@ -105,6 +173,18 @@ namespace swarmc::Runtime::RedisDriver {
         RedisQueueJob(JobID id, binn* call, binn* vmState, binn* vmScope, binn* localStore)
             : _id(id), _call(call), _vmState(vmState), _vmScope(vmScope), _localStore(localStore) {}
 
+        /**
+         * Create a job from the fields of its payload hash. The serialized fields are opened in-place.
+         * `lease` is the member of the leases set held for this attempt at the job, if it was leased.
+         */
+        RedisQueueJob(JobID id, std::unordered_map<std::string, std::string> payload, std::string lease)
+            : _id(id), _lease(std::move(lease)), _payload(std::move(payload)) {
+            _call = openField("Call");
+            _vmState = openField("VMState");
+            _vmScope = openField("VMScope");
+            _localStore = openField("LocalStore");
+        }
+
         ~RedisQueueJob() {
             binn_free(_call);
             binn_free(_vmState);
@@ -115,6 +195,12 @@ namespace swarmc::Runtime::RedisDriver {
         /** Get the tracking ID for this job. */
         [[nodiscard]] virtual JobID id() const override { return _id; };
 
+        /** Get the Redis key holding this job's payload. */
+        [[nodiscard]] std::string key() const { return Configuration::REDIS_PREFIX + "job_" + s(_id); }
+
+        /** Get the lease held on this attempt at the job (`<key>#<attempt>`), or "" if it wasn't leased. */
+        [[nodiscard]] const std::string& lease() const { return _lease; }
+
         /** Get the current status of this job. */
         [[nodiscard]] virtual JobState state() const override { 
             auto state = getRedis()->get(Configuration::REDIS_PREFIX + "status_" + s(_id));
@@ -145,12 +231,54 @@ namespace swarmc::Runtime::RedisDriver {
         }
     protected:
         JobID _id;
-        binn* _call;
-        binn* _vmState;
-        binn* _vmScope;
-        binn* _localStore;
+        std::string _lease;
+        binn* _call = nullptr;
+        binn* _vmState = nullptr;
+        binn* _vmScope = nullptr;
+        binn* _localStore = nullptr;
+
+        /** The payload fields as read from Redis, which back the binn containers above. */
+        std::unordered_map<std::string, std::string> _payload;
 
         SchedulingFilters _filters;
+
+        binn* openField(const std::string& name) {
+            auto field = _payload.find(name);
+            if ( field == _payload.end() ) return nullptr;
+            return binn_open(field->second.data());
+        }
+    };
+
+    /**
+     * Renews the leases a worker holds on the jobs it is running, from one background thread per
+     * worker. Leases that stop being renewed (e.g. because the worker died) are re-queued by the
+     * next RedisQueue to reap them.
+     */
+    class LeaseHeartbeat {
+    public:
+        LeaseHeartbeat() = default;
+
+        ~LeaseHeartbeat();
+
+        /** Start renewing the given lease, starting the renewal thread if it isn't running yet. */
+        void hold(const std::string& lease);
+
+        /** Stop renewing the given lease. */
+        void release(const std::string& lease);
+
+    protected:
+        std::optional<nslib::IRefCountable::HelperThread> _refCounts;  // outlives _thread; see IRefCountable
+        std::thread _thread;
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        std::set<std::string> _leases;
+        bool _stopped = false;
+
+        /** Body of the renewal thread. Renews every held lease each REDIS_LEASE_MS / 3 until stopped. */
+        void renewUntilStopped();
+
+        /** Lua script which extends a lease, if it is still held. */
+        static const std::string RENEW_LEASE_SCRIPT;
     };
 
     class RedisQueue : public IQueue {
@@ -185,35 +313,36 @@ namespace swarmc::Runtime::RedisDriver {
 
         virtual void tick() override;
 
+        /**
+         * Block on the ready list until a job is pushed (or WAITER_BLOCK_S passes), then run it.
+         * This way, idle workers don't issue any Redis commands besides the blocking pop.
+         */
+        virtual void waitForJob() override;
+
+        /**
+         * Count the workers which announced themselves (see `waitForJob`) recently. Workers busy with
+         * a single job for longer than REDIS_WORKER_TIMEOUT_MS drop out of the count until it finishes.
+         */
+        virtual std::size_t workerCount() override;
+
         void initialize() {
             _redis->setnx(Configuration::REDIS_PREFIX + "nextJobID", "0");
         }
 
-        virtual void setJobReturn(QueueContextID qid, JobID id, ISA::Reference* value) override {
-            if ( value == nullptr ) {
-                Console::get()->debug("Job with ID " + s(id) + " returned");
-                return;
-            }
-            Console::get()->debug("Job with ID " + s(id) + " returned with value " + s(value) + " in context " + s(qid));
-            
-            auto refbin = Wire::references()->reduce(value, _vm);
-            std::string refstr((char*) binn_ptr(refbin), binn_size(refbin));
-            binn_free(refbin);
-            _redis->hset(qid, s(id), refstr);
-        }
+        virtual void setJobReturn(QueueContextID qid, JobID id, ISA::Reference* value) override;
 
         const ReturnMap getJobReturns(QueueContextID qid) override {
             std::unordered_map<std::string, std::string> map;
             ReturnMap deserialMap;
 
             _redis->hgetall(qid, std::inserter(map, map.begin()));
-            for ( auto p : map ) {
+            for ( auto& p : map ) {
                 std::size_t jobId;
                 sscanf(p.first.c_str(), "%zu", &jobId);
-                auto retbinn = redisRead(p.second);
+                RedisBinn retbinn(std::move(p.second));
                 deserialMap.insert({
                     static_cast<JobID>(jobId), 
-                    Wire::references()->produce(retbinn, _vm)
+                    Wire::references()->produce(retbinn.get(), _vm)
                 });
             }
 
@@ -227,12 +356,68 @@ namespace swarmc::Runtime::RedisDriver {
         sw::redis::Redis* _redis;
         VirtualMachine* _vm;
         QueueContextID _context;
+        LeaseHeartbeat _heartbeat;
+
+        /**
+         * Lua script which pops a job (optionally from any context), marks it in progress, and returns its fields.
+         * Jobs popped to be run are leased to the caller for REDIS_LEASE_MS (see `LeaseHeartbeat`). Each lease
+         * is a `<key>#<attempt>` member of the leases set, so a worker whose lease expired can't touch the next one.
+         */
+        static const std::string POP_JOB_SCRIPT;
 
         void tryToProcessJob();
+        void tryToProcessJob(const std::pair<IQueueJob*, QueueContextID>&);
         std::pair<IQueueJob*, QueueContextID> tryGetJob();
-        IQueueJob* popFromContext(const QueueContextID&);
 
-        bool finished(const QueueContextID& context);
+        /**
+         * Atomically pop the next job from the given context (or, if `anyContext`, from any context
+         * if that one is empty) and fetch its payload in a single round-trip. If `track`, the job is
+         * also counted as in progress in its context. If `consumeReady`, an entry is removed from the
+         * ready list to account for the job (callers who got here through the ready list already did).
+         */
+        std::pair<IQueueJob*, QueueContextID> popJob(const QueueContextID&, bool anyContext, bool track, bool consumeReady);
+
+        /**
+         * Record a job's result, mark it finished, and release its lease. Jobs can run more than once
+         * if their lease expires, so this does nothing if the lease was lost (i.e. it is idempotent).
+         */
+        void completeJob(RedisQueueJob*, const QueueContextID&, JobState, ISA::Reference*);
+
+        /** Lua script which completes a job if the caller still holds its lease. */
+        static const std::string COMPLETE_JOB_SCRIPT;
+
+        /**
+         * Re-queue any jobs whose lease has expired, e.g. because their worker crashed.
+         * This is cheap to call often, since it only talks to Redis every REDIS_LEASE_MS / 2.
+         */
+        void reapExpiredLeases();
+
+        /** Lua script which re-queues jobs with expired leases. */
+        static const std::string REAP_LEASES_SCRIPT;
+
+        std::chrono::steady_clock::time_point _lastReap;
+
+        /** Record that this worker is alive, for `workerCount`. Only talks to Redis every REDIS_LEASE_MS / 2. */
+        void announceWorker();
+
+        /** Lua script which marks a worker as seen now, by the Redis server's clock. */
+        static const std::string ANNOUNCE_WORKER_SCRIPT;
+
+        /** Lua script which forgets workers not seen within ARGV[1] ms, then counts the rest. */
+        static const std::string COUNT_WORKERS_SCRIPT;
+
+        std::chrono::steady_clock::time_point _lastAnnounce;
+
+        /**
+         * Publish the image of the given program under its content hash, if it hasn't been already.
+         * This is done once per program, after which jobs only carry the hash.
+         */
+        void publishProgram(Program*, VirtualMachine*);
+
+        /** Make sure the program referenced by a serialized State is loaded in this process. */
+        void loadProgram(binn* state, VirtualMachine*);
+
+        IQueueJob* popFromContext(const QueueContextID&);
     };
 
     class Stream : public IStream {
@@ -53,6 +53,8 @@ namespace swarmc::Runtime {
 
         [[nodiscard]] serial::tag_t getSerialKey() const override { return s(_backend); }
 
+        [[nodiscard]] serial::index_t getSerialIndex() const override { return static_cast<serial::index_t>(_backend); }
+
         /** Get the parameters already applied to this function call, paired with thier types. */
         [[nodiscard]] virtual CallVector vector() const { return _vector; }
 
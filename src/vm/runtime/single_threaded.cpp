@@ -7,30 +7,91 @@
 
 namespace swarmc::Runtime::SingleThreaded {
 
+    StorageInterface::Layer::Layer(SlotMap<Slot> slots, Layer* parent) :
+        _slots(std::move(slots)), _parent(useref(parent)),
+        _depth(parent == nullptr ? 1 : parent->depth() + 1) {}
+
+    StorageInterface::Layer::~Layer() noexcept {
+        _slots.forEach([](std::size_t, const Slot& slot) {
+            freeref(slot.loc);
+            freeref(slot.value);
+            freeref(slot.type);
+        });
+
+        freeref(_parent);
+    }
+
+    const StorageInterface::Slot* StorageInterface::Layer::find(std::size_t slot) const {
+        for ( auto layer = this; layer != nullptr; layer = layer->_parent ) {
+            if ( auto entry = layer->_slots.find(slot) ) return entry;
+        }
+
+        return nullptr;
+    }
+
     StorageInterface::~StorageInterface() noexcept {
-        for ( const auto& e : _map ) freeref(e.second);
-        for ( const auto& e : _types ) freeref(e.second);
+        clear();
         for ( const auto& e : _locks ) freeref(e.second);
     }
 
+    const StorageInterface::Slot* StorageInterface::lookup(ISA::LocationReference* loc) const {
+        if ( auto slot = _slots.find(loc->slot()) ) return slot;
+        if ( _base == nullptr ) return nullptr;
+        return _base->find(loc->slot());
+    }
+
+    StorageInterface::Slot& StorageInterface::slotFor(ISA::LocationReference* loc) {
+        if ( auto slot = _slots.find(loc->slot()) ) return *slot;
+
+        // The entry may be shared with another store, so write to our own copy of it
+        auto inherited = _base == nullptr ? nullptr : _base->find(loc->slot());
+        auto& slot = _slots[loc->slot()];
+        if ( inherited != nullptr ) {
+            slot.loc = useref(inherited->loc);
+            slot.value = useref(inherited->value);
+            slot.type = useref(inherited->type);
+        } else {
+            slot.loc = useref(loc);
+        }
+
+        return slot;
+    }
+
     ISA::Reference* StorageInterface::load(ISA::LocationReference* loc) {
-        auto iter = _map.find(loc->fqName());
-        if ( iter == _map.end() ) throw Errors::InvalidStoreLocationError(s(loc), s(this));
-        return iter->second;
+        auto slot = lookup(loc);
+        if ( slot == nullptr || slot->value == nullptr ) throw Errors::InvalidStoreLocationError(s(loc), s(this));
+        return slot->value;
     }
 
     void StorageInterface::store(ISA::LocationReference* loc, ISA::Reference* value) {
-        if ( _types.find(loc->fqName()) == _types.end() ) _types[loc->fqName()] = useref(value->type());
-        assert(value->typei()->isAssignableTo(_types[loc->fqName()]));
+        auto& slot = slotFor(loc);
+        if ( slot.type == nullptr ) slot.type = useref(value->type());
+        assert(value->typei()->isAssignableTo(slot.type));
+
+        if ( slot.value == nullptr ) {
+            slot.value = useref(value);
+            _count += 1;
+        } else if ( slot.value != value ) {
+            freeref(slot.value);
+            slot.value = useref(value);
+        }
+    }
+
+    bool StorageInterface::overwriteNumber(ISA::LocationReference* loc, double value) {
+        // Entries in the shared layers may be visible to other stores
+        auto slot = _slots.find(loc->slot());
+        if ( slot == nullptr || slot->value == nullptr || slot->value->tag() != ISA::ReferenceTag::NUMBER ) return false;
 
-        auto existing = _map.find(loc->fqName());
-        if ( existing != _map.end() && existing->second != value ) freeref(existing->second);
+        auto number = (ISA::NumberReference*) slot->value;
+        if ( !number->nslibUniquelyOwned() ) return false;
 
-        _map[loc->fqName()] = useref(value);
+        number->overwrite(value);
+        return true;
     }
 
     bool StorageInterface::has(ISA::LocationReference* loc) {
-        return _map.find(loc->fqName()) != _map.end();
+        auto slot = lookup(loc);
+        return slot != nullptr && slot->value != nullptr;
     }
 
     bool StorageInterface::manages(ISA::LocationReference* loc) {
@@ -38,41 +99,49 @@ namespace swarmc::Runtime::SingleThreaded {
     }
 
     void StorageInterface::drop(ISA::LocationReference* loc) {
-        auto mapIter = _map.find(loc->fqName());
-        if ( mapIter == _map.end() ) return;
-
-        freeref(mapIter->second);
-        _map.erase(mapIter);
-
-        auto typeIter = _types.find(loc->fqName());
-        if ( typeIter != _types.end() ) {
-            freeref(typeIter->second);
-            _types.erase(typeIter);
-        }
+        if ( !has(loc) ) return;
+
+        // Clearing our own copy of the entry also hides the one in the shared layers
+        auto& slot = slotFor(loc);
+        freeref(slot.value);
+        freeref(slot.type);
+        slot.value = nullptr;
+        slot.type = nullptr;
+        _count -= 1;
     }
 
     const Type::Type* StorageInterface::typeOf(ISA::LocationReference* loc) {
-        auto iter = _types.find(loc->fqName());
-        if ( iter == _types.end() ) return nullptr;
-        return iter->second;
+        auto slot = lookup(loc);
+        if ( slot == nullptr ) return nullptr;
+        return slot->type;
     }
 
     void StorageInterface::typify(ISA::LocationReference* loc, Type::Type* type) {
-        _types[loc->fqName()] = useref(type);
+        auto& slot = slotFor(loc);
+        if ( slot.type != type ) {
+            freeref(slot.type);
+            slot.type = useref(type);
+        }
     }
 
     IStorageLock* StorageInterface::acquire(ISA::LocationReference* loc) {
-        if ( _locks.find(loc->fqName()) != _locks.end() ) return nullptr;
-        _locks[loc->fqName()] = useref(new StorageLock(this, loc));
-        return _locks[loc->fqName()];
+        if ( _locks.find(loc->slot()) != _locks.end() ) return nullptr;
+        auto lock = useref(new StorageLock(this, loc));
+        _locks.emplace(loc->slot(), lock);
+        return lock;
     }
 
     void StorageInterface::clear() {
-        for ( const auto& e : _map ) freeref(e.second);
-        _map.clear();
+        _slots.forEach([](std::size_t, const Slot& slot) {
+            freeref(slot.loc);
+            freeref(slot.value);
+            freeref(slot.type);
+        });
 
-        for ( const auto& e : _types ) freeref(e.second);
-        _types.clear();
+        _slots.clear();
+        freeref(_base);
+        _base = nullptr;
+        _count = 0;
     }
 
     IStorageInterface* StorageInterface::copy() {
@@ -80,14 +149,32 @@ namespace swarmc::Runtime::SingleThreaded {
         // so we "copy" a shared variable store by re-using the reference
         if ( _affinity == ISA::Affinity::SHARED ) return this;
 
-        // Otherwise, duplicate the store
-        auto copy = new StorageInterface(_affinity);
+        // Otherwise, freeze our recent writes into a layer that both stores share.
+        // If nothing was written since the last copy, the existing layer is re-used as-is.
+        if ( !_slots.empty() ) {
+            auto layer = useref(new Layer(std::move(_slots), _base));
+            freeref(_base);
+            _base = layer;
+            _slots.clear();
+        }
 
-        copy->_map = _map;
-        for ( const auto& e : copy->_map ) useref(e.second);
+        // Collapse deep chains of layers (e.g. from repeatedly forking in a loop)
+        if ( _base != nullptr && _base->depth() > MAX_LAYER_DEPTH ) {
+            SlotMap<Slot> flat;
+            SlotMap<bool> seen;
+            _base->forEach(seen, [&flat](std::size_t idx, const Slot& slot) {
+                if ( slot.value == nullptr && slot.type == nullptr ) return;  // dropped
+                flat[idx] = Slot{useref(slot.loc), useref(slot.value), useref(slot.type)};
+            });
+
+            auto layer = useref(new Layer(std::move(flat), nullptr));
+            freeref(_base);
+            _base = layer;
+        }
 
-        copy->_types = _types;
-        for ( const auto& e : copy->_types ) useref(e.second);
+        auto copy = new StorageInterface(_affinity);
+        copy->_base = useref(_base);
+        copy->_count = _count;
 
         // (don't duplicate locks, since the recipient won't hold them)
         return copy;
@@ -108,7 +195,7 @@ namespace swarmc::Runtime::SingleThreaded {
     }
 
     void StorageLock::release() {
-        auto lockIter = _store->_locks.find(_loc->fqName());
+        auto lockIter = _store->_locks.find(_loc->slot());
         freeref((*lockIter).second);
         _store->_locks.erase(lockIter);
     }
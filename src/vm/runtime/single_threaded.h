@@ -9,6 +9,7 @@
 #include <unordered_map>
 #include "../../shared/nslib.h"
 #include "interfaces.h"
+#include "slot_map.h"
 
 /*
  * This file contains a single-threaded, synchronous implementation of the
@@ -76,7 +77,14 @@ namespace swarmc::Runtime::SingleThreaded {
     };
 
 
-    /** A single-threaded storage driver using `std::map`. */
+    /**
+     * A single-threaded storage driver keyed by each location's slot number.
+     *
+     * Local stores are copied every time a job is forked off of a VM, so copies are
+     * copy-on-write: `copy()` freezes the entries written since the last copy into an
+     * immutable layer shared by both stores, and each store only duplicates an entry
+     * the first time it writes to it.
+     */
     class StorageInterface : public IStorageInterface {
     public:
         explicit StorageInterface(ISA::Affinity affinity) : _affinity(affinity) {}
@@ -87,6 +95,8 @@ namespace swarmc::Runtime::SingleThreaded {
 
         void store(ISA::LocationReference* loc, ISA::Reference* value) override;
 
+        bool overwriteNumber(ISA::LocationReference* loc, double value) override;
+
         bool has(ISA::LocationReference* loc) override;
 
         bool manages(ISA::LocationReference* loc) override;
@@ -108,14 +118,80 @@ namespace swarmc::Runtime::SingleThreaded {
         [[nodiscard]] virtual serial::tag_t getSerialKey() const override { return "swarm::SingleThreaded::StorageInterface"; }
 
         [[nodiscard]] std::string toString() const override {
-            return "SingleThreaded::StorageInterface<#loc: " + std::to_string(_map.size()) + ">";
+            return "SingleThreaded::StorageInterface<#loc: " + std::to_string(_count) + ">";
         }
 
     protected:
+        /** The value and declared type held for a single location. The location is kept so its name can be serialized. */
+        struct Slot {
+            ISA::LocationReference* loc = nullptr;
+            ISA::Reference* value = nullptr;
+            Type::Type* type = nullptr;
+        };
+
+        /** An immutable set of slots shared by the copies of a store, on top of an older layer. */
+        class Layer : public IRefCountable {
+        public:
+            Layer(SlotMap<Slot> slots, Layer* parent);
+
+            ~Layer() noexcept override;
+
+            /** Find the newest entry for the given slot in this layer or its parents. */
+            [[nodiscard]] const Slot* find(std::size_t slot) const;
+
+            /** Call `callback(slot, value)` for every entry visible from this layer. */
+            template <typename TCallback>
+            void forEach(SlotMap<bool>& seen, TCallback callback) const {
+                for ( auto layer = this; layer != nullptr; layer = layer->_parent ) {
+                    layer->_slots.forEach([&seen, &callback](std::size_t idx, const Slot& slot) {
+                        auto& wasSeen = seen[idx];
+                        if ( wasSeen ) return;
+                        wasSeen = true;
+                        callback(idx, slot);
+                    });
+                }
+            }
+
+            [[nodiscard]] std::size_t depth() const { return _depth; }
+
+        protected:
+            SlotMap<Slot> _slots;
+            Layer* _parent;
+            std::size_t _depth;
+        };
+
+        /** Past this many layers, `copy()` flattens them so reads stay cheap. */
+        static constexpr std::size_t MAX_LAYER_DEPTH = 8;
+
+        /** Get the entry for the given location, or nullptr if there isn't one. */
+        const Slot* lookup(ISA::LocationReference* loc) const;
+
+        /** Get a writable entry for the given location, creating it (or copying it from the shared layers) if necessary. */
+        Slot& slotFor(ISA::LocationReference* loc);
+
+        /** Call `callback(slot, value)` for every entry visible in this store. */
+        template <typename TCallback>
+        void forEachSlot(TCallback callback) const {
+            if ( _base == nullptr ) return _slots.forEach(callback);
+
+            SlotMap<bool> seen;
+            _slots.forEach([&seen, &callback](std::size_t idx, const Slot& slot) {
+                seen[idx] = true;
+                callback(idx, slot);
+            });
+            _base->forEach(seen, callback);
+        }
+
         ISA::Affinity _affinity;
-        std::map<std::string, ISA::Reference*> _map;
-        std::map<std::string, Type::Type*> _types;
-        std::map<std::string, IStorageLock*> _locks;
+
+        /** Entries written by this store since it was last copied. */
+        SlotMap<Slot> _slots;
+
+        /** Entries frozen by earlier copies (may be shared with other stores). */
+        Layer* _base = nullptr;
+
+        std::size_t _count = 0;
+        std::unordered_map<std::size_t, IStorageLock*> _locks;
 
         friend class StorageLock;
         friend class Runtime::Wire;
@@ -0,0 +1,100 @@
+#ifndef SWARMVM_SLOT_MAP
+#define SWARMVM_SLOT_MAP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace swarmc::Runtime {
+
+    /**
+     * A small open-addressing hash table keyed by location slot numbers.
+     *
+     * Variable resolution and local storage do one lookup per instruction operand,
+     * so this keeps entries in a single flat vector (linear probing, power-of-two
+     * capacity) instead of allocating a node per entry like `std::map`/`std::unordered_map`.
+     * Entries are never removed individually; `clear()` drops everything.
+     */
+    template <typename TValue>
+    class SlotMap {
+    public:
+        /** Get the value stored for the given slot, or nullptr if there isn't one. */
+        TValue* find(std::size_t slot) {
+            if ( _entries.empty() ) return nullptr;
+
+            auto mask = _entries.size() - 1;
+            for ( auto i = hash(slot) & mask; ; i = (i + 1) & mask ) {
+                auto& entry = _entries[i];
+                if ( !entry.used ) return nullptr;
+                if ( entry.slot == slot ) return &entry.value;
+            }
+        }
+
+        const TValue* find(std::size_t slot) const {
+            return const_cast<SlotMap<TValue>*>(this)->find(slot);
+        }
+
+        /** Get the value stored for the given slot, default-constructing it if necessary. */
+        TValue& operator[](std::size_t slot) {
+            if ( (_size + 1) * 4 > _entries.size() * 3 ) grow();
+
+            auto mask = _entries.size() - 1;
+            for ( auto i = hash(slot) & mask; ; i = (i + 1) & mask ) {
+                auto& entry = _entries[i];
+                if ( entry.used && entry.slot == slot ) return entry.value;
+                if ( !entry.used ) {
+                    entry.used = true;
+                    entry.slot = slot;
+                    _size += 1;
+                    return entry.value;
+                }
+            }
+        }
+
+        /** Call `callback(slot, value)` for every entry. */
+        template <typename TCallback>
+        void forEach(TCallback callback) const {
+            for ( const auto& entry : _entries ) {
+                if ( entry.used ) callback(entry.slot, entry.value);
+            }
+        }
+
+        [[nodiscard]] std::size_t size() const { return _size; }
+
+        [[nodiscard]] bool empty() const { return _size == 0; }
+
+        void clear() {
+            _entries.clear();
+            _size = 0;
+        }
+
+    protected:
+        struct Entry {
+            std::size_t slot = 0;
+            bool used = false;
+            TValue value{};
+        };
+
+        static std::size_t hash(std::size_t slot) {
+            // Fibonacci hashing spreads sequential slot numbers across the table
+            return static_cast<std::size_t>((static_cast<std::uint64_t>(slot) * 0x9E3779B97F4A7C15ull) >> 32);
+        }
+
+        void grow() {
+            std::vector<Entry> old;
+            old.swap(_entries);
+            _entries.resize(old.empty() ? 8 : old.size() * 2);
+            _size = 0;
+
+            for ( auto& entry : old ) {
+                if ( entry.used ) (*this)[entry.slot] = std::move(entry.value);
+            }
+        }
+
+        std::vector<Entry> _entries;
+        std::size_t _size = 0;
+    };
+
+}
+
+#endif //SWARMVM_SLOT_MAP
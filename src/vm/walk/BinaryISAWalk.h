@@ -34,7 +34,7 @@ namespace swarmc::ISA {
             void* buf = malloc(sizeof(char) * length);
             input.read(static_cast<char*>(buf), length);
 
-            return binn_open((char*)buf + 4);
+            return binn_open((char*)buf + BC_PAYLOAD_OFFSET);
         }
 
         static Instructions fromInput(std::istream& input) {
@@ -43,7 +43,7 @@ namespace swarmc::ISA {
             auto list = binn_map_list(obj, BC_BODY);
             auto is = walk.walk((binn*) list);
 
-            free((char*)obj->ptr - 4);
+            free((char*)obj->ptr - BC_PAYLOAD_OFFSET);
             binn_free(obj);
             return is;
         }
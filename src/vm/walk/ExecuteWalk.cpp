@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <vector>
 #include "../../shared/nslib.h"
 #include "../VirtualMachine.h"
 #include "ExecuteWalk.h"
@@ -28,14 +30,16 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkOne(Instruction* inst) {
+        // Instructions loaded through the State have their shared locations pre-computed,
+        // so this is only hit for instructions executed outside the program.
+        return walkOne(inst, _sharedLocations->walkLockSet(inst));
+    }
+
+    Reference* ExecuteWalk::walkOne(Instruction* inst, const SharedLocations& sharedLocs) {
         try {
             // Instruction execution must be atomic across shared locations,
             // so we need to lock all shared locations used by this instruction.
 
-            // Extract the shared locations
-            // FIXME: optimization pass - do this once when we load the instructions rather than before each execute
-            auto sharedLocs = _sharedLocations->walkOne(inst);
-
             // Attempt to lock the necessary shared locations
             // FIXME: in the global scope, locks made here will apply to unscoped locations
             SharedLocations locked;
@@ -68,7 +72,9 @@ namespace swarmc::Runtime {
     }
 
     NumberReference* ExecuteWalk::ensureNumber(const Reference* ref) {
-        verbose("ensureNumber: " + ref->toString());
+        verbose([&]() { return "ensureNumber: " + ref->toString(); });
+        // Literal references always have their primitive type, so the tag alone is enough in the common case.
+        if ( ref->tag() == ReferenceTag::NUMBER ) return (NumberReference*) ref;
         ensureType(ref, Type::Primitive::of(Type::Intrinsic::NUMBER));
         if ( ref->tag() != ReferenceTag::NUMBER ) {
             throw Errors::RuntimeError(
@@ -80,7 +86,8 @@ namespace swarmc::Runtime {
     }
 
     BooleanReference* ExecuteWalk::ensureBoolean(const Reference* ref) {
-        verbose("ensureBoolean: " + ref->toString());
+        verbose([&]() { return "ensureBoolean: " + ref->toString(); });
+        if ( ref->tag() == ReferenceTag::BOOLEAN ) return (BooleanReference*) ref;
         ensureType(ref, Type::Primitive::of(Type::Intrinsic::BOOLEAN));
         if ( ref->tag() != ReferenceTag::BOOLEAN ) {
             throw Errors::RuntimeError(
@@ -92,7 +99,7 @@ namespace swarmc::Runtime {
     }
 
     TypeReference* ExecuteWalk::ensureType(const Reference* ref) {
-        verbose("ensureType: " + ref->toString());
+        verbose([&]() { return "ensureType: " + ref->toString(); });
         ensureType(ref, Type::Primitive::of(Type::Intrinsic::TYPE));
         if ( ref->tag() != ReferenceTag::TYPE && ref->tag() != ReferenceTag::OTYPE ) {
             throw Errors::RuntimeError(
@@ -104,7 +111,7 @@ namespace swarmc::Runtime {
     }
 
     ObjectTypeReference* ExecuteWalk::ensureObjectType(const Reference* ref) {
-        verbose("ensureType: " + ref->toString());
+        verbose([&]() { return "ensureType: " + ref->toString(); });
         ensureType(ref, Type::Primitive::of(Type::Intrinsic::TYPE));
         if ( ref->tag() != ReferenceTag::OTYPE ) {
             throw Errors::RuntimeError(
@@ -116,7 +123,7 @@ namespace swarmc::Runtime {
     }
 
     ObjectReference* ExecuteWalk::ensureObject(const Reference* ref) {
-        verbose("ensureObject: " + s(ref));
+        verbose([&]() { return "ensureObject: " + s(ref); });
         if ( ref->tag() != ReferenceTag::OBJECT ) {
             throw Errors::RuntimeError(
                 Errors::RuntimeExCode::InvalidReferenceImplementation,
@@ -127,7 +134,8 @@ namespace swarmc::Runtime {
     }
 
     StringReference* ExecuteWalk::ensureString(const Reference* ref) {
-        verbose("ensureString: " + ref->toString());
+        verbose([&]() { return "ensureString: " + ref->toString(); });
+        if ( ref->tag() == ReferenceTag::STRING ) return (StringReference*) ref;
         ensureType(ref, Type::Primitive::of(Type::Intrinsic::STRING));
         if ( ref->tag() != ReferenceTag::STRING ) {
             throw Errors::RuntimeError(
@@ -139,7 +147,7 @@ namespace swarmc::Runtime {
     }
 
     FunctionReference* ExecuteWalk::ensureFunction(const Reference* ref) {
-        verbose("ensureFunction: " + ref->toString());
+        verbose([&]() { return "ensureFunction: " + ref->toString(); });
         if ( ref->tag() != ReferenceTag::FUNCTION ) {
             throw Errors::RuntimeError(
                 Errors::RuntimeExCode::InvalidReferenceImplementation,
@@ -150,7 +158,7 @@ namespace swarmc::Runtime {
     }
 
     ContextIdReference* ExecuteWalk::ensureContextId(const Reference* ref) {
-        verbose("ensureContextId: " + ref->toString());
+        verbose([&]() { return "ensureContextId: " + ref->toString(); });
         if ( ref->tag() != ReferenceTag::CONTEXT_ID ) {
             throw new Errors::RuntimeError(
                 Errors::RuntimeExCode::InvalidReferenceImplementation,
@@ -161,7 +169,7 @@ namespace swarmc::Runtime {
     }
 
     JobIdReference* ExecuteWalk::ensureJobId(const Reference* ref) {
-        verbose("ensureJobId: " + ref->toString());
+        verbose([&]() { return "ensureJobId: " + ref->toString(); });
         if ( ref->tag() != ReferenceTag::JOB_ID ) {
             throw new Errors::RuntimeError(
                 Errors::RuntimeExCode::InvalidReferenceImplementation,
@@ -172,7 +180,7 @@ namespace swarmc::Runtime {
     }
 
     ReturnValueMapReference* ExecuteWalk::ensureReturnValueMap(const ISA::Reference* ref) {
-        verbose("ensureReturnValueMap: " + ref->toString());
+        verbose([&]() { return "ensureReturnValueMap: " + ref->toString(); });
         if ( ref->tag() != ReferenceTag::RETURN_VALUE_MAP ) {
             throw new Errors::RuntimeError(
                 Errors::RuntimeExCode::InvalidReferenceImplementation,
@@ -187,7 +195,7 @@ namespace swarmc::Runtime {
     }
 
     EnumerationReference* ExecuteWalk::ensureEnumeration(const Reference* ref) {
-        verbose("ensureEnumeration: " + ref->toString());
+        verbose([&]() { return "ensureEnumeration: " + ref->toString(); });
         if ( ref->tag() != ReferenceTag::ENUMERATION ) {
             throw Errors::RuntimeError(
                 Errors::RuntimeExCode::InvalidReferenceImplementation,
@@ -198,7 +206,7 @@ namespace swarmc::Runtime {
     }
 
     StreamReference* ExecuteWalk::ensureStream(const Reference* ref) {
-        verbose("ensureStream: " + ref->toString());
+        verbose([&]() { return "ensureStream: " + ref->toString(); });
         if ( ref->tag() != ReferenceTag::STREAM ) {
             throw Errors::RuntimeError(
                 Errors::RuntimeExCode::InvalidReferenceImplementation,
@@ -209,7 +217,7 @@ namespace swarmc::Runtime {
     }
 
     MapReference* ExecuteWalk::ensureMap(const Reference* ref) {
-        verbose("ensureMap: " + ref->toString());
+        verbose([&]() { return "ensureMap: " + ref->toString(); });
         if ( ref->tag() != ReferenceTag::MAP ) {
             throw Errors::RuntimeError(
                 Errors::RuntimeExCode::InvalidReferenceImplementation,
@@ -220,7 +228,7 @@ namespace swarmc::Runtime {
     }
 
     ResourceReference* ExecuteWalk::ensureResource(const Reference* ref) {
-        verbose("ensureResource: " + ref->toString());
+        verbose([&]() { return "ensureResource: " + ref->toString(); });
         if ( ref->tag() != ReferenceTag::RESOURCE ) {
             throw Errors::RuntimeError(
                 Errors::RuntimeExCode::InvalidReferenceImplementation,
@@ -234,29 +242,54 @@ namespace swarmc::Runtime {
         throw Errors::SwarmError("Attempted to interpret debugging annotation: " + i->toString());
     }
 
+    std::optional<double> ExecuteWalk::evalNumber(Instruction* i) {
+        switch ( i->tag() ) {
+            case Tag::PLUS: return evalPlus((Plus*) i);
+            case Tag::MINUS: return evalMinus((Minus*) i);
+            case Tag::TIMES: return evalTimes((Times*) i);
+            case Tag::DIVIDE: return evalDivide((Divide*) i);
+            case Tag::POWER: return evalPower((Power*) i);
+            case Tag::MOD: return evalMod((Mod*) i);
+            case Tag::NEG: return evalNegative((Negative*) i);
+            default: return std::nullopt;
+        }
+    }
+
+    double ExecuteWalk::evalPlus(Plus* i) {
+        verbose([&]() { return "plus " + i->first()->toString() + " " + i->second()->toString(); });
+        auto lhs = ensureNumber(_vm->resolve(i->first()));
+        auto rhs = ensureNumber(_vm->resolve(i->second()));
+        return lhs->value() + rhs->value();
+    }
+
     Reference* ExecuteWalk::walkPlus(Plus* i) {
-        verbose("plus " + i->first()->toString() + " " + i->second()->toString());
+        return new NumberReference(evalPlus(i));
+    }
+
+    double ExecuteWalk::evalMinus(Minus* i) {
+        verbose([&]() { return "minus " + i->first()->toString() + " " + i->second()->toString(); });
         auto lhs = ensureNumber(_vm->resolve(i->first()));
         auto rhs = ensureNumber(_vm->resolve(i->second()));
-        return new NumberReference(lhs->value() + rhs->value());
+        return lhs->value() - rhs->value();
     }
 
     Reference* ExecuteWalk::walkMinus(Minus* i) {
-        verbose("minus " + i->first()->toString() + " " + i->second()->toString());
+        return new NumberReference(evalMinus(i));
+    }
+
+    double ExecuteWalk::evalTimes(Times* i) {
+        verbose([&]() { return "times " + i->first()->toString() + " " + i->second()->toString(); });
         auto lhs = ensureNumber(_vm->resolve(i->first()));
         auto rhs = ensureNumber(_vm->resolve(i->second()));
-        return new NumberReference(lhs->value() - rhs->value());
+        return lhs->value() * rhs->value();
     }
 
     Reference* ExecuteWalk::walkTimes(Times* i) {
-        verbose("times " + i->first()->toString() + " " + i->second()->toString());
-        auto lhs = ensureNumber(_vm->resolve(i->first()));
-        auto rhs = ensureNumber(_vm->resolve(i->second()));
-        return new NumberReference(lhs->value() * rhs->value());
+        return new NumberReference(evalTimes(i));
     }
 
-    Reference* ExecuteWalk::walkDivide(Divide* i) {
-        verbose("divide " + i->first()->toString() + " " + i->second()->toString());
+    double ExecuteWalk::evalDivide(Divide* i) {
+        verbose([&]() { return "divide " + i->first()->toString() + " " + i->second()->toString(); });
         auto lhs = ensureNumber(_vm->resolve(i->first()));
         auto rhs = ensureNumber(_vm->resolve(i->second()));
 
@@ -267,101 +300,116 @@ namespace swarmc::Runtime {
             );
         }
 
-        return new NumberReference(lhs->value() / rhs->value());
+        return lhs->value() / rhs->value();
     }
 
-    Reference* ExecuteWalk::walkPower(Power* i) {
-        verbose("power " + i->first()->toString() + " " + i->second()->toString());
+    Reference* ExecuteWalk::walkDivide(Divide* i) {
+        return new NumberReference(evalDivide(i));
+    }
+
+    double ExecuteWalk::evalPower(Power* i) {
+        verbose([&]() { return "power " + i->first()->toString() + " " + i->second()->toString(); });
         auto lhs = ensureNumber(_vm->resolve(i->first()));
         auto rhs = ensureNumber(_vm->resolve(i->second()));
-        return new NumberReference(pow(lhs->value(), rhs->value()));
+        return pow(lhs->value(), rhs->value());
     }
 
-    Reference* ExecuteWalk::walkMod(Mod* i) {
-        verbose("mod " + i->first()->toString() + " " + i->second()->toString());
+    Reference* ExecuteWalk::walkPower(Power* i) {
+        return new NumberReference(evalPower(i));
+    }
+
+    double ExecuteWalk::evalMod(Mod* i) {
+        verbose([&]() { return "mod " + i->first()->toString() + " " + i->second()->toString(); });
         auto lhs = ensureNumber(_vm->resolve(i->first()));
         auto rhs = ensureNumber(_vm->resolve(i->second()));
-        return new NumberReference(std::fmod(lhs->value(), rhs->value()));
+        return std::fmod(lhs->value(), rhs->value());
     }
 
-    Reference* ExecuteWalk::walkNegative(Negative* i) {
-        verbose("neg " + i->first()->toString());
+    Reference* ExecuteWalk::walkMod(Mod* i) {
+        return new NumberReference(evalMod(i));
+    }
+
+    double ExecuteWalk::evalNegative(Negative* i) {
+        verbose([&]() { return "neg " + i->first()->toString(); });
         auto opd = ensureNumber(_vm->resolve(i->first()));
-        return new NumberReference(- opd->value());
+        return - opd->value();
+    }
+
+    Reference* ExecuteWalk::walkNegative(Negative* i) {
+        return new NumberReference(evalNegative(i));
     }
 
     Reference* ExecuteWalk::walkGreaterThan(GreaterThan* i) {
-        verbose("gt " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "gt " + i->first()->toString() + " " + i->second()->toString(); });
         auto lhs = ensureNumber(_vm->resolve(i->first()));
         auto rhs = ensureNumber(_vm->resolve(i->second()));
-        return new BooleanReference(lhs->value() > rhs->value());
+        return BooleanReference::of(lhs->value() > rhs->value());
     }
 
     Reference* ExecuteWalk::walkGreaterThanOrEqual(GreaterThanOrEqual* i) {
-        verbose("gte " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "gte " + i->first()->toString() + " " + i->second()->toString(); });
         auto lhs = ensureNumber(_vm->resolve(i->first()));
         auto rhs = ensureNumber(_vm->resolve(i->second()));
-        return new BooleanReference(lhs->value() >= rhs->value());
+        return BooleanReference::of(lhs->value() >= rhs->value());
     }
 
     Reference* ExecuteWalk::walkLessThan(LessThan* i) {
-        verbose("lt " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "lt " + i->first()->toString() + " " + i->second()->toString(); });
         auto lhs = ensureNumber(_vm->resolve(i->first()));
         auto rhs = ensureNumber(_vm->resolve(i->second()));
-        return new BooleanReference(lhs->value() < rhs->value());
+        return BooleanReference::of(lhs->value() < rhs->value());
     }
 
     Reference* ExecuteWalk::walkLessThanOrEqual(LessThanOrEqual* i) {
-        verbose("lte " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "lte " + i->first()->toString() + " " + i->second()->toString(); });
         auto lhs = ensureNumber(_vm->resolve(i->first()));
         auto rhs = ensureNumber(_vm->resolve(i->second()));
-        return new BooleanReference(lhs->value() <= rhs->value());
+        return BooleanReference::of(lhs->value() <= rhs->value());
     }
 
     Reference* ExecuteWalk::walkAnd(And* i) {
-        verbose("and " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "and " + i->first()->toString() + " " + i->second()->toString(); });
         auto lhs = ensureBoolean(_vm->resolve(i->first()));
         auto rhs = ensureBoolean(_vm->resolve(i->second()));
-        return new BooleanReference(lhs->value() && rhs->value());
+        return BooleanReference::of(lhs->value() && rhs->value());
     }
 
     Reference* ExecuteWalk::walkOr(Or* i) {
-        verbose("or " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "or " + i->first()->toString() + " " + i->second()->toString(); });
         auto lhs = ensureBoolean(_vm->resolve(i->first()));
         auto rhs = ensureBoolean(_vm->resolve(i->second()));
-        return new BooleanReference(lhs->value() || rhs->value());
+        return BooleanReference::of(lhs->value() || rhs->value());
     }
 
     Reference* ExecuteWalk::walkXor(Xor* i) {
-        verbose("xor " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "xor " + i->first()->toString() + " " + i->second()->toString(); });
         auto lhs = ensureBoolean(_vm->resolve(i->first()));
         auto rhs = ensureBoolean(_vm->resolve(i->second()));
-        return new BooleanReference(!lhs->value() != !rhs->value());
+        return BooleanReference::of(!lhs->value() != !rhs->value());
     }
 
     Reference* ExecuteWalk::walkNand(Nand* i) {
-        verbose("nand " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "nand " + i->first()->toString() + " " + i->second()->toString(); });
         auto lhs = ensureBoolean(_vm->resolve(i->first()));
         auto rhs = ensureBoolean(_vm->resolve(i->second()));
-        return new BooleanReference(!(lhs->value() && rhs->value()));
+        return BooleanReference::of(!(lhs->value() && rhs->value()));
     }
 
     Reference* ExecuteWalk::walkNor(Nor* i) {
-        verbose("nor " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "nor " + i->first()->toString() + " " + i->second()->toString(); });
         auto lhs = ensureBoolean(_vm->resolve(i->first()));
         auto rhs = ensureBoolean(_vm->resolve(i->second()));
-        return new BooleanReference(!(lhs->value() || rhs->value()));
+        return BooleanReference::of(!(lhs->value() || rhs->value()));
     }
 
     Reference* ExecuteWalk::walkNot(Not* i) {
-        verbose("not " + i->first()->toString());
+        verbose([&]() { return "not " + i->first()->toString(); });
         auto opd = ensureBoolean(_vm->resolve(i->first()));
-        return new BooleanReference(!opd->value());
+        return BooleanReference::of(!opd->value());
     }
 
     Reference* ExecuteWalk::walkWhile(While* i) {
-        verbose("while " + i->first()->toString() + " " + i->second()->toString());
-
+        verbose([&]() { return "while " + i->first()->toString() + " " + i->second()->toString(); });
         // create expected type for callback
         auto condType = new Type::Lambda0(Type::Primitive::of(Type::Intrinsic::BOOLEAN));
         GC_LOCAL_REF(condType)
@@ -414,7 +462,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkWith(With* i) {
-        verbose("with " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "with " + i->first()->toString() + " " + i->second()->toString(); });
         auto resource = ensureResource(_vm->resolve(i->first()));
 
         auto callbackType = new Type::Lambda1(resource->type(), Type::Primitive::of(Type::Intrinsic::VOID));
@@ -445,26 +493,16 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkEnumInit(EnumInit* i) {
-        verbose("enuminit " + i->first()->toString());
+        verbose([&]() { return "enuminit " + i->first()->toString(); });
         auto type = ensureType(i->first());
         return new EnumerationReference(type->value());
     }
 
     Reference* ExecuteWalk::walkEnumAppend(EnumAppend* i) {
-        verbose("enumappend " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "enumappend " + i->first()->toString() + " " + i->second()->toString(); });
         auto enumeration = ensureEnumeration(_vm->resolve(i->second()));
         auto value = _vm->resolve(i->first());
-
-        auto enumType = enumeration->type();
-        GC_LOCAL_REF(enumType)
-        if ( !value->typei()->isAssignableTo(enumType->valuesi()) ) {
-            throw Errors::RuntimeError(
-                Errors::RuntimeExCode::InvalidValueTypeForEnum,
-                "Cannot append value to enum: invalid type (expected: " + s(enumType->valuesi()) + ", got: " + s(value->typei()) + ")"
-            );
-        }
-
-        enumeration->append(value);
+        append(enumeration, value);
 
         // update shared store
         if ( i->second()->affinity() == ISA::Affinity::SHARED ) {
@@ -475,7 +513,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkEnumPrepend(EnumPrepend* i) {
-        verbose("enumprepend " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "enumprepend " + i->first()->toString() + " " + i->second()->toString(); });
         auto enumeration = ensureEnumeration(_vm->resolve(i->second()));
         auto value = _vm->resolve(i->first());
 
@@ -499,13 +537,13 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkEnumLength(EnumLength* i) {
-        verbose("enumlength " + i->first()->toString());
+        verbose([&]() { return "enumlength " + i->first()->toString(); });
         auto enumeration = ensureEnumeration(_vm->resolve(i->first()));
         return new NumberReference(static_cast<double>(enumeration->length()));
     }
 
     Reference* ExecuteWalk::walkEnumGet(EnumGet* i) {
-        verbose("enumget " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "enumget " + i->first()->toString() + " " + i->second()->toString(); });
         auto enumeration = ensureEnumeration(_vm->resolve(i->first()));
         auto idx = ensureNumber(_vm->resolve(i->second()));
 
@@ -520,7 +558,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkEnumSet(EnumSet* i) {
-        verbose("enumset " + i->first()->toString() + " " + i->second()->toString() + " " + i->third()->toString());
+        verbose([&]() { return "enumset " + i->first()->toString() + " " + i->second()->toString() + " " + i->third()->toString(); });
         auto enumeration = ensureEnumeration(_vm->resolve(i->first()));
         auto idx = ensureNumber(_vm->resolve(i->second()));
         auto value = _vm->resolve(i->third());
@@ -552,7 +590,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkEnumConcat(EnumConcat* i) {
-        verbose("enumconcat " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "enumconcat " + i->first()->toString() + " " + i->second()->toString(); });
         auto enum1 = ensureEnumeration(_vm->resolve(i->first()));
         auto enum2 = ensureEnumeration(_vm->resolve(i->second()));
 
@@ -572,7 +610,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkEnumerate(Enumerate* i) {
-        verbose("enumerate " + i->first()->toString() + " " + i->second()->toString() + " " + i->third()->toString());
+        verbose([&]() { return "enumerate " + i->first()->toString() + " " + i->second()->toString() + " " + i->third()->toString(); });
         auto elemType = ensureType(_vm->resolve(i->first()));
         auto enumeration = ensureEnumeration(_vm->resolve(i->second()));
         auto callback = ensureFunction(_vm->resolve(i->third()));
@@ -591,6 +629,25 @@ namespace swarmc::Runtime {
             );
         }
 
+        // Guided ranges are single elements until there are more than two per worker, and
+        // batching needs a provider to run them, so otherwise fall back to a job per element
+        IFunction* batch = nullptr;
+        auto workers = std::max<std::size_t>(1, Configuration::MAX_THREADS);
+        if ( enumeration->length() > 2 * workers && Configuration::ENUMERATION_UNROLLING_LIMIT > 1 ) {
+            batch = _vm->loadProviderFunction("ENUMERATE_BATCH");
+        }
+
+        if ( batch == nullptr ) {
+            enumerateEach(callback, enumeration);
+            return nullptr;
+        }
+
+        GC_LOCAL_REF(batch)
+        enumerateInBatches(batch, callback, enumeration);
+        return nullptr;
+    }
+
+    void ExecuteWalk::enumerateEach(FunctionReference* callback, EnumerationReference* enumeration) {
         _vm->enterQueueContext();
 
         for ( std::size_t idx = 0; idx < enumeration->length(); idx += 1 ) {
@@ -600,7 +657,7 @@ namespace swarmc::Runtime {
                 ->curryi(new NumberReference(static_cast<double>(idx)))
                 ->call();
 
-            GC_LOCAL_REF(call);
+            GC_LOCAL_REF(call)
 
             auto job = _vm->pushCall(call);
             GC_LOCAL_REF(job)
@@ -608,7 +665,88 @@ namespace swarmc::Runtime {
 
         _vm->drain();
         _vm->exitQueueContext();
-        return nullptr;
+    }
+
+    void ExecuteWalk::enumerateInBatches(IFunction* batch, FunctionReference* callback, EnumerationReference* enumeration) {
+        auto length = enumeration->length();
+        auto workers = std::max<std::size_t>(1, Configuration::MAX_THREADS);
+        auto limit = Configuration::ENUMERATION_UNROLLING_LIMIT;
+
+        auto enumType = enumeration->type();
+        GC_LOCAL_REF(enumType)
+
+        // Nothing has been timed yet, so the first round is one range per worker
+        double usPerElement = 0;
+        bool timed = false;
+
+        std::size_t next = 0;
+        while ( next < length ) {
+            // Cap the ranges so each job runs for about the target time
+            auto maxChunk = limit;
+            if ( timed && usPerElement > 0 ) {
+                auto byTime = static_cast<std::size_t>(Configuration::ENUMERATION_BATCH_TARGET_uS / usPerElement);
+                maxChunk = std::clamp<std::size_t>(byTime, 1, limit);
+            }
+
+            // Hand out about half of what's left per round, or all of it once it fits in two waves.
+            // Rounds end in a drain() on purpose: it is the only way to wait for a context's jobs,
+            // and each round's timings size the next one. Halving the budget keeps rounds few.
+            auto remaining = length - next;
+            std::size_t budget = remaining;
+            if ( !timed ) budget = std::min(remaining, workers * maxChunk);
+            else if ( remaining > 2 * workers * maxChunk ) budget = remaining / 2;
+
+            auto end = next + budget;
+            std::vector<std::pair<JobID, std::size_t>> jobs;
+
+            _vm->enterQueueContext();
+
+            while ( next < end ) {
+                // Guided scheduling: each range is a share of what's left, so they shrink toward the end
+                auto left = length - next;
+                auto share = timed ? (left + 2 * workers - 1) / (2 * workers) : (budget + workers - 1) / workers;
+                auto chunk = std::min(std::clamp<std::size_t>(share, 1, maxChunk), end - next);
+
+                auto elements = new EnumerationReference(enumType->values());
+                GC_LOCAL_REF(elements)
+                elements->reserve(chunk);
+                for ( std::size_t idx = next; idx < next + chunk; idx += 1 ) elements->append(enumeration->get(idx));
+
+                auto call = batch
+                    ->curryi(callback)
+                    ->curryi(elements)
+                    ->curryi(new NumberReference(static_cast<double>(next)))
+                    ->call();
+
+                GC_LOCAL_REF(call)
+
+                auto job = _vm->pushCall(call);
+                GC_LOCAL_REF(job)
+                jobs.emplace_back(job->id(), chunk);
+
+                next += chunk;
+            }
+
+            auto returns = _vm->drain();
+            _vm->exitQueueContext();
+
+            // Each range reports how long its elements took, which sizes the next round
+            double us = 0;
+            std::size_t counted = 0;
+            for ( const auto& [id, chunk] : jobs ) {
+                auto result = returns.find(id);
+                if ( result == returns.end() || result->second == nullptr || result->second->tag() != ReferenceTag::NUMBER ) continue;
+                us += ((NumberReference*) result->second)->value();
+                counted += chunk;
+            }
+
+            if ( counted > 0 ) {
+                usPerElement = us / static_cast<double>(counted);
+                timed = true;
+            }
+
+            verbose([&]() { return "enumerate: ran " + std::to_string(jobs.size()) + " range(s) of " + std::to_string(budget) + " element(s) (us/element: " + std::to_string(usPerElement) + ")"; });
+        }
     }
 
     Reference* ExecuteWalk::walkBeginFunction(BeginFunction* i) {
@@ -618,8 +756,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkFunctionParam(FunctionParam* i) {
-        verbose("fnparam " + i->first()->toString() + " " + i->second()->toString());
-
+        verbose([&]() { return "fnparam " + i->first()->toString() + " " + i->second()->toString(); });
         auto call = _vm->getCall();
         if ( call == nullptr ) {
             throw Errors::RuntimeError(
@@ -646,7 +783,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkReturn0(Return0*) {
-        verbose("return0");
+        verbose([]() { return "return0"; });
 
         if ( _vm->getCall() == nullptr ) {
             throw Errors::RuntimeError(
@@ -660,7 +797,7 @@ namespace swarmc::Runtime {
     }
 
     ISA::Reference* ExecuteWalk::walkReturn1(ISA::Return1* i) {
-        verbose("return1 " + i->first()->toString());
+        verbose([&]() { return "return1 " + i->first()->toString(); });
         auto call = _vm->getCall();
         GC_LOCAL_REF(call)
         if ( call == nullptr ) {
@@ -692,14 +829,14 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkCurry(Curry* i) {
-        verbose("curry " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "curry " + i->first()->toString() + " " + i->second()->toString(); });
         auto fn = ensureFunction(_vm->resolvei(i->first()));
         auto param = _vm->resolve(i->second());
         return new FunctionReference(fn->fn()->curry(param));
     }
 
     Reference* ExecuteWalk::walkCall0(Call0* i) {
-        verbose("call0 " + i->first()->toString());
+        verbose([&]() { return "call0 " + i->first()->toString(); });
         auto fn = ensureFunction(_vm->resolve(i->first()));
         auto call = fn->fn()->call();
         _vm->call(call);
@@ -707,7 +844,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkCall1(Call1* i) {
-        verbose("call1 " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "call1 " + i->first()->toString() + " " + i->second()->toString(); });
         auto fn = ensureFunction(_vm->resolve(i->first()));
         auto param = _vm->resolve(i->second());
         auto call = fn->fn()->curryi(param)->call();
@@ -716,7 +853,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkCallIf0(CallIf0* i) {
-        verbose("callif0 " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "callif0 " + i->first()->toString() + " " + i->second()->toString(); });
         auto cond = ensureBoolean(_vm->resolve(i->first()));
         auto fn = ensureFunction(_vm->resolve(i->second()));
         if ( cond->value() ) _vm->call(fn->fn()->call());
@@ -724,7 +861,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkCallIf1(CallIf1* i) {
-        verbose("callif1 " + i->first()->toString() + " " + i->second()->toString() + " " + i->third()->toString());
+        verbose([&]() { return "callif1 " + i->first()->toString() + " " + i->second()->toString() + " " + i->third()->toString(); });
         auto cond = ensureBoolean(_vm->resolve(i->first()));
         auto fn = ensureFunction(_vm->resolve(i->second()));
         auto param = _vm->resolve(i->third());
@@ -733,7 +870,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkCallElse0(CallElse0* i) {
-        verbose("callelse0 " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "callelse0 " + i->first()->toString() + " " + i->second()->toString(); });
         auto cond = ensureBoolean(_vm->resolve(i->first()));
         auto fn = ensureFunction(_vm->resolve(i->second()));
         if ( !cond->value() ) _vm->call(fn->fn()->call());
@@ -741,7 +878,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkCallElse1(CallElse1* i) {
-        verbose("callelse1 " + i->first()->toString() + " " + i->second()->toString() + " " + i->third()->toString());
+        verbose([&]() { return "callelse1 " + i->first()->toString() + " " + i->second()->toString() + " " + i->third()->toString(); });
         auto cond = ensureBoolean(_vm->resolve(i->first()));
         auto fn = ensureFunction(_vm->resolve(i->second()));
         auto param = _vm->resolve(i->third());
@@ -750,7 +887,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkPushCall0(PushCall0* i) {
-        verbose("pushcall0 " + i->first()->toString());
+        verbose([&]() { return "pushcall0 " + i->first()->toString(); });
         auto fn = ensureFunction(_vm->resolve(i->first()));
         auto call = fn->fn()->call();
         auto job = _vm->pushCall(call);
@@ -758,7 +895,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkPushCall1(PushCall1* i) {
-        verbose("pushcall1 " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "pushcall1 " + i->first()->toString() + " " + i->second()->toString(); });
         auto fn = ensureFunction(_vm->resolve(i->first()));
         auto param = _vm->resolve(i->second());
         auto call = fn->fn()->curryi(param)->call();
@@ -767,7 +904,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkPushCallIf0(PushCallIf0* i) {
-        verbose("pushcallif0 " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "pushcallif0 " + i->first()->toString() + " " + i->second()->toString(); });
         auto cond = ensureBoolean(_vm->resolve(i->first()));
         auto fn = ensureFunction(_vm->resolve(i->second()));
         if ( cond->value() ) _vm->pushCall(fn->fn()->call());
@@ -775,7 +912,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkPushCallIf1(PushCallIf1* i) {
-        verbose("pushcallif1 " + i->first()->toString() + " " + i->second()->toString() + " " + i->third()->toString());
+        verbose([&]() { return "pushcallif1 " + i->first()->toString() + " " + i->second()->toString() + " " + i->third()->toString(); });
         auto cond = ensureBoolean(_vm->resolve(i->first()));
         auto fn = ensureFunction(_vm->resolve(i->second()));
         auto param = _vm->resolve(i->third());
@@ -784,7 +921,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkPushCallElse0(PushCallElse0* i) {
-        verbose("pushcallelse0 " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "pushcallelse0 " + i->first()->toString() + " " + i->second()->toString(); });
         auto cond = ensureBoolean(_vm->resolve(i->first()));
         auto fn = ensureFunction(_vm->resolve(i->second()));
         if ( !cond->value() ) _vm->pushCall(fn->fn()->call());
@@ -792,7 +929,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkPushCallElse1(PushCallElse1* i) {
-        verbose("pushcallelse1 " + i->first()->toString() + " " + i->second()->toString() + " " + i->third()->toString());
+        verbose([&]() { return "pushcallelse1 " + i->first()->toString() + " " + i->second()->toString() + " " + i->third()->toString(); });
         auto cond = ensureBoolean(_vm->resolve(i->first()));
         auto fn = ensureFunction(_vm->resolve(i->second()));
         auto param = _vm->resolve(i->third());
@@ -801,19 +938,19 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkDrain(Drain*) {
-        verbose("drain");
+        verbose([]() { return "drain"; });
         return new ISA::ReturnValueMapReference(_vm->drain());
     }
 
     Reference* ExecuteWalk::walkRetMapHas(RetMapHas* i) {
-        verbose("retmaphas " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "retmaphas " + i->first()->toString() + " " + i->second()->toString(); });
         auto retMap = ensureReturnValueMap(_vm->resolve(i->first()));
         auto jobId = ensureJobId(_vm->resolve(i->second()));
-        return new BooleanReference(retMap->has(jobId->id()));
+        return BooleanReference::of(retMap->has(jobId->id()));
     }
 
     Reference* ExecuteWalk::walkRetMapGet(RetMapGet* i) {
-        verbose("retmapget " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "retmapget " + i->first()->toString() + " " + i->second()->toString(); });
         auto retMap = ensureReturnValueMap(_vm->resolve(i->first()));
         auto jobId = ensureJobId(_vm->resolve(i->second()));
         
@@ -830,52 +967,74 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkEnterContext(EnterContext*) {
-        verbose("entercontext");
+        verbose([]() { return "entercontext"; });
         _vm->enterQueueContext();
         return nullptr;
     }
 
     Reference* ExecuteWalk::walkResumeContext(ResumeContext* i) {
-        verbose("resumecontext " + i->first()->toString());
+        verbose([&]() { return "resumecontext " + i->first()->toString(); });
         auto id = ensureContextId(_vm->resolve(i->first()));
         _vm->enterQueueContext(id->id());
         return nullptr;
     }
 
     Reference* ExecuteWalk::walkPopContext(PopContext*) {
-        verbose("popcontext");
+        verbose([]() { return "popcontext"; });
         auto id = _vm->getQueueContext();
         _vm->exitQueueContext();
         return new ISA::ContextIdReference(id);
     }
 
     Reference* ExecuteWalk::walkExit(Exit*) {
-        verbose("exit");
+        verbose([]() { return "exit"; });
         _vm->exit();
         return nullptr;
     }
 
     Reference* ExecuteWalk::walkMapInit(MapInit* i) {
-        verbose("mapinit " + i->first()->toString());
+        verbose([&]() { return "mapinit " + i->first()->toString(); });
         auto innerType = ensureType(_vm->resolve(i->first()));
         return new MapReference(innerType->value());
     }
 
     Reference* ExecuteWalk::walkMapSet(MapSet* i) {
-        verbose("mapset " + i->first()->toString() + " " + i->second()->toString() + " " + i->third()->toString());
+        verbose([&]() { return "mapset " + i->first()->toString() + " " + i->second()->toString() + " " + i->third()->toString(); });
         auto key = ensureString(_vm->resolve(i->first()));
         auto map = ensureMap(_vm->resolve(i->third()));
         auto value = _vm->resolve(i->second());
+        set(map, key, value);
+
+        // update shared store
+        if ( i->third()->affinity() == ISA::Affinity::SHARED ) {
+            _vm->store(i->third(), map);
+        }
 
+        return nullptr;
+    }
+
+    void ExecuteWalk::append(EnumerationReference* enumeration, Reference* value) {
+        auto enumType = enumeration->type();
+        GC_LOCAL_REF(enumType)
+        if ( !value->typei()->isAssignableTo(enumType->valuesi()) ) {
+            throw Errors::RuntimeError(
+                Errors::RuntimeExCode::InvalidValueTypeForEnum,
+                "Cannot append value to enum: invalid type (expected: " + s(enumType->valuesi()) + ", got: " + s(value->typei()) + ")"
+            );
+        }
+
+        enumeration->append(value);
+    }
+
+    void ExecuteWalk::set(MapReference* map, const StringReference* key, Reference* value) {
         auto mapType = map->type();
         GC_LOCAL_REF(mapType)
         ensureType(value, mapType->valuesi());
         map->set(key->value(), value);
-        return nullptr;
     }
 
     Reference* ExecuteWalk::walkMapGet(MapGet* i) {
-        verbose("mapget " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "mapget " + i->first()->toString() + " " + i->second()->toString(); });
         auto key = ensureString(_vm->resolve(i->first()));
         auto map = ensureMap(_vm->resolve(i->second()));
 
@@ -890,19 +1049,19 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkMapLength(MapLength* i) {
-        verbose("maplength " + i->first()->toString());
+        verbose([&]() { return "maplength " + i->first()->toString(); });
         auto map = ensureMap(_vm->resolve(i->first()));
         return new NumberReference(static_cast<double>(map->length()));
     }
 
     Reference* ExecuteWalk::walkMapKeys(MapKeys* i) {
-        verbose("mapkeys " + i->first()->toString());
+        verbose([&]() { return "mapkeys " + i->first()->toString(); });
         auto map = ensureMap(_vm->resolve(i->first()));
         return map->keys();
     }
 
     Reference* ExecuteWalk::walkTypify(Typify* i) {
-        verbose("typify " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "typify " + i->first()->toString() + " " + i->second()->toString(); });
         auto loc = i->first();
         auto type = ensureType(i->second());
         _vm->typify(loc, type->value());
@@ -910,7 +1069,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkAssignValue(AssignValue* i) {
-        verbose("assignvalue " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "assignvalue " + i->first()->toString() + " " + i->second()->toString(); });
         auto loc = i->first();
         auto value = _vm->resolve(i->second());
 
@@ -931,7 +1090,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkAssignEval(AssignEval* i) {
-        verbose("assigneval " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "assigneval " + i->first()->toString() + " " + i->second()->toString(); });
         auto loc = i->first();
         auto eval = i->second();
 
@@ -941,17 +1100,17 @@ namespace swarmc::Runtime {
         // then we will need to make the call and wait for the return
         // to jump back here
         if ( eval->tag() == Tag::CALL0 || eval->tag() == Tag::CALL1 ) {
-            verbose("assignEval: got call0 or call1");
+            verbose([]() { return "assignEval: got call0 or call1"; });
 
             // Check if we got here because of the return
             auto returnCall = _vm->getReturn();
             if ( returnCall != nullptr ) {
-                verbose("assignEval: jumped from return");
+                verbose([]() { return "assignEval: jumped from return"; });
 
                 // Get the return value and store that
                 value = returnCall->getReturn();
             } else {
-                verbose("assignEval: jumping to call");
+                verbose([]() { return "assignEval: jumping to call"; });
 
                 // Otherwise, we need to make the call. Step back so we
                 // return-jump to the correct instruction.
@@ -959,6 +1118,17 @@ namespace swarmc::Runtime {
                 _vm->rewind();
                 return walkOnePropagatingExceptions(eval);
             }
+        } else if ( auto number = evalNumber(eval) ) {
+            // Arithmetic into a local number which nothing else references can update the
+            // stored value in place, rather than allocating a reference for every result.
+            auto locType = loc->typei();
+            auto numberT = Type::Primitive::of(Type::Intrinsic::NUMBER);
+            if ( !locType->isAmbiguous() && numberT->isAssignableTo(locType.get()) && _vm->storeNumberInPlace(loc, *number) ) {
+                debug(loc->toString() + " <- NumberReference<" + std::to_string(*number) + ">");
+                return nullptr;
+            }
+
+            value = new NumberReference(*number);
         } else {
             value = walkOnePropagatingExceptions(eval);
         }
@@ -989,41 +1159,110 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkLock(Lock* i) {
-        verbose("lock " + i->first()->toString());
+        verbose([&]() { return "lock " + i->first()->toString(); });
         auto scopeLoc = _vm->getScopeFrame()->map(i->first());
+
+        // If this lock only guards a read-modify-write of the location, let the store apply it
+        // atomically instead, and skip the rest of the critical section.
+        auto state = _vm->getState();
+        auto update = state->current() == i ? state->currentAtomicUpdate() : nullptr;
+        if ( update != nullptr && _vm->canUpdateAtomically(scopeLoc) ) {
+            updateAtomically(scopeLoc, *update);
+            state->jump(update->unlock);
+            return nullptr;
+        }
+
         _vm->lock(scopeLoc);
         return nullptr;
     }
 
+    void ExecuteWalk::updateAtomically(LocationReference* scopeLoc, const AtomicUpdate& update) {
+        verbose([&]() { return "lock: updating " + scopeLoc->toString() + " atomically"; });
+
+        // Compute the operand, exactly as the critical section would have
+        for ( auto inst : update.prelude ) {
+            auto result = walkOnePropagatingExceptions(inst);
+            GC_LOCAL_REF(result)
+        }
+
+        auto operand = _vm->resolve(update.operand);
+        AtomicApply apply;
+
+        if ( update.op == AtomicOp::ENUM_APPEND ) {
+            apply = [this, operand](Reference* current) -> Reference* {
+                auto enumeration = ensureEnumeration(current);
+                append(enumeration, operand);
+                return enumeration;
+            };
+        } else if ( update.op == AtomicOp::MAP_SET ) {
+            auto key = ensureString(_vm->resolve(update.key));
+            apply = [this, key, operand](Reference* current) -> Reference* {
+                auto map = ensureMap(current);
+                set(map, key, operand);
+                return map;
+            };
+        } else {
+            auto op = update.op;
+            auto rhs = ensureNumber(operand)->value();
+            if ( op == AtomicOp::DIVIDE && rhs == 0.0 ) {
+                throw Errors::RuntimeError(
+                    Errors::RuntimeExCode::DivisionByZero,
+                    "Attempted to divide by zero"
+                );
+            }
+
+            apply = [this, op, rhs](Reference* current) -> Reference* {
+                auto lhs = ensureNumber(current)->value();
+                if ( op == AtomicOp::ADD ) return new NumberReference(lhs + rhs);
+                if ( op == AtomicOp::SUBTRACT ) return new NumberReference(lhs - rhs);
+                if ( op == AtomicOp::MULTIPLY ) return new NumberReference(lhs * rhs);
+                return new NumberReference(lhs / rhs);
+            };
+        }
+
+        auto value = _vm->updateAtomically(scopeLoc, update.op, operand, apply);
+        GC_LOCAL_REF(value)
+        debug(update.location->toString() + " <- " + value->toString());
+
+        if ( update.result != nullptr ) {
+            if ( update.result->typei()->isAmbiguous() ) {
+                update.result->setType(value->type());
+            }
+
+            debug(update.result->toString() + " <- " + value->toString());
+            _vm->store(update.result, value);
+        }
+    }
+
     Reference* ExecuteWalk::walkUnlock(Unlock* i) {
-        verbose("unlock " + i->first()->toString());
+        verbose([&]() { return "unlock " + i->first()->toString(); });
         auto scopeLoc = _vm->getScopeFrame()->map(i->first());
         _vm->unlock(scopeLoc);
         return nullptr;
     }
 
     Reference* ExecuteWalk::walkIsEqual(IsEqual* i) {
-        verbose("equal " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "equal " + i->first()->toString() + " " + i->second()->toString(); });
         auto lhs = _vm->resolve(i->first());
         auto rhs = _vm->resolve(i->second());
-        return new BooleanReference(lhs->isEqualTo(rhs));
+        return BooleanReference::of(lhs->isEqualTo(rhs));
     }
 
     Reference* ExecuteWalk::walkScopeOf(ScopeOf* i) {
-        verbose("scopeof " + i->first()->toString());
+        verbose([&]() { return "scopeof " + i->first()->toString(); });
         _vm->shadow(i->first());
         return nullptr;
     }
 
     Reference* ExecuteWalk::walkStreamInit(StreamInit* i) {
-        verbose("streaminit " + i->first()->toString());
+        verbose([&]() { return "streaminit " + i->first()->toString(); });
         auto type = ensureType(_vm->resolve(i->first()));
         auto stream = _vm->getStream(nslib::uuid(), type->value());
         return new StreamReference(stream);
     }
 
     Reference* ExecuteWalk::walkStreamPush(StreamPush* i) {
-        verbose("streampush " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "streampush " + i->first()->toString() + " " + i->second()->toString(); });
         auto stream = ensureStream(_vm->resolve(i->first()));
         auto value = _vm->resolve(i->second());
 
@@ -1048,7 +1287,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkStreamPop(StreamPop* i) {
-        verbose("streampop " + i->first()->toString());
+        verbose([&]() { return "streampop " + i->first()->toString(); });
         auto stream = ensureStream(_vm->resolve(i->first()));
 
         if ( !stream->stream()->isOpen() ) {
@@ -1069,7 +1308,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkStreamClose(StreamClose* i) {
-        verbose("streamclose " + i->first()->toString());
+        verbose([&]() { return "streamclose " + i->first()->toString(); });
         auto stream = ensureStream(_vm->resolve(i->first()));
 
         if ( !stream->stream()->isOpen() ) {
@@ -1084,7 +1323,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkStreamEmpty(StreamEmpty* i) {
-        verbose("streamempty " + i->first()->toString());
+        verbose([&]() { return "streamempty " + i->first()->toString(); });
         auto stream = ensureStream(_vm->resolve(i->first()));
 
         if ( !stream->stream()->isOpen() ) {
@@ -1094,7 +1333,7 @@ namespace swarmc::Runtime {
             );
         }
 
-        return new BooleanReference(stream->stream()->isEmpty());
+        return BooleanReference::of(stream->stream()->isEmpty());
     }
 
     Reference* ExecuteWalk::walkOut(Out* i) {
@@ -1106,14 +1345,14 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkStringConcat(StringConcat* i) {
-        verbose("strconcat " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "strconcat " + i->first()->toString() + " " + i->second()->toString(); });
         auto lhs = ensureString(_vm->resolve(i->first()));
         auto rhs = ensureString(_vm->resolve(i->second()));
         return new StringReference(lhs->value() + rhs->value());
     }
 
     Reference* ExecuteWalk::walkStringLength(StringLength* i) {
-        verbose("strlength " + i->first()->toString());
+        verbose([&]() { return "strlength " + i->first()->toString(); });
         auto opd = ensureString(_vm->resolve(i->first()));
         return new NumberReference(static_cast<double>(opd->value().length()));
     }
@@ -1121,7 +1360,7 @@ namespace swarmc::Runtime {
     Reference* ExecuteWalk::walkStringSliceFrom(StringSliceFrom* i) {
         // FIXME: handle negative indices
 
-        verbose("strslicefrom " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "strslicefrom " + i->first()->toString() + " " + i->second()->toString(); });
         auto str = ensureString(_vm->resolve(i->first()));
         auto from = ensureNumber(_vm->resolve(i->second()));
         return new StringReference(str->value().substr(static_cast<std::size_t>(from->value())));
@@ -1130,7 +1369,7 @@ namespace swarmc::Runtime {
     Reference* ExecuteWalk::walkStringSliceFromTo(StringSliceFromTo* i) {
         // FIXME: handle negative indices
 
-        verbose("strslicefromto " + i->first()->toString() + " " + i->second()->toString() + " " + i->third()->toString());
+        verbose([&]() { return "strslicefromto " + i->first()->toString() + " " + i->second()->toString() + " " + i->third()->toString(); });
         auto str = ensureString(_vm->resolve(i->first()));
         auto from = ensureNumber(_vm->resolve(i->second()));
         auto to = ensureNumber(_vm->resolve(i->third()));
@@ -1140,7 +1379,7 @@ namespace swarmc::Runtime {
     Reference* ExecuteWalk::walkTypeOf(TypeOf* i) {
         // FIXME: handle ambiguous type narrowing?
 
-        verbose("typeof " + i->first()->toString());
+        verbose([&]() { return "typeof " + i->first()->toString(); });
         auto opd = _vm->resolvei(i->first());
         return new TypeReference(opd->type());
     }
@@ -1148,14 +1387,14 @@ namespace swarmc::Runtime {
     Reference* ExecuteWalk::walkIsCompatible(IsCompatible* i) {
         // FIXME: handle ambiguous type narrowing?
 
-        verbose("compatible " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "compatible " + i->first()->toString() + " " + i->second()->toString(); });
         auto lhs = _vm->resolve(i->first());
         auto rhs = _vm->resolve(i->second());
-        return new BooleanReference(rhs->typei()->isAssignableTo(lhs->typei()));
+        return BooleanReference::of(rhs->typei()->isAssignableTo(lhs->typei()));
     }
 
     Reference* ExecuteWalk::walkPushExceptionHandler1(PushExceptionHandler1* i) {
-        verbose("pushexhandler " + i->first()->toString());
+        verbose([&]() { return "pushexhandler " + i->first()->toString(); });
         auto handler = ensureFunction(_vm->resolve(i->first()));
 
         if ( !handler->typei()->isAssignableTo(_typeOfExceptionHandler) ) {
@@ -1170,7 +1409,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkPushExceptionHandler2(PushExceptionHandler2* i) {
-        verbose("pushexhandler " + i->first()->toString() + " " + i->second()->toString());
+        verbose([&]() { return "pushexhandler " + i->first()->toString() + " " + i->second()->toString(); });
         auto handler = ensureFunction(_vm->resolve(i->first()));
         auto discriminator = _vm->resolve(i->second());
 
@@ -1201,21 +1440,21 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkPopExceptionHandler(PopExceptionHandler* i) {
-        verbose("popexhandler " + i->first()->toString());
+        verbose([&]() { return "popexhandler " + i->first()->toString(); });
         auto id = ensureString(_vm->resolve(i->first()));
         _vm->popExceptionHandler(id->value());
         return nullptr;
     }
 
     Reference* ExecuteWalk::walkRaise(Raise* i) {
-        verbose("raise " + i->first()->toString());
+        verbose([&]() { return "raise " + i->first()->toString(); });
         auto id = ensureNumber(_vm->resolve(i->first()));
         _vm->raise(static_cast<std::size_t>(id->value()));
         return nullptr;
     }
 
     Reference* ExecuteWalk::walkResume(Resume* i) {
-        verbose("resume " + i->first()->toString());
+        verbose([&]() { return "resume " + i->first()->toString(); });
         auto fn = ensureFunction(_vm->resolve(i->first()));
 
         // Get the scope where the exception handler was registered
@@ -1247,8 +1486,9 @@ namespace swarmc::Runtime {
             );
         }
 
-        // Rewind to the scope we are resuming to
-        _vm->restore(scope->clearExceptionFrame());
+        // Rewind to the scope we are resuming to (copying it if a forked VM can still see it)
+        auto resumeScope = scope->isShared() ? scope->copy() : scope;
+        _vm->restore(resumeScope->clearExceptionFrame());
 
         // Call the resumed function w/in the scope fo the exception handler
         _vm->callWithInheritedScope(fn->fn()->call());
@@ -1257,12 +1497,12 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkOTypeInit(OTypeInit*) {
-        verbose("otypeinit");
+        verbose([]() { return "otypeinit"; });
         return new ObjectTypeReference(new Type::Object);
     }
 
     Reference* ExecuteWalk::walkOTypeProp(OTypeProp* i) {
-        verbose("otypeprop " + s(i->first()) + " " + s(i->second()) + " " + s(i->third()));
+        verbose([&]() { return "otypeprop " + s(i->first()) + " " + s(i->second()) + " " + s(i->third()); });
         auto otype = ensureObjectType(_vm->resolve(i->first()));
         auto oprop = i->second();
         auto propType = ensureType(_vm->resolve(i->third()));
@@ -1272,7 +1512,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkOTypeDel(OTypeDel* i) {
-        verbose("otypedel " + s(i->first()) + " " + s(i->second()));
+        verbose([&]() { return "otypedel " + s(i->first()) + " " + s(i->second()); });
         auto otype = ensureObjectType(_vm->resolve(i->first()));
         auto oprop = i->second();
 
@@ -1281,7 +1521,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkOTypeGet(OTypeGet* i) {
-        verbose("otypeget " + s(i->first()) + " " + s(i->second()));
+        verbose([&]() { return "otypeget " + s(i->first()) + " " + s(i->second()); });
         auto otype = ensureObjectType(_vm->resolve(i->first()));
         auto oprop = i->second();
 
@@ -1297,14 +1537,14 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkOTypeFinalize(OTypeFinalize* i) {
-        verbose("otypefinalize " + s(i->first()));
+        verbose([&]() { return "otypefinalize " + s(i->first()); });
         auto otype = ensureObjectType(_vm->resolve(i->first()));
         auto finalized = otype->otypei()->finalize();
         return new ObjectTypeReference(finalized);
     }
 
     Reference* ExecuteWalk::walkOTypeSubset(OTypeSubset* i) {
-        verbose("otypesubset " + s(i->first()));
+        verbose([&]() { return "otypesubset " + s(i->first()); });
         auto otype = ensureObjectType(_vm->resolve(i->first()));
         if ( !otype->isFinal() ) {
             throw Errors::RuntimeError(
@@ -1317,7 +1557,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkObjInit(ObjInit* i) {
-        verbose("objinit " + s(i->first()));
+        verbose([&]() { return "objinit " + s(i->first()); });
         auto otype = ensureObjectType(_vm->resolve(i->first()));
         if ( !otype->isFinal() ) {
             throw Errors::RuntimeError(
@@ -1330,7 +1570,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkObjSet(ObjSet* i) {
-        verbose("objset " + s(i->first()) + " " + s(i->second()) + " " + s(i->third()));
+        verbose([&]() { return "objset " + s(i->first()) + " " + s(i->second()) + " " + s(i->third()); });
         auto obj = ensureObject(_vm->resolve(i->first()));
         auto prop = i->second();
         auto val = _vm->resolve(i->third());
@@ -1340,7 +1580,7 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkObjGet(ObjGet* i) {
-        verbose("objget " + s(i->first()) + " " + s(i->second()));
+        verbose([&]() { return "objget " + s(i->first()) + " " + s(i->second()); });
         auto obj = ensureObject(_vm->resolve(i->first()));
         auto prop = i->second();
 
@@ -1348,13 +1588,13 @@ namespace swarmc::Runtime {
     }
 
     Reference* ExecuteWalk::walkObjInstance(ObjInstance* i) {
-        verbose("objinstance " + s(i->first()));
+        verbose([&]() { return "objinstance " + s(i->first()); });
         auto obj = ensureObject(_vm->resolve(i->first()));
         return obj->finalize();
     }
 
     Reference* ExecuteWalk::walkObjCurry(ObjCurry* i) {
-        verbose("objcurry " + s(i->first()) + " " + s(i->second()));
+        verbose([&]() { return "objcurry " + s(i->first()) + " " + s(i->second()); });
         auto obj = ensureObject(_vm->resolve(i->first()));
         auto propVal = obj->getProperty(i->second()->name());
         auto fn = ensureFunction(propVal);
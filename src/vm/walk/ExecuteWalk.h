@@ -2,6 +2,7 @@
 #define SWARMVM_EXECUTEWALK
 
 #include <cassert>
+#include <optional>
 #include "../../shared/nslib.h"
 #include "../../lang/Type.h"
 #include "../ISAWalk.h"
@@ -12,6 +13,7 @@ using namespace nslib;
 namespace swarmc::Runtime {
 
     class VirtualMachine;
+    struct AtomicUpdate;
 
     /**
      * ISA walk which uses the virtual machine to execute SVI instructions.
@@ -38,6 +40,9 @@ namespace swarmc::Runtime {
 
         ISA::Reference* walkOne(ISA::Instruction* inst) override;
 
+        /** Execute an instruction, holding locks on the given (canonically ordered) shared locations. */
+        ISA::Reference* walkOne(ISA::Instruction* inst, const ISA::SharedLocations& sharedLocs);
+
         ISA::Reference* walkOnePropagatingExceptions(ISA::Instruction* inst);
 
         /** Cast the reference as a number, or raise an exception. */
@@ -97,8 +102,21 @@ namespace swarmc::Runtime {
         }
 
         /** Prints a message shown only when the `--verbose` flag is used. */
-        virtual void verbose(const std::string& output) const {
+        void verbose(const std::string& output) const {
+#ifndef SWARM_STRIP_VERBOSE
             if ( Configuration::VERBOSE ) debug(output);
+#endif
+        }
+
+        /**
+         * Prints a message shown only when the `--verbose` flag is used, but only builds the message (by calling
+         * `formatter`) if it would actually be output. Compiled out entirely under SWARM_STRIP_VERBOSE.
+         */
+        template <typename TFormatter> requires std::invocable<TFormatter>
+        void verbose(TFormatter&& formatter) const {
+#ifndef SWARM_STRIP_VERBOSE
+            if ( Configuration::VERBOSE && logger->isEnabled(Verbosity::DEBUG) ) debug(formatter());
+#endif
         }
 
         /** Verify that the reference is assignable to the given type, or raise an exception. */
@@ -106,6 +124,39 @@ namespace swarmc::Runtime {
 
         virtual void ensureType(const ISA::Reference*, const InlineRefHandle<Type::Type>&);
 
+        /** Append a value to an enumeration, or raise an exception if it has the wrong type. */
+        virtual void append(ISA::EnumerationReference*, ISA::Reference*);
+
+        /** Set a key in a map, or raise an exception if the value has the wrong type. */
+        virtual void set(ISA::MapReference*, const ISA::StringReference*, ISA::Reference*);
+
+        /**
+         * Evaluate an arithmetic instruction to a plain double, without allocating a reference
+         * for the result. Returns std::nullopt, without evaluating anything, for other instructions.
+         */
+        virtual std::optional<double> evalNumber(ISA::Instruction*);
+
+        double evalPlus(ISA::Plus*);
+        double evalMinus(ISA::Minus*);
+        double evalTimes(ISA::Times*);
+        double evalDivide(ISA::Divide*);
+        double evalPower(ISA::Power*);
+        double evalMod(ISA::Mod*);
+        double evalNegative(ISA::Negative*);
+
+        /** Execute the critical section beginning at the current `lock` as a single update in the store. */
+        virtual void updateAtomically(ISA::LocationReference* scopeLoc, const AtomicUpdate&);
+
+        /** Push one job per element of an `enumerate`, then wait for them. */
+        virtual void enumerateEach(ISA::FunctionReference* callback, ISA::EnumerationReference*);
+
+        /**
+         * Push jobs which each run the callback over a contiguous range of an `enumerate`,
+         * then wait for them. Ranges are sized like guided scheduling, shrinking as the work
+         * runs out, and capped using the per-element time measured by the previous round.
+         */
+        virtual void enumerateInBatches(IFunction* batch, ISA::FunctionReference* callback, ISA::EnumerationReference*);
+
         ISA::Reference* walkPosition(ISA::PositionAnnotation*) override;
         ISA::Reference* walkPlus(ISA::Plus*) override;
         ISA::Reference* walkMinus(ISA::Minus*) override;
@@ -266,7 +266,7 @@ namespace swarmc::ISA {
         binn* walkBeginFunction(BeginFunction* bf) override {
             auto obj = binn_map();
             binn_map_set_uint64(obj, BC_TAG, (std::size_t) bf->tag());
-            binn_map_set_str(obj, BC_NAME, strdup(bf->first()->name().c_str()));
+            binn_map_set_str(obj, BC_NAME, (char*) bf->first()->name().c_str());
             binn_map_set_map(obj, BC_SECOND, Wire::references()->reduce(bf->second(), _vm));
             binn_map_set_bool(obj, BC_ISPURE, bf->isPure());
             return obj;
@@ -1,6 +1,7 @@
 #ifndef SWARM_SHAREDLOCATIONSWALK_H
 #define SWARM_SHAREDLOCATIONSWALK_H
 
+#include <algorithm>
 #include "../isa_meta.h"
 #include "../ISAWalk.h"
 
@@ -18,6 +19,26 @@ namespace swarmc::ISA {
             return "ISA::SharedLocationsWalk<>";
         }
 
+        /**
+         * Get the shared locations used by an instruction, de-duplicated and sorted by their
+         * fully-qualified names. Controls which acquire their locks in this canonical order
+         * cannot deadlock waiting on each other.
+         */
+        SharedLocations walkLockSet(Instruction* inst) {
+            auto locs = walkOne(inst);
+            if ( locs.size() < 2 ) return locs;
+
+            std::sort(locs.begin(), locs.end(), [](LocationReference* a, LocationReference* b) {
+                return a->fqName() < b->fqName();
+            });
+
+            locs.erase(std::unique(locs.begin(), locs.end(), [](LocationReference* a, LocationReference* b) {
+                return a->fqName() == b->fqName();
+            }), locs.end());
+
+            return locs;
+        }
+
     protected:
         SharedLocations walkPosition(PositionAnnotation* i) override {
             return {};
@@ -1,6 +1,13 @@
 #ifndef SWARMVM_BINARY_CONST
 #define SWARMVM_BINARY_CONST
 
+// Binary SVI files are the header, a format version byte, then the binn-encoded program.
+// Bump the version whenever the encoding changes (2: literals use the compact Wire format).
+#define BC_HEADER "\x7fSVI"
+#define BC_HEADER_LENGTH 4
+#define BC_FORMAT_VERSION 2
+#define BC_PAYLOAD_OFFSET (BC_HEADER_LENGTH + 1)
+
 #define BC_TAG 0
 #define BC_FIRST 1
 #define BC_SECOND 2
@@ -44,5 +51,9 @@
 #define BC_STORE_REFS 39
 #define BC_OWNER 40
 #define BC_CATEGORY 41
+#define BC_PROGRAM 42
+#define BC_PROGRAM_IMAGE 43
+#define BC_REPLICA 44
+#define BC_ORIGIN 45
 
 #endif //SWARMVM_BINARY_CONST
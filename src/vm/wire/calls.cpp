@@ -23,16 +23,16 @@ namespace swarmc::Runtime {
 
             auto binn = binn_map();
             binn_map_set_uint64(binn, BC_BACKEND, (std::size_t) call->backend());
-            binn_map_set_str(binn, BC_NAME, strdup(call->name().c_str()));
+            binn_map_set_str(binn, BC_NAME, (char*) call->name().c_str());
 //            binn_map_set_object(binn, BC_TYPE, types()->reduce(call->returnType()));
             binn_map_set_map(binn, BC_EXTRA, call->getExtraSerialData());
 //            binn_map_set_list(binn, BC_VECTOR_TYPES, vectorTypes);
             binn_map_set_list(binn, BC_VECTOR_VALUES, vectorValues);
             return binn;
         };
-        factory->registerReducer(s(FunctionBackend::FB_INLINE), reducer);
-        factory->registerReducer(s(FunctionBackend::FB_PROVIDER), reducer);
-        factory->registerReducer(s(FunctionBackend::FB_INTRINSIC), reducer);
+        factory->registerReducer((index_t) FunctionBackend::FB_INLINE, s(FunctionBackend::FB_INLINE), reducer);
+        factory->registerReducer((index_t) FunctionBackend::FB_PROVIDER, s(FunctionBackend::FB_PROVIDER), reducer);
+        factory->registerReducer((index_t) FunctionBackend::FB_INTRINSIC, s(FunctionBackend::FB_INTRINSIC), reducer);
 
         auto producer = [](binn* obj, VirtualMachine* vm) {
             auto backend = (FunctionBackend) binn_map_uint64(obj, BC_BACKEND);
@@ -56,9 +56,9 @@ namespace swarmc::Runtime {
             call->loadExtraSerialData((binn*) binn_map_map(obj, BC_EXTRA));
             return call;
         };
-        factory->registerProducer(s(FunctionBackend::FB_INLINE), producer);
-        factory->registerProducer(s(FunctionBackend::FB_PROVIDER), producer);
-        factory->registerProducer(s(FunctionBackend::FB_INTRINSIC), producer);
+        factory->registerProducer((index_t) FunctionBackend::FB_INLINE, s(FunctionBackend::FB_INLINE), producer);
+        factory->registerProducer((index_t) FunctionBackend::FB_PROVIDER, s(FunctionBackend::FB_PROVIDER), producer);
+        factory->registerProducer((index_t) FunctionBackend::FB_INTRINSIC, s(FunctionBackend::FB_INTRINSIC), producer);
 
         Framework::onShutdown([factory]() {
             delete factory;
@@ -0,0 +1,509 @@
+#include <bit>
+#include <cassert>
+#include <climits>
+#include "../../errors/SwarmError.h"
+#include "../Wire.h"
+#include "../isa_meta.h"
+#include "../VirtualMachine.h"
+#include "compact.h"
+
+using namespace nslib::serial;
+using namespace swarmc::ISA;
+
+namespace swarmc::Runtime {
+
+    void CompactWriter::reference(const Reference* baseRef) {
+        byte(static_cast<std::uint8_t>(baseRef->tag()));
+
+        switch ( baseRef->tag() ) {
+            case ReferenceTag::LOCATION: {
+                auto ref = dynamic_cast<const LocationReference*>(baseRef);
+                varint(static_cast<std::uint64_t>(ref->affinity()));
+                string(ref->name());
+                break;
+            }
+            case ReferenceTag::TYPE:
+            case ReferenceTag::OTYPE: {
+                type(dynamic_cast<const TypeReference*>(baseRef)->value());
+                break;
+            }
+            case ReferenceTag::OBJECT: {
+                auto ref = dynamic_cast<const ObjectReference*>(baseRef);
+                type(ref->type());
+                byte(ref->isFinal());
+
+                auto properties = ref->getProperties();
+                varint(properties.size());
+                for ( const auto& p : properties ) {
+                    string(p.first);
+                    reference(p.second);
+                }
+                break;
+            }
+            case ReferenceTag::ENUMERATION: {
+                auto ref = dynamic_cast<const EnumerationReference*>(baseRef);
+                auto enumType = ref->type();
+                GC_LOCAL_REF(enumType)
+
+                auto innerType = enumType->values();
+                type(innerType);
+                if ( packed(ref, innerType) ) break;
+
+                byte(static_cast<std::uint8_t>(Packing::NONE));
+                varint(ref->length());
+                for ( std::size_t i = 0; i < ref->length(); i += 1 ) {
+                    reference(ref->get(i));
+                }
+                break;
+            }
+            case ReferenceTag::MAP: {
+                auto ref = dynamic_cast<const MapReference*>(baseRef);
+                auto mapType = ref->type();
+                GC_LOCAL_REF(mapType)
+                type(mapType->values());
+
+                auto keys = ref->keys();
+                GC_LOCAL_REF(keys)
+                varint(keys->length());
+                for ( std::size_t i = 0; i < keys->length(); i += 1 ) {
+                    auto key = dynamic_cast<const StringReference*>(keys->get(i))->value();
+                    string(key);
+                    reference(ref->get(key));
+                }
+                break;
+            }
+            case ReferenceTag::FUNCTION: {
+                auto ref = dynamic_cast<const FunctionReference*>(baseRef);
+                varint(static_cast<std::uint64_t>(ref->fn()->backend()));
+                string(ref->fn()->name());
+
+                auto params = ref->fn()->getCallVector();
+                varint(params.size());
+                for ( const auto& p : params ) {
+                    reference(p.second);
+                }
+                break;
+            }
+            case ReferenceTag::STREAM: {
+                auto ref = dynamic_cast<const StreamReference*>(baseRef);
+                string(ref->stream()->id());
+                type(ref->stream()->innerType());
+                break;
+            }
+            case ReferenceTag::CONTEXT_ID: {
+                string(dynamic_cast<const ContextIdReference*>(baseRef)->id());
+                break;
+            }
+            case ReferenceTag::JOB_ID: {
+                varint(dynamic_cast<const JobIdReference*>(baseRef)->id());
+                break;
+            }
+            case ReferenceTag::RETURN_VALUE_MAP: {
+                auto ref = dynamic_cast<const ReturnValueMapReference*>(baseRef);
+                auto keys = ref->keys();
+                GC_LOCAL_REF(keys)
+                varint(keys->length());
+                for ( std::size_t i = 0; i < keys->length(); i += 1 ) {
+                    auto key = dynamic_cast<const JobIdReference*>(keys->get(i))->id();
+                    varint(key);
+                    reference(ref->getReturnValue(key));
+                }
+                break;
+            }
+            case ReferenceTag::STRING: {
+                string(dynamic_cast<const StringReference*>(baseRef)->value());
+                break;
+            }
+            case ReferenceTag::NUMBER: {
+                number(dynamic_cast<const NumberReference*>(baseRef)->value());
+                break;
+            }
+            case ReferenceTag::BOOLEAN: {
+                byte(dynamic_cast<const BooleanReference*>(baseRef)->value());
+                break;
+            }
+            case ReferenceTag::RESOURCE: {
+                auto ref = dynamic_cast<const ResourceReference*>(baseRef);
+
+                // Publish the resource to the Fabric, if necessary
+                if ( _vm->fabric()->shouldPublish(ref->resource()) ) {
+                    _vm->fabric()->publish(ref->resource());
+                }
+
+                string(ref->resource()->id());
+                break;
+            }
+            default:
+                throw MissingReducerError<Reference>(s(baseRef->tag()));
+        }
+
+        extra(baseRef);
+    }
+
+    std::string CompactWriter::finish() const {
+        std::string out;
+        out.push_back(static_cast<char>(VERSION));
+
+        // Types are serialized by Wire::types(), once per distinct type
+        varint(out, _types.size());
+        for ( auto t : _types ) {
+            auto bin = Wire::types()->reduce(t, nullptr);
+            varint(out, binn_size(bin));
+            out.append(static_cast<const char*>(binn_ptr(bin)), binn_size(bin));
+            binn_free(bin);
+        }
+
+        out.append(_body);
+        return out;
+    }
+
+    bool CompactWriter::packed(const EnumerationReference* ref, const Type::Type* innerType) {
+        Packing packing;
+        ReferenceTag tag;
+        switch ( innerType->intrinsic() ) {
+            case Type::Intrinsic::NUMBER: packing = Packing::NUMBER; tag = ReferenceTag::NUMBER; break;
+            case Type::Intrinsic::STRING: packing = Packing::STRING; tag = ReferenceTag::STRING; break;
+            case Type::Intrinsic::BOOLEAN: packing = Packing::BOOLEAN; tag = ReferenceTag::BOOLEAN; break;
+            default: return false;
+        }
+
+        auto length = ref->length();
+        for ( std::size_t i = 0; i < length; i += 1 ) {
+            if ( ref->get(i)->tag() != tag ) return false;
+        }
+
+        byte(static_cast<std::uint8_t>(packing));
+        varint(length);
+
+        if ( packing == Packing::NUMBER ) {
+            _body.reserve(_body.size() + length * sizeof(double));
+            for ( std::size_t i = 0; i < length; i += 1 ) {
+                number(dynamic_cast<const NumberReference*>(ref->get(i))->value());
+            }
+        } else if ( packing == Packing::STRING ) {
+            for ( std::size_t i = 0; i < length; i += 1 ) {
+                string(dynamic_cast<const StringReference*>(ref->get(i))->value());
+            }
+        } else {
+            std::uint8_t bits = 0;
+            for ( std::size_t i = 0; i < length; i += 1 ) {
+                if ( dynamic_cast<const BooleanReference*>(ref->get(i))->value() ) bits |= 1 << (i % 8);
+                if ( i % 8 == 7 ) {
+                    byte(bits);
+                    bits = 0;
+                }
+            }
+            if ( length % 8 != 0 ) byte(bits);
+        }
+
+        return true;
+    }
+
+    void CompactWriter::byte(std::uint8_t value) {
+        _body.push_back(static_cast<char>(value));
+    }
+
+    void CompactWriter::varint(std::uint64_t value) {
+        varint(_body, value);
+    }
+
+    void CompactWriter::varint(std::string& out, std::uint64_t value) {
+        while ( value >= 0x80 ) {
+            out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    void CompactWriter::number(double value) {
+        // Little-endian IEEE 754, regardless of host byte order
+        auto bits = std::bit_cast<std::uint64_t>(value);
+        for ( std::size_t i = 0; i < sizeof(bits); i += 1 ) {
+            _body.push_back(static_cast<char>(bits >> (8 * i)));
+        }
+    }
+
+    void CompactWriter::string(const std::string& value) {
+        varint(value.size());
+        _body.append(value);
+    }
+
+    void CompactWriter::type(const Type::Type* t) {
+        auto found = _typeIndices.find(t);
+        if ( found != _typeIndices.end() ) {
+            varint(found->second);
+            return;
+        }
+
+        auto index = _types.size();
+        _types.push_back(t);
+        _typeIndices.insert({ t, index });
+        varint(index);
+    }
+
+    void CompactWriter::extra(const ISerializable* obj) {
+        auto data = obj->getExtraSerialData();
+        if ( binn_count(data) == 0 ) {
+            byte(0);
+        } else {
+            byte(1);
+            varint(binn_size(data));
+            _body.append(static_cast<const char*>(binn_ptr(data)), binn_size(data));
+        }
+        binn_free(data);
+    }
+
+
+    CompactReader::CompactReader(VirtualMachine* vm, const char* data, std::size_t size)
+        : _vm(vm), _cursor(data), _end(data + size) {
+
+        auto version = byte();
+        if ( version != CompactWriter::VERSION ) {
+            throw Errors::SwarmError("Unsupported wire format version: " + s(static_cast<std::size_t>(version)) + " (expected " + s(static_cast<std::size_t>(CompactWriter::VERSION)) + ")");
+        }
+
+        auto count = varint();
+        _types.reserve(count);
+        for ( std::uint64_t i = 0; i < count; i += 1 ) {
+            auto size = varint();
+            need(size);
+
+            // binn trusts the sizes in its own headers, so make sure the entry really is `size` bytes
+            // of well-formed binn before handing it over, like the bounds checks on everything else here.
+            int entryType = 0;
+            int entryCount = 0;
+            int entrySize = static_cast<int>(size);
+            if ( size == 0 || size > static_cast<std::uint64_t>(INT_MAX) || !binn_is_valid_ex(const_cast<char*>(_cursor), &entryType, &entryCount, &entrySize) ) {
+                throw Errors::SwarmError("Malformed wire data: invalid type table entry");
+            }
+
+            _types.push_back(useref(Wire::types()->produce((binn*) const_cast<char*>(_cursor), nullptr)));
+            _cursor += size;
+        }
+    }
+
+    CompactReader::~CompactReader() {
+        for ( auto t : _types ) freeref(t);
+    }
+
+    Reference* CompactReader::reference() {
+        auto tag = static_cast<ReferenceTag>(byte());
+        Reference* ref;
+
+        switch ( tag ) {
+            case ReferenceTag::LOCATION: {
+                auto affinity = static_cast<Affinity>(varint());
+                ref = new LocationReference(affinity, string());
+                break;
+            }
+            case ReferenceTag::TYPE: {
+                ref = new TypeReference(type());
+                break;
+            }
+            case ReferenceTag::OTYPE: {
+                auto baseType = type();
+                assert(baseType->intrinsic() == Type::Intrinsic::OBJECT);
+                ref = new ObjectTypeReference(dynamic_cast<Type::Object*>(baseType));
+                break;
+            }
+            case ReferenceTag::OBJECT: {
+                auto baseType = type();
+                assert(baseType->intrinsic() == Type::Intrinsic::OBJECT);
+                auto inst = new ObjectReference(dynamic_cast<Type::Object*>(baseType));
+                auto isFinal = byte() != 0;
+
+                auto count = varint();
+                for ( std::uint64_t i = 0; i < count; i += 1 ) {
+                    auto key = string();
+                    inst->setProperty(key, reference());
+                }
+
+                if ( isFinal ) {
+                    inst = inst->finalize();
+                }
+                ref = inst;
+                break;
+            }
+            case ReferenceTag::ENUMERATION: {
+                auto innerType = type();
+                auto packing = static_cast<CompactWriter::Packing>(byte());
+                if ( packing != CompactWriter::Packing::NONE ) {
+                    ref = packed(packing, innerType);
+                    break;
+                }
+
+                auto enumeration = new EnumerationReference(innerType);
+                auto count = varint();
+                need(count);
+                enumeration->reserve(count);
+                for ( std::uint64_t i = 0; i < count; i += 1 ) {
+                    enumeration->append(reference());
+                }
+                ref = enumeration;
+                break;
+            }
+            case ReferenceTag::MAP: {
+                auto map = new MapReference(type());
+                auto count = varint();
+                for ( std::uint64_t i = 0; i < count; i += 1 ) {
+                    auto key = string();
+                    map->set(key, reference());
+                }
+                ref = map;
+                break;
+            }
+            case ReferenceTag::FUNCTION: {
+                auto backend = static_cast<FunctionBackend>(varint());
+                auto name = string();
+
+                std::vector<Reference*> params;
+                auto count = varint();
+                for ( std::uint64_t i = 0; i < count; i += 1 ) {
+                    params.push_back(reference());
+                }
+
+                auto fnRef = _vm->loadFunction(backend, name);
+                auto fn = fnRef->fn();
+                for ( auto p : params ) fn = fn->curry(p);
+
+                ref = new FunctionReference(fn);
+                delete fnRef;
+                break;
+            }
+            case ReferenceTag::STREAM: {
+                auto id = string();
+                auto stream = _vm->getStream(id, type());
+                ref = new StreamReference(stream);
+                break;
+            }
+            case ReferenceTag::CONTEXT_ID: {
+                ref = new ContextIdReference(string());
+                break;
+            }
+            case ReferenceTag::JOB_ID: {
+                ref = new JobIdReference(varint());
+                break;
+            }
+            case ReferenceTag::RETURN_VALUE_MAP: {
+                ReturnMap map;
+                auto count = varint();
+                for ( std::uint64_t i = 0; i < count; i += 1 ) {
+                    auto key = static_cast<JobID>(varint());
+                    map.insert({ key, reference() });
+                }
+                ref = new ReturnValueMapReference(map);
+                break;
+            }
+            case ReferenceTag::STRING: {
+                ref = new StringReference(string());
+                break;
+            }
+            case ReferenceTag::NUMBER: {
+                ref = new NumberReference(number());
+                break;
+            }
+            case ReferenceTag::BOOLEAN: {
+                ref = new BooleanReference(byte() != 0);
+                break;
+            }
+            case ReferenceTag::RESOURCE: {
+                auto resource = _vm->fabric()->load(string());
+                ref = new ResourceReference(resource);
+                break;
+            }
+            default:
+                throw MissingProducerError<Reference>(s(tag));
+        }
+
+        extra(ref);
+        return ref;
+    }
+
+    EnumerationReference* CompactReader::packed(CompactWriter::Packing packing, Type::Type* innerType) {
+        // Every packed element takes at least a bit, so this bounds the length before we allocate
+        auto length = varint();
+        need((length + 7) / 8);
+
+        auto ref = new EnumerationReference(innerType);
+        ref->reserve(length);
+
+        if ( packing == CompactWriter::Packing::NUMBER ) {
+            need(length * sizeof(double));
+            for ( std::uint64_t i = 0; i < length; i += 1 ) {
+                ref->append(new NumberReference(number()));
+            }
+        } else if ( packing == CompactWriter::Packing::STRING ) {
+            for ( std::uint64_t i = 0; i < length; i += 1 ) {
+                ref->append(new StringReference(string()));
+            }
+        } else if ( packing == CompactWriter::Packing::BOOLEAN ) {
+            need((length + 7) / 8);
+            std::uint8_t bits = 0;
+            for ( std::uint64_t i = 0; i < length; i += 1 ) {
+                if ( i % 8 == 0 ) bits = byte();
+                ref->append(BooleanReference::of((bits >> (i % 8)) & 1));
+            }
+        } else {
+            throw Errors::SwarmError("Malformed wire data: unknown enumeration packing " + s(static_cast<std::size_t>(packing)));
+        }
+
+        return ref;
+    }
+
+    std::uint8_t CompactReader::byte() {
+        need(1);
+        return static_cast<std::uint8_t>(*_cursor++);
+    }
+
+    std::uint64_t CompactReader::varint() {
+        std::uint64_t value = 0;
+        for ( std::size_t shift = 0; shift < 64; shift += 7 ) {
+            auto b = byte();
+            value |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+            if ( (b & 0x80) == 0 ) return value;
+        }
+        throw Errors::SwarmError("Malformed wire data: varint is too long");
+    }
+
+    double CompactReader::number() {
+        need(sizeof(std::uint64_t));
+        std::uint64_t bits = 0;
+        for ( std::size_t i = 0; i < sizeof(bits); i += 1 ) {
+            bits |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(_cursor[i])) << (8 * i);
+        }
+        _cursor += sizeof(bits);
+        return std::bit_cast<double>(bits);
+    }
+
+    std::string CompactReader::string() {
+        auto size = varint();
+        need(size);
+        std::string value(_cursor, size);
+        _cursor += size;
+        return value;
+    }
+
+    Type::Type* CompactReader::type() {
+        auto index = varint();
+        if ( index >= _types.size() ) {
+            throw Errors::SwarmError("Malformed wire data: type index " + s(index) + " is out of range");
+        }
+        return _types[index];
+    }
+
+    void CompactReader::extra(ISerializable* obj) {
+        if ( byte() == 0 ) return;
+
+        auto size = varint();
+        need(size);
+        obj->loadExtraSerialData((binn*) const_cast<char*>(_cursor));
+        _cursor += size;
+    }
+
+    void CompactReader::need(std::size_t n) const {
+        if ( static_cast<std::size_t>(_end - _cursor) < n ) {
+            throw Errors::SwarmError("Malformed wire data: unexpected end of input");
+        }
+    }
+
+}
@@ -0,0 +1,103 @@
+#ifndef SWARMVM_WIRE_COMPACT_H
+#define SWARMVM_WIRE_COMPACT_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../../shared/nslib.h"
+#include "../ISA.h"
+
+namespace swarmc::Type {
+    class Type;
+}
+
+namespace swarmc::Runtime {
+    class VirtualMachine;
+
+    /**
+     * Encodes references in the compact wire format used by `Wire::references()`.
+     *
+     * A serialized reference is a version byte, a table of the distinct types it uses,
+     * and a body. Each node in the body is a tag byte followed by its fields, with
+     * integers and lengths as LEB128 varints and types as indices into the table, so
+     * e.g. an enumeration of objects reduces the object type once instead of per element.
+     * Enumerations of numbers, strings, and booleans are packed without per-element tags.
+     */
+    class CompactWriter {
+    public:
+        /** Bumped whenever the layout of the format changes. */
+        static constexpr std::uint8_t VERSION = 1;
+
+        /** How the elements of an enumeration are laid out. */
+        enum class Packing : std::uint8_t {
+            NONE,  // each element is a full node
+            NUMBER,  // each element is 8 bytes
+            STRING,  // each element is a length and bytes
+            BOOLEAN,  // elements are bits, 8 to a byte
+        };
+
+        explicit CompactWriter(VirtualMachine* vm) : _vm(vm) {}
+
+        /** Append a reference (and everything it contains) to the body. */
+        void reference(const ISA::Reference*);
+
+        /** Get the finished encoding: version, type table, then body. */
+        [[nodiscard]] std::string finish() const;
+
+    protected:
+        VirtualMachine* _vm;
+        std::string _body;
+        std::vector<const Type::Type*> _types;
+        std::unordered_map<const Type::Type*, std::size_t> _typeIndices;
+
+        void byte(std::uint8_t);
+        void varint(std::uint64_t);
+        void number(double);
+        void string(const std::string&);
+        void type(const Type::Type*);
+        void extra(const nslib::serial::ISerializable*);
+
+        /** Pack an enumeration of primitives without per-element tags, if possible. */
+        bool packed(const ISA::EnumerationReference*, const Type::Type* innerType);
+
+        static void varint(std::string&, std::uint64_t);
+    };
+
+    /** Decodes references written by CompactWriter. */
+    class CompactReader {
+    public:
+        /** The data must stay valid for the lifetime of the reader. */
+        CompactReader(VirtualMachine* vm, const char* data, std::size_t size);
+
+        ~CompactReader();
+
+        CompactReader(const CompactReader&) = delete;
+        CompactReader& operator=(const CompactReader&) = delete;
+
+        /** Read the next reference from the body. */
+        [[nodiscard]] ISA::Reference* reference();
+
+    protected:
+        VirtualMachine* _vm;
+        const char* _cursor;
+        const char* _end;
+        std::vector<Type::Type*> _types;
+
+        std::uint8_t byte();
+        std::uint64_t varint();
+        double number();
+        std::string string();
+        Type::Type* type();
+        void extra(nslib::serial::ISerializable*);
+
+        /** Unpack an enumeration written by CompactWriter::packed. */
+        ISA::EnumerationReference* packed(CompactWriter::Packing, Type::Type* innerType);
+
+        /** Make sure `n` more bytes can be read. */
+        void need(std::size_t n) const;
+    };
+
+}
+
+#endif //SWARMVM_WIRE_COMPACT_H
@@ -0,0 +1,78 @@
+#include <functional>
+#include "../../shared/nslib.h"
+#include "../walk/binary_const.h"
+#include "../Wire.h"
+#include "../isa_meta.h"
+#include "../VirtualMachine.h"
+#include "../walk/ISABinaryWalk.h"
+#include "../walk/BinaryISAWalk.h"
+
+using namespace nslib::serial;
+using namespace swarmc::ISA;
+
+namespace swarmc::Runtime {
+
+    Factory<Program, VirtualMachine*>* Wire::buildPrograms() {
+        auto factory = new Factory<Program, VirtualMachine*>;
+
+        factory->registerReducer("swarm::Runtime::Program", [](const Program* program, auto vm) {
+            auto fJumps = binn_object();
+            for ( const auto& pair : program->_fJumps ) {
+                binn_object_set_uint64(fJumps, (char*) pair.first.c_str(), pair.second);
+            }
+
+            auto fSkips = binn_object();
+            for ( const auto& pair : program->_fSkips ) {
+                binn_object_set_uint64(fSkips, (char*) pair.first.c_str(), pair.second);
+            }
+
+            // FIXME: change this to use Wire once converted
+            ISABinaryWalk isaBinaryWalk(vm);
+            auto is = binn_list();
+            for ( auto i : program->_is ) {
+                binn_list_add_map(is, isaBinaryWalk.walkOne(i));
+            }
+
+            // FIXME: Debug::Metadata _meta
+
+            auto obj = binn_map();
+            binn_map_set_list(obj, BC_INSTRUCTIONS, is);
+            binn_map_set_object(obj, BC_FJUMPS, fJumps);
+            binn_map_set_object(obj, BC_FSKIPS, fSkips);
+            return obj;
+        });
+
+        factory->registerProducer("swarm::Runtime::Program", [](binn* obj, auto) -> Program* {
+            // FIXME: change this to use Wire once converted
+            BinaryISAWalk binaryIsaWalk;
+            auto inst = (binn*) binn_map_list(obj, BC_INSTRUCTIONS);
+            Instructions is = binaryIsaWalk.walk(inst);
+
+            auto program = new Program(is, false);
+
+            // FIXME: Debug::Metadata _meta
+            auto fJumpsBinn = binn_map_object(obj, BC_FJUMPS);
+            binn_iter iter;
+            char key[1028];
+            binn value;
+            binn_object_foreach(fJumpsBinn, key, value) {
+                std::string skey(key);
+                program->_fJumps[skey] = binn_object_uint64(fJumpsBinn, key);
+            }
+
+            auto fSkipsBinn = binn_map_object(obj, BC_FSKIPS);
+            binn_object_foreach(fSkipsBinn, key, value) {
+                std::string skey(key);
+                program->_fSkips[skey] = binn_object_uint64(fSkipsBinn, key);
+            }
+
+            return program;
+        });
+
+        Framework::onShutdown([factory]() {
+            delete factory;
+        });
+        return factory;
+    }
+
+}
@@ -13,19 +13,19 @@ namespace swarmc::Runtime {
     Factory<ScopeFrame, VirtualMachine*>* Wire::buildScopes() {
         auto factory = new Factory<ScopeFrame, VirtualMachine*>;
 
-        factory->registerReducer("swarm::Runtime::ScopeFrame", [factory](const ScopeFrame* scope, VirtualMachine* vm) {
+        factory->registerReducer(0, "swarm::Runtime::ScopeFrame", [factory](const ScopeFrame* scope, VirtualMachine* vm) {
             /*auto names = binn_list();
             auto locations = binn_list();
             int len = 0;
             for ( const auto& pair : scope->nameMap() ) {
                 len += 1;
-                binn_list_add_str(names, strdup(pair.first.c_str()));
+                binn_list_add_str(names, (char*) pair.first.c_str());
                 binn_list_add_map(locations, references()->reduce(pair.second, vm));
             }*/
 
             auto nameMap = binn_object();
             for ( const auto& pair : scope->nameMap() ) {
-                binn_object_set_map(nameMap, strdup(pair.first.c_str()), references()->reduce(pair.second, vm));
+                binn_object_set_map(nameMap, (char*) pair.first.c_str(), references()->reduce(pair.second, vm));
             }
 
 
@@ -38,7 +38,8 @@ namespace swarmc::Runtime {
             binn_map_set_object(binn, BC_NAMES, nameMap);
 //            binn_map_set_list(binn, BC_LOCATIONS, locations);
 //            binn_map_set_int64(binn, BC_LENGTH, len);
-            binn_map_set_str(binn, BC_ID, strdup(scope->id().c_str()));
+            binn_map_set_uint64(binn, BC_ID, scope->id());
+            binn_map_set_str(binn, BC_ORIGIN, (char*) scope->origin().c_str());
             binn_map_set_bool(binn, BC_IS_EX_FRAME, scope->isExceptionFrame());
             binn_map_set_bool(binn, BC_CAPTURE_RETURN, scope->shouldCaptureReturn());
 
@@ -59,8 +60,8 @@ namespace swarmc::Runtime {
             return binn;
         });
 
-        factory->registerProducer("swarm::Runtime::ScopeFrame", [factory](binn* obj, VirtualMachine* vm) ->ScopeFrame* {
-            std::string id = binn_map_str(obj, BC_ID);
+        factory->registerProducer(0, "swarm::Runtime::ScopeFrame", [factory](binn* obj, VirtualMachine* vm) ->ScopeFrame* {
+            ScopeId id = binn_map_uint64(obj, BC_ID);
             ScopeFrame* parent = nullptr;
             if ( binn_map_bool(obj, BC_HAS_PARENT) ) {
                 parent = factory->produce((binn*) binn_map_map(obj, BC_PARENT), vm);
@@ -79,6 +80,8 @@ namespace swarmc::Runtime {
             }
 
             auto scope = new ScopeFrame(vm->global(), id, parent, call);
+            std::string origin = binn_map_str(obj, BC_ORIGIN);
+            if ( origin != *ScopeFrame::localOrigin() ) scope->_origin = std::make_shared<const std::string>(origin);
             scope->_isExceptionFrame = binn_map_bool(obj, BC_IS_EX_FRAME);
             scope->_shouldCaptureReturn = binn_map_bool(obj, BC_CAPTURE_RETURN);
 
@@ -102,7 +105,12 @@ namespace swarmc::Runtime {
                 auto ref = references()->produce(location, vm);
                 assert(ref->tag() == ReferenceTag::LOCATION);
                 auto locRef = dynamic_cast<LocationReference*>(ref);
-                scope->_map[name] = useref(locRef);
+
+                // Shadowed locations are named `<name>@<scope origin>:<scope id>`, so recover the nominal location they shadow
+                auto nominal = new LocationReference(locRef->affinity(), locRef->name().substr(0, locRef->name().rfind('@')));
+                auto& shadow = scope->_map[nominal->slot()];
+                shadow.nominal = useref(nominal);
+                shadow.location = useref(locRef);
             }
 
             /*auto names = binn_map_list(obj, BC_NAMES);
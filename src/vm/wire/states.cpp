@@ -4,8 +4,6 @@
 #include "../Wire.h"
 #include "../isa_meta.h"
 #include "../VirtualMachine.h"
-#include "../walk/ISABinaryWalk.h"
-#include "../walk/BinaryISAWalk.h"
 
 using namespace nslib::serial;
 using namespace swarmc::ISA;
@@ -16,62 +14,37 @@ namespace swarmc::Runtime {
         auto factory = new Factory<State, VirtualMachine*>;
 
         factory->registerReducer("swarm::Runtime::State", [](const State* state, auto vm) {
-            auto fJumps = binn_object();
-            for ( const auto& pair : state->_fJumps ) {
-                binn_object_set_uint64(fJumps, strdup(pair.first.c_str()), pair.second);
-            }
-
-            auto fSkips = binn_object();
-            for ( const auto& pair : state->_fSkips ) {
-                binn_object_set_uint64(fSkips, strdup(pair.first.c_str()), pair.second);
-            }
+            auto obj = binn_map();
 
-            // FIXME: change this to use Wire once converted
-            ISABinaryWalk isaBinaryWalk(vm);
-            auto is = binn_list();
-            for ( auto i : state->_is ) {
-                binn_list_add_map(is, isaBinaryWalk.walkOne(i));
+            // If the program image has been published, refer to it by hash instead of re-sending it
+            auto hash = state->_program->imageHash();
+            if ( hash.empty() ) {
+                binn_map_set_map(obj, BC_PROGRAM_IMAGE, Wire::programs()->reduce(state->_program, vm));
+            } else {
+                binn_map_set_str(obj, BC_PROGRAM, (char*) hash.c_str());
             }
 
-            // FIXME: Debug::Metadata _meta
-
-            auto obj = binn_map();
-            binn_map_set_list(obj, BC_INSTRUCTIONS, is);
-            binn_map_set_object(obj, BC_FJUMPS, fJumps);
-            binn_map_set_object(obj, BC_FSKIPS, fSkips);
             binn_map_set_uint64(obj, BC_PC, state->_pc);
             binn_map_set_bool(obj, BC_REWIND_TO_HEAD, state->_rewindToHead);
             binn_map_set_map(obj, BC_EXTRA, state->getExtraSerialData());
             return obj;
         });
 
-        factory->registerProducer("swarm::Runtime::State", [](binn* obj, auto) ->State* {
-            // FIXME: change this to use Wire once converted
-            BinaryISAWalk binaryIsaWalk;
-            auto inst = (binn*) binn_map_list(obj, BC_INSTRUCTIONS);
-            Instructions is = binaryIsaWalk.walk(inst);
+        factory->registerProducer("swarm::Runtime::State", [](binn* obj, auto vm) -> State* {
+            Program* program = nullptr;
+            if ( auto hash = binn_map_str(obj, BC_PROGRAM) ) {
+                program = Program::loaded(hash);
+                if ( program == nullptr ) {
+                    throw Errors::SwarmError("Unable to restore state: program image " + std::string(hash) + " is not loaded");
+                }
+            } else {
+                program = Wire::programs()->produce((binn*) binn_map_map(obj, BC_PROGRAM_IMAGE), vm);
+            }
 
-            auto state = State::withoutInitialization(is);
+            auto state = new State(program);
             state->_pc = binn_map_uint64(obj, BC_PC);
             state->_rewindToHead = binn_map_bool(obj, BC_REWIND_TO_HEAD);
             state->loadExtraSerialData((binn*) binn_map_map(obj, BC_EXTRA));
-
-            // FIXME: Debug::Metadata _meta
-            auto fJumpsBinn = binn_map_object(obj, BC_FJUMPS);
-            binn_iter iter;
-            char key[1028];
-            binn value;
-            binn_object_foreach(fJumpsBinn, key, value) {
-                std::string skey(key);
-                state->_fJumps[skey] = binn_object_uint64(fJumpsBinn, key);
-            }
-
-            auto fSkipsBinn = binn_map_list(obj, BC_FSKIPS);
-            binn_object_foreach(fSkipsBinn, key, value) {
-                std::string skey(key);
-                state->_fSkips[skey] = binn_object_uint64(fSkipsBinn, key);
-            }
-
             return state;
         });
 
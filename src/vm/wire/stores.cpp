@@ -18,10 +18,10 @@ namespace swarmc::Runtime {
         factory->registerReducer("swarm::SingleThreaded::StorageInterface", [](const IStorageInterface* store, auto vm) {
             auto localStore = dynamic_cast<const SingleThreaded::StorageInterface*>(store);
             auto refs = binn_object();
-            for ( const auto& pair : localStore->_map ) {
-                std::string name = pair.first.substr(pair.first.rfind(':')+1);
-                binn_object_set_map(refs, strdup(name.c_str()), Wire::references()->reduce(pair.second, vm));
-            }
+            localStore->forEachSlot([refs, vm](std::size_t, const auto& slot) {
+                if ( slot.value == nullptr ) return;
+                binn_object_set_map(refs, (char*) slot.loc->name().c_str(), Wire::references()->reduce(slot.value, vm));
+            });
 
             auto obj = binn_map();
             binn_map_set_object(obj, BC_STORE_REFS, refs);
@@ -40,6 +40,7 @@ namespace swarmc::Runtime {
             binn_object_foreach(refs, key, value) {
                 std::string skey(key);
                 auto ll = new ISA::LocationReference(ISA::Affinity::LOCAL, skey);
+                GC_LOCAL_REF(ll)
                 store->store(ll, Wire::references()->produce(&value, vm));
             }
 
@@ -19,8 +19,8 @@ namespace swarmc::Runtime {
         static auto CurrentObjectR = std::stack<std::size_t>();
 
         // Primitive types
-        factory->registerReducer("Type::Primitive", common);
-        factory->registerProducer("Type::Primitive", [](binn* obj, auto) {
+        factory->registerReducer(Type::Primitive::SERIAL_INDEX, "Type::Primitive", common);
+        factory->registerProducer(Type::Primitive::SERIAL_INDEX, "Type::Primitive", [](binn* obj, auto) {
             auto t = Type::Primitive::of(
                 (Type::Intrinsic) binn_map_uint64(obj, BC_INTRINSIC)
             );
@@ -30,13 +30,13 @@ namespace swarmc::Runtime {
 
 
         // Opaque types
-        factory->registerReducer(s(Type::Intrinsic::OPAQUE), [common](const Type::Type* t, auto) {
+        factory->registerReducer((index_t) Type::Intrinsic::OPAQUE, s(Type::Intrinsic::OPAQUE), [common](const Type::Type* t, auto) {
             auto o = dynamic_cast<const Type::Opaque*>(t);
             auto binn = common(o, nullptr);
-            binn_map_set_str(binn, BC_NAME, strdup(o->name().c_str()));
+            binn_map_set_str(binn, BC_NAME, (char*) o->name().c_str());
             return binn;
         });
-        factory->registerProducer(s(Type::Intrinsic::OPAQUE), [](binn* obj, auto) {
+        factory->registerProducer((index_t) Type::Intrinsic::OPAQUE, s(Type::Intrinsic::OPAQUE), [](binn* obj, auto) {
             std::string name = binn_map_str(obj, BC_NAME);
             auto o = Type::Opaque::of(name);
             o->loadExtraSerialData((binn*) binn_map_map(obj, BC_EXTRA));
@@ -45,8 +45,8 @@ namespace swarmc::Runtime {
 
 
         // Ambiguous types
-        factory->registerReducer(s(Type::Intrinsic::AMBIGUOUS), common);
-        factory->registerProducer(s(Type::Intrinsic::AMBIGUOUS), [](binn* obj, auto) {
+        factory->registerReducer((index_t) Type::Intrinsic::AMBIGUOUS, s(Type::Intrinsic::AMBIGUOUS), common);
+        factory->registerProducer((index_t) Type::Intrinsic::AMBIGUOUS, s(Type::Intrinsic::AMBIGUOUS), [](binn* obj, auto) {
             auto t = Type::Ambiguous::of();
             t->loadExtraSerialData((binn*) binn_map_map(obj, BC_EXTRA));
             return t;
@@ -54,13 +54,13 @@ namespace swarmc::Runtime {
 
 
         // Map types
-        factory->registerReducer(s(Type::Intrinsic::MAP), [factory, common](const Type::Type* t, auto) {
+        factory->registerReducer((index_t) Type::Intrinsic::MAP, s(Type::Intrinsic::MAP), [factory, common](const Type::Type* t, auto) {
             auto m = dynamic_cast<const Type::Map*>(t);
             auto binn = common(m, nullptr);
             binn_map_set_map(binn, BC_TYPE, factory->reduce(m->values(), nullptr));
             return binn;
         });
-        factory->registerProducer(s(Type::Intrinsic::MAP), [factory](binn* obj, auto) {
+        factory->registerProducer((index_t) Type::Intrinsic::MAP, s(Type::Intrinsic::MAP), [factory](binn* obj, auto) {
             auto inner = factory->produce((binn*) binn_map_map(obj, BC_TYPE), nullptr);
             auto t = new Type::Map(inner);
             t->loadExtraSerialData((binn*) binn_map_map(obj, BC_EXTRA));
@@ -69,13 +69,13 @@ namespace swarmc::Runtime {
 
 
         // Enumerable types
-        factory->registerReducer(s(Type::Intrinsic::ENUMERABLE), [factory, common](const Type::Type* t, auto) {
+        factory->registerReducer((index_t) Type::Intrinsic::ENUMERABLE, s(Type::Intrinsic::ENUMERABLE), [factory, common](const Type::Type* t, auto) {
             auto e = dynamic_cast<const Type::Enumerable*>(t);
             auto binn = common(e, nullptr);
             binn_map_set_map(binn, BC_TYPE, factory->reduce(e->values(), nullptr));
             return binn;
         });
-        factory->registerProducer(s(Type::Intrinsic::ENUMERABLE), [factory](binn* obj, auto) {
+        factory->registerProducer((index_t) Type::Intrinsic::ENUMERABLE, s(Type::Intrinsic::ENUMERABLE), [factory](binn* obj, auto) {
             auto inner = factory->produce((binn*) binn_map_map(obj, BC_TYPE), nullptr);
             auto t = new Type::Enumerable(inner);
             t->loadExtraSerialData((binn*) binn_map_map(obj, BC_EXTRA));
@@ -84,13 +84,13 @@ namespace swarmc::Runtime {
 
 
         // Resource types
-        factory->registerReducer(s(Type::Intrinsic::RESOURCE), [factory, common](const Type::Type* t, auto) {
+        factory->registerReducer((index_t) Type::Intrinsic::RESOURCE, s(Type::Intrinsic::RESOURCE), [factory, common](const Type::Type* t, auto) {
             auto e = dynamic_cast<const Type::Resource*>(t);
             auto binn = common(e, nullptr);
             binn_map_set_map(binn, BC_TYPE, factory->reduce(e->yields(), nullptr));
             return binn;
         });
-        factory->registerProducer(s(Type::Intrinsic::RESOURCE), [factory](binn* obj, auto) {
+        factory->registerProducer((index_t) Type::Intrinsic::RESOURCE, s(Type::Intrinsic::RESOURCE), [factory](binn* obj, auto) {
             auto inner = factory->produce((binn*) binn_map_map(obj, BC_TYPE), nullptr);
             auto t = Type::Resource::of(inner);
             t->loadExtraSerialData((binn*) binn_map_map(obj, BC_EXTRA));
@@ -99,13 +99,13 @@ namespace swarmc::Runtime {
 
 
         // Stream types
-        factory->registerReducer(s(Type::Intrinsic::STREAM), [factory, common](const Type::Type* t, auto) {
+        factory->registerReducer((index_t) Type::Intrinsic::STREAM, s(Type::Intrinsic::STREAM), [factory, common](const Type::Type* t, auto) {
             auto e = dynamic_cast<const Type::Stream*>(t);
             auto binn = common(e, nullptr);
             binn_map_set_map(binn, BC_TYPE, factory->reduce(e->inner(), nullptr));
             return binn;
         });
-        factory->registerProducer(s(Type::Intrinsic::STREAM), [factory](binn* obj, auto) {
+        factory->registerProducer((index_t) Type::Intrinsic::STREAM, s(Type::Intrinsic::STREAM), [factory](binn* obj, auto) {
             auto inner = factory->produce((binn*) binn_map_map(obj, BC_TYPE), nullptr);
             auto t = Type::Stream::of(inner);
             t->loadExtraSerialData((binn*) binn_map_map(obj, BC_EXTRA));
@@ -116,7 +116,7 @@ namespace swarmc::Runtime {
         // Object types
         // FIXME: also serialize OBJECT_PROTO??
         // FIXME: remove OTYPE intrinsic??
-        factory->registerReducer(s(Type::Intrinsic::OBJECT), [factory, common](const Type::Type* t, auto) {
+        factory->registerReducer((index_t) Type::Intrinsic::OBJECT, s(Type::Intrinsic::OBJECT), [factory, common](const Type::Type* t, auto) {
             auto o = dynamic_cast<const Type::Object*>(t);
             // replace recursive references with p:THIS
             if ( !CurrentObjectR.empty() ) {
@@ -131,7 +131,7 @@ namespace swarmc::Runtime {
             auto propertyKeys = binn_list();
             auto propertyValues = binn_list();
             for ( const auto& pair : o->getProperties() ) {
-                binn_list_add_str(propertyKeys, strdup(pair.first.c_str()));
+                binn_list_add_str(propertyKeys, (char*) pair.first.c_str());
                 binn_list_add_map(propertyValues, factory->reduce(pair.second, nullptr));
             }
 
@@ -147,7 +147,7 @@ namespace swarmc::Runtime {
 
             return binn;
         });
-        factory->registerProducer(s(Type::Intrinsic::OBJECT), [factory](binn* obj, auto) -> Type::Type* {
+        factory->registerProducer((index_t) Type::Intrinsic::OBJECT, s(Type::Intrinsic::OBJECT), [factory](binn* obj, auto) -> Type::Type* {
             auto intrinsic = (Type::Intrinsic) binn_map_uint64(obj, BC_INTRINSIC);
             // `THIS` will appear in recursive types during serialization
             // Since we are reconstructing the type, all recursive references
@@ -227,10 +227,10 @@ namespace swarmc::Runtime {
             l->loadExtraSerialData((binn*) binn_map_map(obj, BC_EXTRA));
             return l;
         };
-        factory->registerReducer(s(Type::Intrinsic::LAMBDA0), lambdaReducer);
-        factory->registerProducer(s(Type::Intrinsic::LAMBDA0), lambdaProducer);
-        factory->registerReducer(s(Type::Intrinsic::LAMBDA1), lambdaReducer);
-        factory->registerProducer(s(Type::Intrinsic::LAMBDA1), lambdaProducer);
+        factory->registerReducer((index_t) Type::Intrinsic::LAMBDA0, s(Type::Intrinsic::LAMBDA0), lambdaReducer);
+        factory->registerProducer((index_t) Type::Intrinsic::LAMBDA0, s(Type::Intrinsic::LAMBDA0), lambdaProducer);
+        factory->registerReducer((index_t) Type::Intrinsic::LAMBDA1, s(Type::Intrinsic::LAMBDA1), lambdaReducer);
+        factory->registerProducer((index_t) Type::Intrinsic::LAMBDA1, s(Type::Intrinsic::LAMBDA1), lambdaProducer);
 
         Framework::onShutdown([factory]() {
             delete factory;
@@ -0,0 +1,58 @@
+#include "../../src/lib/catch_amalgamated.h"
+
+#include "../../src/shared/nslib.h"
+
+// Hidden by default. Run with: ./swarmc_tests "[.benchmark]"
+
+namespace {
+    class Counted : public nslib::IRefCountable {};
+}
+
+TEST_CASE("useref/freeref pair", "[nslib][refcount][.benchmark]") {
+    auto counted = new Counted;
+    useref(counted);
+
+    BENCHMARK("atomic") {
+        useref(counted);
+        freeref(counted);
+    };
+
+    nslib::IRefCountable::useThreadSafeRefCounts(false);
+
+    BENCHMARK("single-threaded") {
+        useref(counted);
+        freeref(counted);
+    };
+
+    {
+        nslib::IRefCountable::HelperThread helper;
+        REQUIRE( nslib::IRefCountable::usingThreadSafeRefCounts() );
+
+        BENCHMARK("single-threaded, helper thread running") {
+            useref(counted);
+            freeref(counted);
+        };
+    }
+
+    REQUIRE_FALSE( nslib::IRefCountable::usingThreadSafeRefCounts() );
+    nslib::IRefCountable::useThreadSafeRefCounts(true);
+    freeref(counted);
+}
+
+TEST_CASE("new+useref+freeref", "[nslib][refcount][.benchmark]") {
+    BENCHMARK("atomic") {
+        auto counted = new Counted;
+        useref(counted);
+        freeref(counted);
+    };
+
+    nslib::IRefCountable::useThreadSafeRefCounts(false);
+
+    BENCHMARK("single-threaded") {
+        auto counted = new Counted;
+        useref(counted);
+        freeref(counted);
+    };
+
+    nslib::IRefCountable::useThreadSafeRefCounts(true);
+}